@@ -101,6 +101,7 @@ main(int argc, char *argv[])
 
   l->addWidget(menuBar);
   auto scene = new FlowScene(registerDataModels(), &mainWidget);
+  scene->history().setEnabled(true);
   l->addWidget(new FlowView(scene));
   l->setContentsMargins(0, 0, 0, 0);
   l->setSpacing(0);
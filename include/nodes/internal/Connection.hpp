@@ -15,6 +15,8 @@
 #include "Export.hpp"
 #include "memory.hpp"
 
+#include <functional>
+
 class QPointF;
 
 namespace QtNodes
@@ -74,6 +76,19 @@ public:
   void
   setGraphicsObject(std::unique_ptr<ConnectionGraphicsObject>&& graphics);
 
+  using GraphicsObjectFactory =
+    std::function<std::unique_ptr<ConnectionGraphicsObject>(Connection&)>;
+
+  /// Used to create the graphics object on demand.
+  void
+  setGraphicsObjectFactory(GraphicsObjectFactory factory);
+
+  bool
+  hasGraphicsObject() const;
+
+  void
+  releaseGraphicsObject();
+
   /// Assigns a node to the required port.
   /// It is assumed that there is a required port, no extra checks
   void
@@ -86,6 +101,7 @@ public:
 
 public:
 
+  /// Creates the graphics object with the factory if there is none yet.
   ConnectionGraphicsObject&
   getConnectionGraphicsObject() const;
 
@@ -118,6 +134,9 @@ public:
   void
   setTypeConverter(TypeConverter converter);
 
+  bool
+  hasTypeConverter() const;
+
   bool
   complete() const;
 
@@ -154,6 +173,8 @@ private:
   ConnectionState    _connectionState;
   ConnectionGeometry _connectionGeometry;
 
+  GraphicsObjectFactory _graphicsObjectFactory;
+
   std::unique_ptr<ConnectionGraphicsObject>_connectionGraphicsObject;
 
   TypeConverter _converter;
@@ -53,6 +53,12 @@ public:
   void
   lock(bool locked);
 
+  /// With connection batching enabled the item stays hidden and is
+  /// drawn by the scene's ConnectionLayer unless it is being dragged,
+  /// hovered or selected.
+  void
+  updateBatching();
+
 protected:
 
   void
@@ -75,6 +81,9 @@ protected:
   void
   hoverLeaveEvent(QGraphicsSceneHoverEvent* event) override;
 
+  QVariant
+  itemChange(GraphicsItemChange change, const QVariant &value) override;
+
 private:
 
   void
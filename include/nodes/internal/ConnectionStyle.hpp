@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include <QtGui/QColor>
 
 #include "Export.hpp"
@@ -32,6 +34,8 @@ public:
 
   QColor constructionColor() const;
   QColor normalColor() const;
+  /// Color of the data type. It is derived from a stable hash of the
+  /// type id, computed once and cached per style; thread-safe.
   QColor normalColor(QString typeId) const;
   QColor selectedColor() const;
   QColor selectedHaloColor() const;
@@ -43,6 +47,12 @@ public:
 
   bool useDataDefinedColors() const;
 
+public:
+
+  /// Assigns a fixed color to the data type instead of the generated one,
+  /// e.g. to pre-seed a palette. Also read from "DataTypeColors" in JSON.
+  void setTypeColor(QString const &typeId, QColor const &color);
+
 private:
 
   QColor ConstructionColor;
@@ -56,5 +66,10 @@ private:
   float PointDiameter;
 
   bool UseDataDefinedColors;
+
+  class TypeColorCache;
+
+  // Shared between copies of the style until one of them is customized
+  std::shared_ptr<TypeColorCache> _typeColors;
 };
 }
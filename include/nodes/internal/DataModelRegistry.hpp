@@ -5,6 +5,7 @@
 #include <set>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -63,6 +64,9 @@ public:
       _registeredItemCreators[name] = std::move(creator);
       _categories.insert(category);
       _registeredModelsCategory[name] = category;
+
+      if (computeConcurrentRestore<ModelType>(HasStaticMethodConcurrentRestore<ModelType>{}))
+        _concurrentRestoreModels.insert(name);
     }
   }
 
@@ -110,6 +114,15 @@ public:
   TypeConverter getTypeConverter(NodeDataType const & d1,
                                  NodeDataType const & d2) const;
 
+  /// True for the models whose class has the static member method
+  ///
+  ///      static bool ConcurrentRestore();
+  ///
+  /// returning true. Such models are created and restored on worker
+  /// threads when a scene is loaded, so their constructor and restore()
+  /// must not create widgets nor touch state shared with other models.
+  bool concurrentRestore(QString const &modelName) const;
+
 private:
 
   RegisteredModelsCategoryMap _registeredModelsCategory;
@@ -120,6 +133,8 @@ private:
 
   RegisteredTypeConvertersMap _registeredTypeConverters;
 
+  std::unordered_set<QString> _concurrentRestoreModels;
+
 private:
 
   // If the registered ModelType class has the static member method
@@ -155,6 +170,31 @@ private:
     return creator()->name();
   }
 
+  template <typename T, typename = void>
+  struct HasStaticMethodConcurrentRestore
+      : std::false_type
+  {};
+
+  template <typename T>
+  struct HasStaticMethodConcurrentRestore<T,
+          typename std::enable_if<std::is_same<decltype(T::ConcurrentRestore()), bool>::value>::type>
+      : std::true_type
+  {};
+
+  template <typename ModelType>
+  static bool
+  computeConcurrentRestore(std::true_type)
+  {
+    return ModelType::ConcurrentRestore();
+  }
+
+  template <typename ModelType>
+  static bool
+  computeConcurrentRestore(std::false_type)
+  {
+    return false;
+  }
+
   template <typename T>
   struct UnwrapUniquePtr
   {
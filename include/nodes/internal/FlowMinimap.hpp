@@ -0,0 +1,141 @@
+#pragma once
+
+#include <QtCore/QLineF>
+#include <QtCore/QPointer>
+#include <QtCore/QUuid>
+#include <QtGui/QImage>
+#include <QtWidgets/QWidget>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "Export.hpp"
+#include "QUuidStdHash.hpp"
+
+namespace QtNodes
+{
+
+class FlowScene;
+class FlowView;
+class Node;
+class Connection;
+
+/// Overview of a whole FlowScene.
+/// The nodes are kept as a low resolution occupancy grid updated node by
+/// node from the scene signals, the connections as straight lines between
+/// their nodes, redrawn in the area of a node's connections when the
+/// node changes; the scene itself is never
+/// rendered. Clicking or dragging centers the attached FlowView on that
+/// point.
+class NODE_EDITOR_PUBLIC FlowMinimap
+  : public QWidget
+{
+  Q_OBJECT
+
+public:
+
+  FlowMinimap(FlowScene *scene, QWidget *parent = Q_NULLPTR);
+
+  ~FlowMinimap();
+
+  /// The view navigated by the minimap, its visible area is outlined.
+  void setView(FlowView *view);
+
+  QSize sizeHint() const override;
+
+  /// The scene point shown at the widget position, as last painted.
+  QPointF mapToScene(QPoint const &widgetPos) const;
+
+  /// The widget area showing the scene rect, as last painted.
+  QRectF mapFromScene(QRectF const &sceneRect) const;
+
+protected:
+
+  void paintEvent(QPaintEvent *event) override;
+
+  void resizeEvent(QResizeEvent *event) override;
+
+  void mousePressEvent(QMouseEvent *event) override;
+
+  void mouseMoveEvent(QMouseEvent *event) override;
+
+private:
+
+  void addNode(Node &node);
+
+  void moveNode(Node &node, QPointF const &newLocation);
+
+  void removeNode(Node &node);
+
+  void addConnection(Connection const &connection);
+
+  void removeConnection(Connection const &connection);
+
+  /// Draws the connections into their own image.
+  void drawConnections();
+
+  /// Clears the widget area of the connection image and draws
+  /// the connections crossing it again.
+  void drawConnections(QRect const &area);
+
+  /// The line of a connection in the widget, as last painted;
+  /// null while one of its nodes is unknown.
+  QLineF connectionLine(std::pair<QUuid, QUuid> const &nodes) const;
+
+  /// The widget area covered by the line of a connection.
+  QRect connectionArea(std::pair<QUuid, QUuid> const &nodes) const;
+
+  /// Adds the areas of the node's connections to the dirty area.
+  void touchConnections(QUuid const &nodeId);
+
+  /// Recomputes the mapped scene area and the whole grid.
+  void rebuild();
+
+  /// Adds `delta` to the cells covered by the scene rect
+  /// and repaints their pixels.
+  void changeCells(QRectF const &sceneRect, int delta);
+
+  QRect cellsOf(QRectF const &sceneRect) const;
+
+  void centerView(QPoint const &widgetPos);
+
+private:
+
+  FlowScene *_scene;
+
+  QPointer<FlowView> _view;
+
+  std::unordered_map<QUuid, QRectF> _nodeRects;
+
+  // the output and input node of each connection
+  std::unordered_map<QUuid, std::pair<QUuid, QUuid>> _connections;
+
+  // the connections of each node
+  std::unordered_map<QUuid, std::unordered_set<QUuid>> _nodeConnections;
+
+  // scene area covered by the grid and the scene units per cell
+  QPointF _origin;
+  double  _cellExtent;
+
+  // one pixel per cell
+  QImage _image;
+
+  // number of nodes overlapping each cell
+  std::vector<int> _cellCounts;
+
+  // widget sized, the connections under the nodes
+  QImage _connectionImage;
+
+  QRectF _viewRect;
+
+  bool _rebuildNeeded;
+
+  // the whole connection image is redrawn
+  bool _connectionsChanged;
+
+  // part of the connection image redrawn on the next paint
+  QRect _connectionsDirty;
+};
+}
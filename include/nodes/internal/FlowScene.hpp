@@ -4,15 +4,21 @@
 #include <QtWidgets/QGraphicsScene>
 
 #include <unordered_map>
+#include <unordered_set>
 #include <tuple>
 #include <functional>
 
 #include "QUuidStdHash.hpp"
+#include "QStringStdHash.hpp"
 #include "Export.hpp"
 #include "DataModelRegistry.hpp"
 #include "TypeConverter.hpp"
 #include "memory.hpp"
 
+class QIODevice;
+class QJsonArray;
+class QThreadPool;
+
 namespace QtNodes
 {
 
@@ -22,7 +28,30 @@ class Node;
 class NodeGraphicsObject;
 class Connection;
 class ConnectionGraphicsObject;
+class ConnectionLayer;
+class NodeSpatialIndex;
+template <typename Item> class SceneGrid;
 class NodeStyle;
+class SceneHistory;
+
+/// On-disk layouts of a scene.
+enum class SceneFormat
+{
+  /// The indented JSON document, readable and stable across versions
+  Json,
+  /// Compact records with binary ids and interned model names,
+  /// much faster to load
+  Binary
+};
+
+/// Compression of the saved scenes, on top of the format.
+enum class SceneCompression
+{
+  None,
+  /// The scene is split into chunks compressed independently with zlib,
+  /// in parallel on saving and on loading
+  Chunked
+};
 
 /// Scene holds connections and nodes.
 class NODE_EDITOR_PUBLIC FlowScene
@@ -54,14 +83,61 @@ public:
 
   std::shared_ptr<Connection> restoreConnection(QJsonObject const &connectionJson);
 
+  /// Same as above from the fields of a saved connection, with a converter
+  /// between the given types if any. Throws std::logic_error if one of
+  /// the nodes isn't in the scene.
+  std::shared_ptr<Connection> restoreConnection(QUuid const& nodeInId,
+                                                PortIndex portIndexIn,
+                                                QUuid const& nodeOutId,
+                                                PortIndex portIndexOut,
+                                                NodeDataType const& converterIn = NodeDataType(),
+                                                NodeDataType const& converterOut = NodeDataType());
+
   void deleteConnection(Connection& connection);
 
+  /// The connection between the given ports, or nullptr.
+  Connection* findConnection(QUuid const& nodeInId,
+                             PortIndex portIndexIn,
+                             QUuid const& nodeOutId,
+                             PortIndex portIndexOut) const;
+
   Node&createNode(std::unique_ptr<NodeDataModel> && dataModel);
 
   Node&restoreNode(QJsonObject const& nodeJson);
 
+  /// Same as above from the fields of a saved node; `modelJson` is the
+  /// output of the model's save().
+  Node& restoreNode(QUuid const& id,
+                    QString const& modelName,
+                    QPointF const& position,
+                    QJsonObject const& modelJson);
+
+  /// Restores the nodes of a saved "nodes" array. The models registered
+  /// as safe to restore concurrently (see DataModelRegistry) are created
+  /// and restored on a thread pool; the nodes are then added to the
+  /// scene on the calling thread, in the order of the array.
+  std::vector<Node*> restoreNodes(QJsonArray const& nodesJson);
+
   void removeNode(Node& node);
 
+  /// The nodes and the connections between them in the binary scene
+  /// format, as taken by pasteNodes().
+  QByteArray copyNodes(std::vector<Node*> const& nodes) const;
+
+  /// Adds copies of the copied nodes with new ids, moved by `offset`, and
+  /// of the connections between them. The copies are restored as a batch
+  /// like restoreNodes() does, the data propagates once they are all
+  /// connected, and they form one step of the history. The copies are
+  /// selected and returned. Malformed data, or a model missing from the
+  /// registry, throws std::logic_error before any copy is placed.
+  std::vector<Node*> pasteNodes(QByteArray const& data,
+                                QPointF const& offset = QPointF());
+
+  /// Same as pasting the copied nodes, the models being cloned through
+  /// their save() and restore() without encoding.
+  std::vector<Node*> duplicateNodes(std::vector<Node*> const& nodes,
+                                    QPointF const& offset);
+
   DataModelRegistry&registry() const;
 
   void setRegistry(std::shared_ptr<DataModelRegistry> registry);
@@ -78,6 +154,72 @@ public:
 
   QSizeF getNodeSize(Node const& node) const;
 
+public:
+
+  /// Queues the update of the connections attached to the node. Queued
+  /// updates are applied once per event loop iteration and every
+  /// connection is moved at most once, however many of its nodes moved.
+  void scheduleConnectionsUpdate(Node const& node);
+
+  /// Same as scheduleConnectionsUpdate(), also queues the nodeMoved() and
+  /// nodesMoved() signals for the node.
+  void scheduleNodeMoved(Node const& node);
+
+  /// Applies the queued connection updates and emits the queued
+  /// move signals right away.
+  void flushPendingUpdates();
+
+  /// While deferred, new connections don't push data to their input
+  /// nodes. Turning it off runs one pass over the nodes downstream of
+  /// the connections made meanwhile, in dependency order, so that every
+  /// connection carries data once. Loading a scene defers the propagation
+  /// until all the connections are restored.
+  void setDataPropagationDeferred(bool deferred);
+
+  bool dataPropagationDeferred() const;
+
+  /// The undo and redo history of the changes made to the scene, off
+  /// until history().setEnabled(true). Loading a scene and restoring
+  /// nodes from an IndexedSceneFile are not recorded.
+  SceneHistory& history() const;
+
+public:
+
+  /// When enabled, complete connections are drawn in a batch by a single
+  /// scene-level item. A connection becomes an individual interactive item
+  /// only while it is hovered, selected or dragged.
+  void setConnectionBatching(bool enabled);
+
+  bool connectionBatching() const;
+
+  /// The batching layer or nullptr if the batching is disabled.
+  ConnectionLayer* connectionLayer() const;
+
+  /// When enabled, embedded widgets are painted from cached snapshots.
+  /// A widget gets a live QGraphicsProxyWidget only while its node is
+  /// hovered or has the focus, at a zoom level where it can be used.
+  void setWidgetSnapshots(bool enabled);
+
+  bool widgetSnapshots() const;
+
+  /// When enabled, the graphics objects of nodes and connections are only
+  /// created once they enter the visible region of a FlowView, or when they
+  /// are asked for through Node::nodeGraphicsObject() and
+  /// Connection::getConnectionGraphicsObject().
+  void setLazyGraphicsObjects(bool enabled);
+
+  bool lazyGraphicsObjects() const;
+
+  /// Creates the graphics objects of the nodes and connections
+  /// intersecting the scene rect. Only the items found in the rect
+  /// through the spatial indexes are visited.
+  void materializeGraphicsObjects(QRectF const& sceneRect);
+
+  /// Destroys the graphics objects lying outside the scene rect,
+  /// except for the selected or hovered items and the focused node.
+  /// Only the existing graphics objects are visited.
+  void releaseGraphicsObjects(QRectF const& keptSceneRect);
+
 public:
 
   std::unordered_map<QUuid, std::unique_ptr<Node> > const & nodes() const;
@@ -86,8 +228,53 @@ public:
 
   std::vector<Node*> allNodes() const;
 
+  /// The selection is maintained as items get selected and deselected,
+  /// it is not collected from the scene items.
   std::vector<Node*> selectedNodes() const;
 
+  std::vector<Connection*> selectedConnections() const;
+
+  /// The nodes intersecting, or contained in, the scene rect. The query
+  /// goes through a spatial index and doesn't visit the other nodes.
+  std::vector<Node*> nodesInRect(QRectF const& sceneRect,
+                                 Qt::ItemSelectionMode mode = Qt::IntersectsItemShape) const;
+
+  /// The complete connections whose curve intersects, or is contained in,
+  /// the scene rect. The candidates come from the connection grid.
+  std::vector<Connection*> connectionsInRect(QRectF const& sceneRect,
+                                             Qt::ItemSelectionMode mode = Qt::IntersectsItemShape) const;
+
+  /// Changes the selection in one go, selectionChanged() is emitted once.
+  /// Only the nodes whose state changes are touched; selecting a node of
+  /// a lazy scene creates its graphics object.
+  void selectNodes(std::vector<Node*> const& nodes,
+                   Qt::ItemSelectionOperation operation = Qt::ReplaceSelection);
+
+  /// Selects connections the way selectNodes() selects nodes. Use it
+  /// rather than setSelected() on a batched connection, which is hidden
+  /// and can't be selected before it is promoted.
+  void selectConnections(std::vector<Connection*> const& connections,
+                         Qt::ItemSelectionOperation operation = Qt::ReplaceSelection);
+
+  void selectNodesInRect(QRectF const& sceneRect,
+                         Qt::ItemSelectionMode mode = Qt::IntersectsItemShape,
+                         Qt::ItemSelectionOperation operation = Qt::ReplaceSelection);
+
+  /// Selects the nodes and the connections in the scene rect, as the
+  /// rubber band of the view does.
+  void selectInRect(QRectF const& sceneRect,
+                    Qt::ItemSelectionMode mode = Qt::IntersectsItemShape,
+                    Qt::ItemSelectionOperation operation = Qt::ReplaceSelection);
+
+  /// Selects the nodes whose model has the given name.
+  void selectNodesByModelName(QString const& modelName,
+                              Qt::ItemSelectionOperation operation = Qt::ReplaceSelection);
+
+  /// Called by the graphics objects when they get selected or deselected.
+  void nodeSelectionChanged(Node& node, bool selected);
+
+  void connectionSelectionChanged(Connection& connection, bool selected);
+
 public:
 
   void clearScene();
@@ -96,10 +283,36 @@ public:
 
   void load();
 
-  QByteArray saveToMemory() const;
+  QByteArray saveToMemory(SceneFormat format = SceneFormat::Json,
+                          SceneCompression compression = SceneCompression::None) const;
 
+  /// Detects the format and the compression of the data.
   void loadFromMemory(const QByteArray& data);
 
+  /// Receives the work done so far and the total amount of work,
+  /// the total being 0 when unknown.
+  using ProgressCallback = std::function<void(qint64 done, qint64 total)>;
+
+  /// Writes the scene node by node; the document is never built in
+  /// memory. The progress is reported in saved items. Returns false if
+  /// writing to the device failed.
+  bool saveToDevice(QIODevice& device,
+                    SceneFormat format = SceneFormat::Json,
+                    ProgressCallback const& progress = ProgressCallback(),
+                    SceneCompression compression = SceneCompression::None) const;
+
+  /// Reads and restores the scene element by element, with memory
+  /// bounded by the largest element rather than the document. Detects
+  /// the format and the compression; the progress is reported in bytes
+  /// of the device.
+  /// QJsonDocument sorts the keys, so saveToMemory() output and .flow
+  /// files list the connections before the nodes. A seekable device is
+  /// then read twice, the connections on the second pass; from a
+  /// sequential one, e.g. compressed data, the connections are kept
+  /// aside until the nodes are restored and the memory grows with them.
+  void loadFromDevice(QIODevice& device,
+                      ProgressCallback const& progress = ProgressCallback());
+
 Q_SIGNALS:
 
   /**
@@ -120,8 +333,20 @@ Q_SIGNALS:
   void connectionCreated(Connection const &c);
   void connectionDeleted(Connection const &c);
 
+  /// Not emitted from within the move: the moves are collected and
+  /// reported on the next pass of the event loop, or by
+  /// flushPendingUpdates(). A node moved several times in between is
+  /// reported once, with its last position.
   void nodeMoved(Node& n, const QPointF& newLocation);
 
+  /// Emitted once per event loop iteration with all the nodes
+  /// moved since the previous emission.
+  void nodesMoved(std::vector<Node*> const& nodes);
+
+  /// Deferred like nodeMoved(), for a node whose size changed while it
+  /// stayed in place.
+  void nodeResized(Node& n);
+
   void nodeDoubleClicked(Node& n);
 
   void connectionHovered(Connection& c, QPoint screenPos);
@@ -134,6 +359,10 @@ Q_SIGNALS:
 
   void nodeContextMenu(Node& n, const QPointF& pos);
 
+protected:
+
+  void mouseMoveEvent(QGraphicsSceneMouseEvent* event) override;
+
 private:
 
   using SharedConnection = std::shared_ptr<Connection>;
@@ -148,6 +377,120 @@ private:
   std::unordered_map<QUuid, SharedConnection> _connections;
   std::unordered_map<QUuid, UniqueNode>       _nodes;
 
+  std::unique_ptr<SceneHistory> _history;
+
+  std::unique_ptr<ConnectionLayer> _connectionLayer;
+
+  std::unordered_set<QUuid> _pendingConnectionUpdates;
+  std::vector<QUuid>        _pendingMovedNodes;
+  std::unordered_set<QUuid> _pendingMovedNodesSet;
+
+  // nodes moved or resized; those not moved were resized
+  std::unordered_set<QUuid> _pendingGeometryNodes;
+
+  bool _flushScheduled = false;
+
+  bool _widgetSnapshots = false;
+
+  bool _lazyGraphicsObjects = false;
+
+  bool _dataPropagationDeferred = false;
+
+  // input nodes of the connections made while the propagation is deferred
+  std::unordered_set<QUuid> _deferredPropagationTargets;
+
+  std::unordered_set<Node*>       _selectedNodes;
+  std::unordered_set<Connection*> _selectedConnections;
+
+  std::unordered_map<QString, std::unordered_set<Node*>> _nodesByModelName;
+
+  std::unique_ptr<NodeSpatialIndex> _spatialIndex;
+
+  // the complete connections by the scene rect of their curve
+  std::unique_ptr<SceneGrid<Connection*>> _connectionIndex;
+
+  // nodes moved or resized since the last query of the indexes,
+  // their connections are refiled along with them
+  mutable std::unordered_set<QUuid> _spatialIndexPending;
+
+  // restores the models of a batch concurrently, created with the
+  // first batch that needs it so its threads are reused by the next
+  std::unique_ptr<QThreadPool> _restorePool;
+
+private:
+
+  /// Indexes a node added to _nodes.
+  void registerNode(Node& node);
+
+  /// Drops a node about to be removed from every index.
+  void unregisterNode(Node& node);
+
+  void updateSpatialIndex() const;
+
+  /// Selects the nodes and the connections, emitting selectionChanged()
+  /// once.
+  void changeSelection(std::vector<Node*> const& nodes,
+                       std::vector<Connection*> const& connections,
+                       Qt::ItemSelectionOperation operation);
+
+  /// A node read from a saved scene, the model being created and
+  /// restored ahead of the node when it allows concurrent restore.
+  struct PendingNode
+  {
+    QUuid id;
+    QString modelName;
+    QPointF position;
+    QJsonObject modelJson;
+    std::unique_ptr<NodeDataModel> model;
+  };
+
+  std::vector<Node*> restoreNodeBatch(std::vector<PendingNode>& batch);
+
+  /// A connection between copied nodes, by the ids of the copies.
+  struct PendingConnection
+  {
+    QUuid inId;
+    PortIndex inIndex;
+    QUuid outId;
+    PortIndex outIndex;
+    NodeDataType converterIn;
+    NodeDataType converterOut;
+  };
+
+  /// Adds the copies made by pasteNodes() and duplicateNodes().
+  std::vector<Node*> placeCopies(std::vector<PendingNode>& nodes,
+                                 std::vector<PendingConnection> const& connections,
+                                 QString const& text);
+
+  /// Adds a node restored from a save. `modelJson` is null when the
+  /// model has been restored beforehand.
+  Node& placeRestoredNode(std::unique_ptr<NodeDataModel>&& dataModel,
+                          QUuid const& id,
+                          QPointF const& position,
+                          QJsonObject const* modelJson);
+
+  void propagateDeferredData();
+
+  /// Runs the work with the propagation deferred, unless it already is.
+  void deferPropagationDuring(std::function<void()> const& work);
+
+  /// Same as above for a load, which is kept out of the history.
+  void loadDeferringPropagation(std::function<void()> const& load);
+
+  bool saveBinary(QIODevice& device, ProgressCallback const& progress) const;
+
+  void loadBinary(QIODevice& device, ProgressCallback const& progress);
+
+  void loadJson(QIODevice& device, ProgressCallback const& progress);
+
+  void setGraphicsObjectFactory(Node& node);
+
+  void setGraphicsObjectFactory(Connection& connection);
+
+  /// Lays the ports out again when a port scrolled out of the port
+  /// window is connected or disconnected; it takes or leaves a row.
+  void updatePortRows(Node& node, PortType portType, PortIndex portIndex);
+
 private Q_SLOTS:
 
   void setupConnectionSignals(Connection const& c);
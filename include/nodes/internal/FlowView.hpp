@@ -1,13 +1,20 @@
 #pragma once
 
+#include <QtCore/QByteArray>
+#include <QtGui/QPixmap>
 #include <QtWidgets/QGraphicsView>
 
+#include <memory>
+
 #include "Export.hpp"
 
+class QRubberBand;
+
 namespace QtNodes
 {
 
 class FlowScene;
+class ViewportUpdatePolicy;
 
 class NODE_EDITOR_PUBLIC FlowView
   : public QGraphicsView
@@ -18,6 +25,8 @@ public:
   FlowView(QWidget *parent = Q_NULLPTR);
   FlowView(FlowScene *scene, QWidget *parent = Q_NULLPTR);
 
+  ~FlowView();
+
   FlowView(const FlowView&) = delete;
   FlowView operator=(const FlowView&) = delete;
 
@@ -25,8 +34,36 @@ public:
 
   QAction* deleteSelectionAction() const;
 
+  /// Undo and redo of the scene history, with the standard shortcuts.
+  QAction* undoAction() const;
+
+  QAction* redoAction() const;
+
+  /// Copy, paste and duplication of the selected nodes, with the
+  /// standard shortcuts and Ctrl+D.
+  QAction* copySelectionAction() const;
+
+  QAction* pasteAction() const;
+
+  QAction* duplicateSelectionAction() const;
+
   void setScene(FlowScene *scene);
 
+  /// The part of the scene currently shown.
+  QRectF visibleSceneRect() const;
+
+  /// Pans the view so that the scene point is shown in the middle.
+  void centerOnScenePoint(QPointF const& scenePoint);
+
+  /// When enabled (the default), the viewport update mode follows the
+  /// measured paint cost and dirty regions of the painted frames.
+  void setAdaptiveViewportUpdate(bool enabled);
+
+  bool adaptiveViewportUpdate() const;
+
+  /// Disables the adaptation and keeps the given mode.
+  void pinViewportUpdateMode(QGraphicsView::ViewportUpdateMode mode);
+
 public Q_SLOTS:
 
   void scaleUp();
@@ -35,6 +72,22 @@ public Q_SLOTS:
 
   void deleteSelectedNodes();
 
+  /// Puts the selected nodes and the connections between them on the
+  /// clipboard.
+  void copySelectedNodes();
+
+  /// Pastes the nodes on the clipboard next to where they were copied,
+  /// each paste of the same nodes a step further than the last one.
+  void pasteNodes();
+
+  void duplicateSelectedNodes();
+
+Q_SIGNALS:
+
+  /// Emitted when scrolling, zooming or resizing changes
+  /// the part of the scene shown by the view.
+  void visibleSceneRectChanged(QRectF const& rect);
+
 protected:
 
   void contextMenuEvent(QContextMenuEvent *event) override;
@@ -49,10 +102,18 @@ protected:
 
   void mouseMoveEvent(QMouseEvent *event) override;
 
+  void mouseReleaseEvent(QMouseEvent *event) override;
+
   void drawBackground(QPainter* painter, const QRectF& r) override;
 
+  void paintEvent(QPaintEvent *event) override;
+
   void showEvent(QShowEvent *event) override;
 
+  void resizeEvent(QResizeEvent *event) override;
+
+  void scrollContentsBy(int dx, int dy) override;
+
 protected:
 
   FlowScene * scene();
@@ -61,9 +122,38 @@ private:
 
   QAction* _clearSelectionAction;
   QAction* _deleteSelectionAction;
+  QAction* _undoAction;
+  QAction* _redoAction;
+  QAction* _copySelectionAction;
+  QAction* _pasteAction;
+  QAction* _duplicateSelectionAction;
+
+  // the clipboard data pasted last and how many times in a row
+  QByteArray _lastPasted;
+  int        _pasteCount;
 
   QPointF _clickPos;
 
+  // Shift + drag selects the nodes through FlowScene::selectNodesInRect
+  QRubberBand* _rubberBand;
+  QPoint       _rubberBandOrigin;
+
   FlowScene* _scene;
+
+  bool _visibleSceneRectUpdateScheduled;
+
+  std::unique_ptr<ViewportUpdatePolicy> _viewportUpdatePolicy;
+
+  // One coarse grid cell with its fine lines, rendered for the current zoom
+  QPixmap _gridTile;
+  QString _gridTileKey;
+
+private:
+
+  /// Materializes the lazy graphics objects of the scene
+  /// in the visible rect and notifies about the rect.
+  void updateVisibleSceneRect();
+
+  void scheduleVisibleSceneRectUpdate();
 };
 }
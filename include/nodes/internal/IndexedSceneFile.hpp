@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_set>
+#include <vector>
+
+#include <QtCore/QFile>
+#include <QtCore/QObject>
+#include <QtCore/QRectF>
+#include <QtCore/QUuid>
+
+#include "Export.hpp"
+
+namespace QtNodes
+{
+
+class FlowScene;
+class FlowView;
+class Node;
+
+/// A scene file that is read in parts. The records of the nodes and
+/// connections are followed by an index: a table of the nodes sorted by
+/// id with their record offsets and scene rects, the connections of every
+/// node, and a grid of buckets over the node positions.
+///
+/// The file is memory mapped, so opening it only checks the index and
+/// the nodes are restored into the scene on request: by region, by id or
+/// by following connections. A connection is restored once both of its
+/// nodes are. Nodes restored before, or removed by the user afterwards,
+/// are not restored again.
+///
+/// The scene must outlive the object; parenting it to the scene does that.
+class NODE_EDITOR_PUBLIC IndexedSceneFile
+  : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  IndexedSceneFile(FlowScene& scene, QObject* parent = Q_NULLPTR);
+
+  ~IndexedSceneFile();
+
+public:
+
+  /// Writes the whole scene, replacing the file only once it is complete.
+  /// `cellSize` is the side of the grid buckets in scene units.
+  static
+  bool
+  write(FlowScene const& scene,
+        QString const& fileName,
+        double cellSize = 1024.0);
+
+  /// Maps the file and checks its index; nothing is restored yet.
+  bool
+  open(QString const& fileName);
+
+  void
+  close();
+
+  bool
+  isOpen() const;
+
+  std::size_t
+  nodeCount() const;
+
+  std::size_t
+  connectionCount() const;
+
+public:
+
+  /// Restores the nodes intersecting the scene rect, and the connections
+  /// whose nodes are then all in the scene. Returns the number of nodes
+  /// restored. Malformed records throw std::logic_error.
+  std::size_t
+  materializeRegion(QRectF const& sceneRect);
+
+  /// The node with the given id, restored if needed; nullptr if the file
+  /// doesn't hold it or if it was removed from the scene after being
+  /// restored.
+  Node*
+  materializeNode(QUuid const& id);
+
+  /// Restores the node and the nodes up to `depth` connections away.
+  /// Returns the number of nodes restored.
+  std::size_t
+  materializeSubgraph(QUuid const& id, int depth);
+
+  /// Restores the region shown by the view, now and whenever it changes.
+  void
+  followView(FlowView& view);
+
+private:
+
+  /// The index in the node table, or -1.
+  qint64
+  findNode(QUuid const& id) const;
+
+  QUuid
+  nodeId(quint32 index) const;
+
+  QRectF
+  nodeRect(quint32 index) const;
+
+  /// Restores the node unless it was restored before.
+  bool
+  restoreNode(quint32 index);
+
+  /// Restores the pending connections of the nodes whose both ends are
+  /// in the scene.
+  void
+  restoreConnections(std::vector<quint32> const& nodes);
+
+  /// The node table indices of the other ends of the node's connections.
+  std::vector<quint32>
+  neighbours(quint32 index) const;
+
+  uchar const*
+  nodeEntry(quint32 index) const;
+
+  uchar const*
+  adjacency(quint32 index, quint32& count) const;
+
+  /// The bucket of the grid cell, or nullptr if the cell is empty.
+  uchar const*
+  findBucket(qint64 key) const;
+
+  uchar const*
+  bucket(quint32 index) const;
+
+private:
+
+  FlowScene& _scene;
+
+  QFile _file;
+
+  uchar* _data;
+
+  qint64 _size;
+
+  quint8 _payloadEncoding;
+
+  qint64 _adjacencyOffset;
+  qint64 _nodeTableOffset;
+  qint64 _bucketTableOffset;
+  qint64 _bucketMembersOffset;
+
+  double _cellSize;
+
+  // the largest node extent, queries are grown by it
+  double _maxWidth;
+  double _maxHeight;
+
+  quint32 _nodeCount;
+  quint32 _bucketCount;
+  quint32 _connectionCount;
+
+  std::unordered_set<quint32> _restoredNodes;
+
+  // offsets of the connection records already restored
+  std::unordered_set<qint64> _restoredConnections;
+};
+}
@@ -2,6 +2,7 @@
 
 
 #include <QtCore/QObject>
+#include <QtCore/QPointF>
 #include <QtCore/QUuid>
 
 #include <QtCore/QJsonObject>
@@ -17,6 +18,8 @@
 #include "Serializable.hpp"
 #include "memory.hpp"
 
+#include <functional>
+
 namespace QtNodes
 {
 
@@ -47,6 +50,19 @@ public:
   void
   restore(QJsonObject const &json) override;
 
+  /// Same as restore(json) with the fields already extracted,
+  /// `modelJson` being the output of NodeDataModel::save().
+  void
+  restore(QUuid const &id,
+          QPointF const &position,
+          QJsonObject const &modelJson);
+
+  /// Sets the id and the position of a node whose model has been
+  /// restored beforehand.
+  void
+  restore(QUuid const &id,
+          QPointF const &position);
+
 public:
 
   QUuid
@@ -61,6 +77,10 @@ public:
 
 public:
 
+  using GraphicsObjectFactory =
+    std::function<std::unique_ptr<NodeGraphicsObject>(Node&)>;
+
+  /// Creates the graphics object with the factory if there is none yet.
   NodeGraphicsObject const &
   nodeGraphicsObject() const;
 
@@ -70,6 +90,31 @@ public:
   void
   setGraphicsObject(std::unique_ptr<NodeGraphicsObject>&& graphics);
 
+  /// Used to create the graphics object on demand.
+  void
+  setGraphicsObjectFactory(GraphicsObjectFactory factory);
+
+  using SizeChangedCallback = std::function<void(Node const&)>;
+
+  /// Called once the size is recalculated after a data or widget
+  /// change, with or without a graphics object.
+  void
+  setSizeChangedCallback(SizeChangedCallback callback);
+
+  bool
+  hasGraphicsObject() const;
+
+  /// Destroys the graphics object, the position is kept by the node.
+  void
+  releaseGraphicsObject();
+
+  /// Scene position, available with or without a graphics object.
+  QPointF
+  position() const;
+
+  void
+  setPosition(QPointF const& position);
+
   NodeGeometry&
   nodeGeometry();
 
@@ -85,6 +130,21 @@ public:
   NodeDataModel*
   nodeDataModel() const;
 
+  /// Approximate number of bytes the node costs on top of its model:
+  /// the node record, connection tables, graphics object and its share
+  /// of the fonts and the style it uses.
+  std::size_t
+  footprint() const;
+
+  /// While off, onDataUpdated() leaves the connections alone. The scene
+  /// turns it off when it pushes the data held back during a load in
+  /// its own order; the model's signals are still delivered.
+  void
+  setDataForwarding(bool enabled) { _dataForwarding = enabled; }
+
+  bool
+  dataForwarding() const { return _dataForwarding; }
+
 public Q_SLOTS: // data propagation
 
   /// Propagates incoming data to the underlying model.
@@ -101,6 +161,13 @@ public Q_SLOTS: // data propagation
   void
   onNodeSizeUpdated();
 
+Q_SIGNALS:
+
+  /// Emitted by setPosition(), which the scene follows to keep its
+  /// indexes and the connections up to date.
+  void
+  positionChanged();
+
 private:
 
   // addressing
@@ -117,6 +184,16 @@ private:
 
   NodeGeometry _nodeGeometry;
 
-  std::unique_ptr<NodeGraphicsObject> _nodeGraphicsObject;
+  // position while there is no graphics object
+  QPointF _position;
+
+  GraphicsObjectFactory _graphicsObjectFactory;
+
+  SizeChangedCallback _sizeChangedCallback;
+
+  // created lazily, hence mutable
+  mutable std::unique_ptr<NodeGraphicsObject> _nodeGraphicsObject;
+
+  bool _dataForwarding = true;
 };
 }
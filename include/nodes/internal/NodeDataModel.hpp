@@ -90,9 +90,17 @@ public:
   NodeStyle const&
   nodeStyle() const;
 
+  /// Gives the model its own copy of the style.
   void
   setNodeStyle(NodeStyle const& style);
 
+  /// Several models can share one customized style.
+  void
+  setNodeStyle(std::shared_ptr<NodeStyle const> style);
+
+  std::shared_ptr<NodeStyle const> const&
+  sharedNodeStyle() const;
+
 public:
 
   /// Triggers the algorithm
@@ -164,6 +172,7 @@ Q_SIGNALS:
 
 private:
 
-  NodeStyle _nodeStyle;
+  // Points to the StyleCollection's style unless overridden
+  std::shared_ptr<NodeStyle const> _nodeStyle;
 };
 }
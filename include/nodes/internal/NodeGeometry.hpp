@@ -1,5 +1,8 @@
 #pragma once
 
+#include <utility>
+#include <vector>
+
 #include <QtCore/QRectF>
 #include <QtCore/QPointF>
 #include <QtGui/QTransform>
@@ -20,7 +23,10 @@ class NODE_EDITOR_PUBLIC NodeGeometry
 {
 public:
 
-  NodeGeometry(std::unique_ptr<NodeDataModel> const &dataModel);
+  /// The node state, when given, tells which ports are connected so
+  /// they keep their rows when the port window scrolls past them.
+  NodeGeometry(std::unique_ptr<NodeDataModel> const &dataModel,
+               NodeState const *nodeState = nullptr);
 
 public:
   unsigned int
@@ -72,6 +78,45 @@ public:
   setDraggingPosition(QPointF const& pos)
   { _draggingPos = pos; }
 
+public:
+
+  /// Nodes with more port rows than this show a scrollable window of
+  /// this many rows instead of growing. Connected ports outside the
+  /// window keep a row of their own, in port order; the unconnected
+  /// ones are collapsed, neither laid out nor painted. 0 disables the
+  /// limit.
+  unsigned int
+  maxPortRows() const { return _maxPortRows; }
+
+  /// Takes effect with the next recalculateSize().
+  void
+  setMaxPortRows(unsigned int rows);
+
+  /// The number of port rows shown on the node, the window and the
+  /// connected ports outside it.
+  unsigned int
+  portRows() const;
+
+  /// True when the ports don't fit in maxPortRows() rows.
+  bool
+  portsVirtualized() const;
+
+  PortIndex
+  firstVisiblePort() const { return _firstVisiblePort; }
+
+  /// Scrolls the port window by `rows`, negative values scroll up, and
+  /// recalculates the size. Returns true when the visible ports changed.
+  bool
+  scrollPorts(int rows);
+
+  /// Makes the port visible, scrolling as little as possible.
+  bool
+  ensurePortVisible(PortIndex index);
+
+  /// The ports shown on one side in port order.
+  std::vector<PortIndex>
+  visiblePorts(PortType portType) const;
+
 public:
 
   QRectF
@@ -84,10 +129,17 @@ public:
   void
   recalculateSize() const;
 
-  /// Updates size if the QFontMetrics is changed
+  /// Updates size if the font is changed
   void
   recalculateSize(QFont const &font) const;
 
+  /// The port captions or data types changed, the next recalculateSize()
+  /// measures the ports again instead of reusing their widths.
+  void
+  invalidatePortWidths() const;
+
+  /// Collapsed ports are placed on the edge between the rows around
+  /// them.
   // TODO removed default QTransform()
   QPointF
   portScenePosition(PortIndex index,
@@ -116,6 +168,10 @@ public:
   unsigned int
   validationWidth() const;
   
+  /// Bytes of the shared font data attributed to this geometry.
+  std::size_t
+  footprint() const;
+
   static 
   QPointF 
   calculateNodePositionBetweenNodePorts(PortIndex targetPortIndex, PortType targetPort, Node* targetNode,
@@ -132,6 +188,25 @@ private:
   unsigned int
   portWidth(PortType portType) const;
 
+  unsigned int
+  totalPortRows() const;
+
+  /// Keeps the port window inside the ports after a resize.
+  void
+  clampFirstVisiblePort() const;
+
+  /// The number of ports of the window on one side.
+  unsigned int
+  windowPorts(PortType portType) const;
+
+  /// The number of connected ports in [first, last) on one side.
+  unsigned int
+  connectedPorts(PortType portType, PortIndex first, PortIndex last) const;
+
+  /// The row of the port, or of the next shown port if it is collapsed.
+  unsigned int
+  portRow(PortIndex index, PortType portType) const;
+
 private:
 
   // some variables are mutable because
@@ -144,6 +219,7 @@ private:
   unsigned int _entryWidth;
   mutable unsigned int _inputPortWidth;
   mutable unsigned int _outputPortWidth;
+  mutable bool _portWidthsValid;
   mutable unsigned int _entryHeight;
   unsigned int _spacing;
 
@@ -152,11 +228,22 @@ private:
   unsigned int _nSources;
   unsigned int _nSinks;
 
+  unsigned int _maxPortRows;
+  mutable PortIndex _firstVisiblePort;
+
   QPointF _draggingPos;
 
   std::unique_ptr<NodeDataModel> const &_dataModel;
 
-  mutable QFontMetrics _fontMetrics;
-  mutable QFontMetrics _boldFontMetrics;
+  NodeState const *_nodeState;
+
+  // Fonts and metrics shared by all the geometries using the same font
+  struct Fonts;
+
+  static
+  std::shared_ptr<Fonts const>
+  sharedFonts(QFont const &font);
+
+  mutable std::shared_ptr<Fonts const> _fonts;
 };
 }
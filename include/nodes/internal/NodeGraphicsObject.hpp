@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QtCore/QUuid>
+#include <QtGui/QPixmap>
 #include <QtWidgets/QGraphicsObject>
 
 #include "Connection.hpp"
@@ -46,6 +47,11 @@ public:
   void
   moveConnections() const;
 
+  /// Queues the correction of the attached connections, the scene
+  /// applies all the queued corrections at once.
+  void
+  scheduleMoveConnections() const;
+
   enum { Type = UserType + 1 };
 
   int
@@ -54,6 +60,19 @@ public:
   void
   lock(bool locked);
 
+  /// Creates or releases the proxy of the embedded widget
+  /// according to FlowScene::widgetSnapshots().
+  void
+  updateWidgetMode();
+
+  /// Marks the cached snapshot of the embedded widget as outdated.
+  void
+  widgetChanged();
+
+  /// Unembeds the widget so that it outlives this graphics object.
+  void
+  detachEmbeddedWidget();
+
 protected:
   void
   paint(QPainter*                       painter,
@@ -81,6 +100,10 @@ protected:
   void
   hoverMoveEvent(QGraphicsSceneHoverEvent *) override;
 
+  /// Scrolls the port rows of virtualized nodes.
+  void
+  wheelEvent(QGraphicsSceneWheelEvent* event) override;
+
   void
   mouseDoubleClickEvent(QGraphicsSceneMouseEvent* event) override;
 
@@ -91,6 +114,20 @@ private:
   void
   embedQWidget();
 
+  void
+  acquireProxyWidget();
+
+  void
+  releaseProxyWidget();
+
+  /// Releases the proxy on the next event loop iteration if the node
+  /// is neither hovered nor focused by then.
+  void
+  scheduleProxyRelease();
+
+  QPixmap const&
+  widgetSnapshot();
+
 private:
 
   FlowScene & _scene;
@@ -101,5 +138,15 @@ private:
 
   // either nullptr or owned by parent QGraphicsItem
   QGraphicsProxyWidget * _proxyWidget;
+
+  // to the scene's focusItemChanged(), held only while there is a proxy
+  QMetaObject::Connection _proxyFocusConnection;
+
+  // painted instead of the embedded widget while there is no proxy
+  QPixmap _widgetSnapshot;
+
+  bool _widgetSnapshotDirty;
+
+  bool _widgetDetached;
 };
 }
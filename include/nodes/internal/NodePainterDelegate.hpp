@@ -8,7 +8,9 @@
 
 namespace QtNodes {
 
-/// Class to allow for custom painting
+/// Class to allow for custom painting.
+/// Icons and decorations should come from PixmapCache rather than being
+/// loaded on every paint.
 class NODE_EDITOR_PUBLIC NodePainterDelegate
 {
 
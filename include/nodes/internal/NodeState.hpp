@@ -1,6 +1,7 @@
 #pragma once
 
-#include <vector>
+#include <map>
+#include <iterator>
 #include <unordered_map>
 
 #include <QtCore/QUuid>
@@ -17,6 +18,122 @@ namespace QtNodes
 class Connection;
 class NodeDataModel;
 
+/// The connections of the ports on one side of a node.
+/// Behaves like a vector of size() connection sets, but only the
+/// connected ports own a set: the unconnected ones read as empty, so
+/// nodes with thousands of mostly unused ports stay small.
+class NODE_EDITOR_PUBLIC PortConnections
+{
+public:
+
+  using ConnectionPtrSet =
+          std::unordered_map<QUuid, Connection*>;
+
+  using Entries = std::map<PortIndex, ConnectionPtrSet>;
+
+  /// Iterates over the sets of the connected ports only,
+  /// in port order.
+  class const_iterator
+  {
+  public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = ConnectionPtrSet;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = ConnectionPtrSet const*;
+    using reference         = ConnectionPtrSet const&;
+
+    const_iterator() = default;
+
+    explicit
+    const_iterator(Entries::const_iterator it) : _it(it) {}
+
+    reference
+    operator*() const { return _it->second; }
+
+    pointer
+    operator->() const { return &_it->second; }
+
+    PortIndex
+    portIndex() const { return _it->first; }
+
+    const_iterator&
+    operator++() { ++_it; return *this; }
+
+    const_iterator
+    operator++(int) { const_iterator old = *this; ++_it; return old; }
+
+    bool
+    operator==(const_iterator const &other) const { return _it == other._it; }
+
+    bool
+    operator!=(const_iterator const &other) const { return _it != other._it; }
+
+  private:
+
+    Entries::const_iterator _it;
+  };
+
+public:
+
+  explicit
+  PortConnections(std::size_t nPorts = 0);
+
+public:
+
+  std::size_t
+  size() const { return _size; }
+
+  void
+  resize(std::size_t nPorts);
+
+  /// An empty set for the unconnected ports.
+  ConnectionPtrSet const&
+  operator[](PortIndex portIndex) const;
+
+  /// Creates the set of the port if needed.
+  ConnectionPtrSet&
+  operator[](PortIndex portIndex);
+
+  /// Like operator[], throws std::out_of_range for invalid ports.
+  ConnectionPtrSet const&
+  at(PortIndex portIndex) const;
+
+  ConnectionPtrSet&
+  at(PortIndex portIndex);
+
+  /// Removes one connection, dropping the set once it is empty.
+  void
+  erase(PortIndex portIndex, QUuid const &id);
+
+  /// Removes all the connections of the port.
+  void
+  clear(PortIndex portIndex);
+
+  /// The number of ports having at least one set.
+  std::size_t
+  connectedPorts() const { return _entries.size(); }
+
+  Entries const&
+  entries() const { return _entries; }
+
+  const_iterator
+  begin() const { return const_iterator(_entries.cbegin()); }
+
+  const_iterator
+  end() const { return const_iterator(_entries.cend()); }
+
+  /// Approximate heap bytes used by the sets.
+  std::size_t
+  footprint() const;
+
+private:
+
+  std::size_t _size;
+
+  Entries _entries;
+};
+
 /// Contains vectors of connected input and output connections.
 /// Stores bool for reacting on hovering connections
 class NODE_EDITOR_PUBLIC NodeState
@@ -34,15 +151,14 @@ public:
 
 public:
 
-  using ConnectionPtrSet =
-          std::unordered_map<QUuid, Connection*>;
+  using ConnectionPtrSet = PortConnections::ConnectionPtrSet;
 
-  /// Returns vector of connections ID.
-  /// Some of them can be empty (null)
-  std::vector<ConnectionPtrSet> const&
+  /// Returns the per-port connections of one side.
+  /// The sets of unconnected ports are empty.
+  PortConnections const&
   getEntries(PortType) const;
 
-  std::vector<ConnectionPtrSet> &
+  PortConnections &
   getEntries(PortType);
 
   ConnectionPtrSet
@@ -58,6 +174,10 @@ public:
                   PortIndex portIndex,
                   QUuid id);
 
+  void
+  clearConnections(PortType portType,
+                   PortIndex portIndex);
+
   ReactToConnectionState
   reaction() const;
 
@@ -83,10 +203,14 @@ public:
   bool
   resizing() const;
 
+  /// Approximate heap bytes used by the connection tables.
+  std::size_t
+  footprint() const;
+
 private:
 
-  std::vector<ConnectionPtrSet> _inConnections;
-  std::vector<ConnectionPtrSet> _outConnections;
+  PortConnections _inConnections;
+  PortConnections _outConnections;
 
   ReactToConnectionState _reaction;
   PortType     _reactingPortType;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <functional>
+
+#include <QtCore/QSize>
+#include <QtCore/QString>
+#include <QtGui/QImage>
+#include <QtGui/QPixmap>
+
+#include "Export.hpp"
+
+class QPainter;
+
+namespace QtNodes
+{
+
+/// Icons and decorative pixmaps shared by the painters and the
+/// NodePainterDelegate implementations. The entries live in QPixmapCache
+/// and are keyed by their size and device pixel ratio, so they are
+/// decoded or rendered once and only redone when evicted.
+/// Like QPixmapCache it must only be used from the GUI thread.
+class NODE_EDITOR_PUBLIC PixmapCache
+{
+public:
+
+  /// Renders the image of the given size in device pixels.
+  using Generator = std::function<QImage(QSize const& pixelSize)>;
+
+public:
+
+  /// The icon from a resource or a file, `size` being in device
+  /// independent pixels. The result carries the device pixel ratio,
+  /// so it is drawn with the requested size.
+  static
+  QPixmap
+  icon(QString const& path,
+       QSize const& size,
+       qreal devicePixelRatio = 1.0);
+
+  /// A pixmap rendered by `generator` on the first request.
+  /// `key` must identify everything the generator depends on
+  /// except the size and the device pixel ratio.
+  static
+  QPixmap
+  pixmap(QString const& key,
+         QSize const& size,
+         qreal devicePixelRatio,
+         Generator const& generator);
+
+  /// The device pixel ratio of the device the painter draws on.
+  static
+  qreal
+  devicePixelRatio(QPainter const* painter);
+
+  /// Drops all the entries created through this class.
+  static
+  void
+  clear();
+};
+}
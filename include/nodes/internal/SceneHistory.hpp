@@ -0,0 +1,239 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QJsonObject>
+#include <QtCore/QObject>
+#include <QtCore/QPointF>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QUuid>
+
+#include "Export.hpp"
+#include "QUuidStdHash.hpp"
+
+namespace QtNodes
+{
+
+class FlowScene;
+class Node;
+class Connection;
+
+/// Undo and redo for a FlowScene, see FlowScene::history().
+///
+/// The history records small invertible commands as the scene reports
+/// its changes: nodes created and removed, connections made and removed,
+/// node moves, and the model state changes passed to
+/// recordModelStateChange(). The changes made until control returns to
+/// the event loop form one step, beginMacro() and endMacro() group them
+/// explicitly. Successive moves of the same nodes within the move merge
+/// interval, as in a drag, merge into one step.
+///
+/// Undoing or redoing a step takes time in proportion to the step. The
+/// steps are kept within a memory budget and an optional step limit,
+/// dropping the oldest first; a single step above the budget empties
+/// the history.
+class NODE_EDITOR_PUBLIC SceneHistory
+  : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  explicit
+  SceneHistory(FlowScene& scene);
+
+  ~SceneHistory();
+
+public:
+
+  bool canUndo() const;
+
+  bool canRedo() const;
+
+  /// The text of the step undo() reverts.
+  QString undoText() const;
+
+  QString redoText() const;
+
+  std::size_t undoCount() const;
+
+  std::size_t redoCount() const;
+
+  /// The approximate number of bytes held by the steps.
+  qint64 memoryUsage() const;
+
+  /// 32 MiB by default.
+  void setMemoryBudget(qint64 bytes);
+
+  qint64 memoryBudget() const;
+
+  /// 0, the default, doesn't limit the number of steps.
+  void setStepLimit(std::size_t steps);
+
+  std::size_t stepLimit() const;
+
+  /// 1000 ms by default, 0 disables the merging.
+  void setMoveMergeInterval(int msec);
+
+  int moveMergeInterval() const;
+
+  /// Off by default, the steps keep the saved state of the removed
+  /// nodes and connections. The changes made while disabled are not
+  /// recorded; undoing the steps recorded before may then not restore
+  /// the same scene.
+  void setEnabled(bool enabled);
+
+  bool isEnabled() const;
+
+  /// The changes made until the matching endMacro() form one step.
+  /// Macros nest, the outermost one gives the text. undo() and redo()
+  /// do nothing while a macro is open.
+  void beginMacro(QString const& text);
+
+  void endMacro();
+
+  /// Records a change of the model's state made outside the scene,
+  /// e.g. through its embedded widget. `before` is the output of the
+  /// model's save() before the change; only the top level values
+  /// that differ are kept.
+  void recordModelStateChange(Node& node, QJsonObject const& before);
+
+public Q_SLOTS:
+
+  void undo();
+
+  void redo();
+
+  void clear();
+
+Q_SIGNALS:
+
+  /// Emitted when steps are recorded, undone, redone or dropped.
+  void changed();
+
+private:
+
+  struct Command
+  {
+    enum class Kind
+    {
+      CreateNode,
+      RemoveNode,
+      Connect,
+      Disconnect,
+      Move,
+      ModelState
+    };
+
+    Kind kind;
+
+    QUuid node;
+
+    // The saved node or connection; for ModelState the values
+    // before and after the change
+    QJsonObject before;
+    QJsonObject after;
+
+    // ModelState keys missing before or after the change
+    QStringList added;
+    QStringList removed;
+
+    QPointF from;
+    QPointF to;
+  };
+
+  struct Step
+  {
+    QString text;
+
+    std::vector<Command> commands;
+
+    qint64 cost = 0;
+
+    // for merging the moves
+    qint64 time = 0;
+
+    bool macro = false;
+  };
+
+private:
+
+  void onNodeCreated(Node& node);
+
+  void onNodeDeleted(Node& node);
+
+  void onNodeMoved(Node& node, QPointF const& position);
+
+  void onConnectionCreated(Connection const& connection);
+
+  void onConnectionDeleted(Connection const& connection);
+
+  bool recording() const;
+
+  /// The step being recorded, opened if needed.
+  Step& currentStep();
+
+  void closeStep();
+
+  /// Merges a step of moves into the last one if it moves the same nodes.
+  bool mergeMoves(Step& step);
+
+  /// Enforces the budget and the step limit, true if steps were dropped.
+  bool dropSteps();
+
+  void apply(Step& step, bool forward);
+
+  void apply(Command& command, bool forward);
+
+  void restoreConnection(QJsonObject const& connectionJson);
+
+  void removeConnection(QJsonObject const& connectionJson);
+
+  static
+  qint64
+  cost(Step const& step);
+
+  static
+  QString
+  describe(Step const& step);
+
+private:
+
+  FlowScene& _scene;
+
+  std::deque<Step> _undo;
+  std::deque<Step> _redo;
+
+  Step _current;
+
+  bool _open;
+
+  bool _closeScheduled;
+
+  int _macroDepth;
+
+  bool _enabled;
+
+  bool _applying;
+
+  // a step of moves may be merged into the last step
+  bool _mergeAllowed;
+
+  qint64 _memoryUsage;
+  qint64 _memoryBudget;
+
+  std::size_t _stepLimit;
+
+  int _moveMergeInterval;
+
+  QElapsedTimer _clock;
+
+  // nodeMoved() only gives the new position
+  std::unordered_map<QUuid, QPointF> _positions;
+};
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QObject>
+#include <QtCore/QPointF>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include <QtCore/QUuid>
+
+#include "Export.hpp"
+#include "FlowScene.hpp"
+
+namespace QtNodes
+{
+
+class Node;
+class Connection;
+
+/// Keeps a document as a snapshot of the scene plus an append-only
+/// journal of the changes made since, so that saving only writes what
+/// changed.
+///
+/// The journal is a JSON object per line, next to the snapshot in
+/// `<snapshot>.journal`. It records the nodes and connections created
+/// and deleted, the node moves and the model states passed to
+/// recordModelState(). Moves and model states are kept per node until the
+/// next flush(), so only the last one gets written.
+///
+/// compact() replaces the snapshot with the current scene and starts an
+/// empty journal. The journal names the snapshot it applies to by hash,
+/// so a journal left behind by a compaction cut short is recognized as
+/// stale and skipped.
+///
+/// Unless recover() is called first, the first flush() starts a new
+/// journal over the existing one.
+class NODE_EDITOR_PUBLIC SceneJournal
+  : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  SceneJournal(FlowScene& scene,
+               QString const& snapshotFileName,
+               QObject* parent = Q_NULLPTR);
+
+  ~SceneJournal();
+
+public:
+
+  QString snapshotFileName() const;
+
+  QString journalFileName() const;
+
+  /// The format of the snapshots written by compact(), JSON by default.
+  void setSnapshotFormat(SceneFormat format);
+
+  SceneFormat snapshotFormat() const;
+
+  /// Flushes every `msec` milliseconds; 0, the default, disables it.
+  void setAutosaveInterval(int msec);
+
+  int autosaveInterval() const;
+
+  /// flush() compacts once the journal holds that many records;
+  /// 0 disables it. The default is 10000.
+  void setCompactionThreshold(int records);
+
+  int compactionThreshold() const;
+
+  bool hasPendingChanges() const;
+
+  /// The records written to the journal since the last compaction.
+  int journalRecordCount() const;
+
+  /// Loads the document: clears the scene, loads the snapshot if there
+  /// is one and replays the journal. A record cut short by a crash ends
+  /// the replay and is dropped from the file. Replayed changes are not
+  /// recorded again. Returns the number of journal records replayed;
+  /// throws std::logic_error if the snapshot can't be read.
+  int recover();
+
+public Q_SLOTS:
+
+  /// Records the state of a model changed outside the scene,
+  /// e.g. through its embedded widget.
+  void recordModelState(Node const& node);
+
+  /// Appends the pending records to the journal. On failure the
+  /// records are kept and false is returned.
+  bool flush();
+
+  /// Writes the scene as the new snapshot and empties the journal.
+  bool compact();
+
+private:
+
+  void onNodeCreated(Node& node);
+
+  void onNodeDeleted(Node& node);
+
+  void onNodeMoved(Node& node, QPointF const& position);
+
+  void onConnectionCreated(Connection const& connection);
+
+  void onConnectionDeleted(Connection const& connection);
+
+  /// Replaces the journal with one holding the snapshot record only.
+  bool startJournal();
+
+  void replay(QJsonObject const& record);
+
+  Connection* findConnection(QJsonObject const& connectionJson) const;
+
+private:
+
+  FlowScene& _scene;
+
+  QString _snapshotFileName;
+
+  SceneFormat _snapshotFormat;
+
+  QTimer _autosaveTimer;
+
+  int _compactionThreshold;
+
+  int _journalRecords;
+
+  // the journal on disk belongs to the current snapshot
+  bool _journalStarted;
+
+  bool _snapshotHashKnown;
+
+  QByteArray _snapshotHash;
+
+  bool _replaying;
+
+  // creations and deletions in order; created nodes are
+  // saved when flushed, with the state they have then
+  std::vector<QJsonObject> _pendingRecords;
+
+  std::unordered_map<QUuid, QPointF> _pendingMoves;
+
+  std::unordered_set<QUuid> _pendingModelStates;
+};
+}
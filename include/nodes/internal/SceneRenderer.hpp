@@ -0,0 +1,108 @@
+#pragma once
+
+#include <QtCore/QPoint>
+#include <QtCore/QRectF>
+#include <QtCore/QSize>
+#include <QtGui/QColor>
+#include <QtGui/QImage>
+
+#include <functional>
+
+#include "Export.hpp"
+
+class QIODevice;
+class QThreadPool;
+
+namespace QtNodes
+{
+
+class FlowScene;
+
+/// Renders a FlowScene offscreen, tile by tile.
+/// Nodes and connections are recorded once with NodePainter and
+/// ConnectionPainter on the calling thread, the tiles are then
+/// rasterized in parallel on a QThreadPool and handed over in row-major
+/// order, so the whole bitmap is never held in memory. Only QImage is
+/// rendered into, which works with the offscreen platform plugin.
+///
+/// Must be used from the GUI thread: the recording goes through the text
+/// layout cache, QPixmapCache and the shared node fonts, none of which is
+/// locked, and may create and release the graphics objects of a lazy
+/// scene. Only the rasterization of the tiles runs on the pool.
+class NODE_EDITOR_PUBLIC SceneRenderer
+{
+public:
+
+  struct Tile
+  {
+    int row;
+    int column;
+
+    /// Position of the tile in the whole output image.
+    QPoint offset;
+
+    QImage image;
+  };
+
+  /// Called on the GUI thread for each tile.
+  /// Returning false stops the rendering.
+  using TileSink = std::function<bool(Tile const&)>;
+
+  SceneRenderer(FlowScene &scene);
+
+public:
+
+  /// The scene area to render. By default, or when set to an empty
+  /// rect, the area covering all the nodes and connections.
+  void
+  setSceneRect(QRectF const &rect);
+
+  /// Output pixels per scene unit, 1.0 by default.
+  void
+  setScale(double scale);
+
+  /// 1024x1024 by default.
+  void
+  setTileSize(QSize const &size);
+
+  /// The FlowViewStyle background by default.
+  void
+  setBackgroundColor(QColor const &color);
+
+  /// QThreadPool::globalInstance() by default.
+  void
+  setThreadPool(QThreadPool *pool);
+
+public:
+
+  bool
+  render(TileSink const &sink);
+
+  /// Streams one PNG image to the device.
+  bool
+  renderToPng(QIODevice &device);
+
+  bool
+  renderToPng(QString const &fileName);
+
+  /// Writes one PNG file per tile,
+  /// named `<baseName>_<row>_<column>.png`.
+  bool
+  renderToTileFiles(QString const &directory,
+                    QString const &baseName = QStringLiteral("tile"));
+
+private:
+
+  FlowScene &_scene;
+
+  QRectF _sceneRect;
+
+  double _scale;
+
+  QSize _tileSize;
+
+  QColor _backgroundColor;
+
+  QThreadPool *_threadPool;
+};
+}
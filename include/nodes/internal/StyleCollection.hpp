@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "NodeStyle.hpp"
 #include "ConnectionStyle.hpp"
 #include "FlowViewStyle.hpp"
@@ -16,6 +18,11 @@ public:
   NodeStyle const&
   nodeStyle();
 
+  /// The default node style, shared by all the models without an override.
+  static
+  std::shared_ptr<NodeStyle const>
+  sharedNodeStyle();
+
   static
   ConnectionStyle const&
   connectionStyle();
@@ -53,7 +60,7 @@ private:
 
 private:
 
-  NodeStyle _nodeStyle;
+  std::shared_ptr<NodeStyle const> _nodeStyle = std::make_shared<NodeStyle const>();
 
   ConnectionStyle _connectionStyle;
 
@@ -17,6 +17,7 @@
 #include "ConnectionState.hpp"
 #include "ConnectionGeometry.hpp"
 #include "ConnectionGraphicsObject.hpp"
+#include "FastUuid.hpp"
 
 using QtNodes::Connection;
 using QtNodes::PortType;
@@ -28,12 +29,13 @@ using QtNodes::NodeDataType;
 using QtNodes::ConnectionGraphicsObject;
 using QtNodes::ConnectionGeometry;
 using QtNodes::TypeConverter;
+using QtNodes::FastUuid;
 
 Connection::
 Connection(PortType portType,
            Node& node,
            PortIndex portIndex)
-  : _uid(QUuid::createUuid())
+  : _uid(FastUuid::create())
   , _outPortIndex(INVALID)
   , _inPortIndex(INVALID)
   , _connectionState()
@@ -50,7 +52,7 @@ Connection(Node& nodeIn,
            Node& nodeOut,
            PortIndex portIndexOut,
            TypeConverter typeConverter)
-  : _uid(QUuid::createUuid())
+  : _uid(FastUuid::create())
   , _outNode(&nodeOut)
   , _inNode(&nodeIn)
   , _outPortIndex(portIndexOut)
@@ -73,12 +75,12 @@ Connection::
 
   propagateEmptyData();
 
-  if (_inNode)
+  if (_inNode && _inNode->hasGraphicsObject())
   {
     _inNode->nodeGraphicsObject().update();
   }
 
-  if (_outNode)
+  if (_outNode && _outNode->hasGraphicsObject())
   {
     _outNode->nodeGraphicsObject().update();
   }
@@ -93,10 +95,10 @@ save() const
 
   if (_inNode && _outNode)
   {
-    connectionJson["in_id"] = _inNode->id().toString();
+    connectionJson["in_id"] = FastUuid::toString(_inNode->id());
     connectionJson["in_index"] = _inPortIndex;
 
-    connectionJson["out_id"] = _outNode->id().toString();
+    connectionJson["out_id"] = FastUuid::toString(_outNode->id());
     connectionJson["out_index"] = _outPortIndex;
 
     if (_converter)
@@ -194,12 +196,12 @@ setGraphicsObject(std::unique_ptr<ConnectionGraphicsObject>&& graphics)
 
     auto node = getNode(attachedPort);
 
-    QTransform nodeSceneTransform =
-      node->nodeGraphicsObject().sceneTransform();
+    QPointF const nodePos = node->position();
 
     QPointF pos = node->nodeGeometry().portScenePosition(attachedPortIndex,
                                                          attachedPort,
-                                                         nodeSceneTransform);
+                                                         QTransform::fromTranslate(nodePos.x(),
+                                                                                   nodePos.y()));
 
     _connectionGraphicsObject->setPos(pos);
   }
@@ -208,6 +210,30 @@ setGraphicsObject(std::unique_ptr<ConnectionGraphicsObject>&& graphics)
 }
 
 
+void
+Connection::
+setGraphicsObjectFactory(GraphicsObjectFactory factory)
+{
+  _graphicsObjectFactory = std::move(factory);
+}
+
+
+bool
+Connection::
+hasGraphicsObject() const
+{
+  return _connectionGraphicsObject != nullptr;
+}
+
+
+void
+Connection::
+releaseGraphicsObject()
+{
+  _connectionGraphicsObject.reset();
+}
+
+
 
 PortIndex
 Connection::
@@ -276,6 +302,14 @@ ConnectionGraphicsObject&
 Connection::
 getConnectionGraphicsObject() const
 {
+  if (!_connectionGraphicsObject && _graphicsObjectFactory)
+  {
+    // creating the graphics object does not change the connection itself
+    auto self = const_cast<Connection*>(this);
+
+    self->setGraphicsObject(_graphicsObjectFactory(*self));
+  }
+
   return *_connectionGraphicsObject;
 }
 
@@ -425,6 +459,14 @@ setTypeConverter(TypeConverter converter)
 }
 
 
+bool
+Connection::
+hasTypeConverter() const
+{
+  return static_cast<bool>(_converter);
+}
+
+
 void
 Connection::
 propagateData(std::shared_ptr<NodeData> nodeData) const
@@ -13,6 +13,7 @@
 #include "ConnectionPainter.hpp"
 #include "ConnectionState.hpp"
 #include "ConnectionBlurEffect.hpp"
+#include "ConnectionLayer.hpp"
 
 #include "NodeGraphicsObject.hpp"
 
@@ -41,12 +42,24 @@ ConnectionGraphicsObject(FlowScene &scene,
   // addGraphicsEffect();
 
   setZValue(-1.0);
+
+  // A connection being dragged is never batched
+  connect(&_connection, &Connection::connectionMadeIncomplete,
+          this, [this] { setVisible(true); });
+
+  connect(&_connection, &Connection::connectionCompleted,
+          this, [this] { updateBatching(); });
+
+  updateBatching();
 }
 
 
 ConnectionGraphicsObject::
 ~ConnectionGraphicsObject()
 {
+  if (auto layer = _scene.connectionLayer())
+    layer->connectionRemoved(*this);
+
   _scene.removeItem(this);
 }
 
@@ -100,18 +113,21 @@ void
 ConnectionGraphicsObject::
 move()
 {
+  QRectF const oldSceneRect = mapRectToScene(boundingRect());
+
   for(PortType portType: { PortType::In, PortType::Out } )
   {
     if (auto node = _connection.getNode(portType))
     {
-      auto const &nodeGraphics = node->nodeGraphicsObject();
+      // the node's graphics object may not exist yet
+      QPointF const nodePos = node->position();
 
       auto const &nodeGeom = node->nodeGeometry();
 
       QPointF scenePos =
         nodeGeom.portScenePosition(_connection.getPortIndex(portType),
                                    portType,
-                                   nodeGraphics.sceneTransform());
+                                   QTransform::fromTranslate(nodePos.x(), nodePos.y()));
 
       QTransform sceneTransform = this->sceneTransform();
 
@@ -125,6 +141,14 @@ move()
     }
   }
 
+  if (auto layer = _scene.connectionLayer())
+  {
+    if (!isVisible())
+    {
+      layer->update(oldSceneRect);
+      layer->connectionMoved(*this);
+    }
+  }
 }
 
 void ConnectionGraphicsObject::lock(bool locked)
@@ -135,6 +159,27 @@ void ConnectionGraphicsObject::lock(bool locked)
 }
 
 
+void
+ConnectionGraphicsObject::
+updateBatching()
+{
+  auto layer = _scene.connectionLayer();
+
+  bool const individual = (layer == nullptr) ||
+                          !_connection.complete() ||
+                          _connection.connectionGeometry().hovered() ||
+                          isSelected();
+
+  if (individual == isVisible())
+    return;
+
+  setVisible(individual);
+
+  if (layer)
+    layer->connectionMoved(*this);
+}
+
+
 void
 ConnectionGraphicsObject::
 paint(QPainter* painter,
@@ -242,6 +287,23 @@ hoverLeaveEvent(QGraphicsSceneHoverEvent* event)
   update();
   _scene.connectionHoverLeft(connection());
   event->accept();
+
+  updateBatching();
+}
+
+
+QVariant
+ConnectionGraphicsObject::
+itemChange(GraphicsItemChange change, const QVariant &value)
+{
+  if (change == ItemSelectedHasChanged)
+  {
+    _scene.connectionSelectionChanged(_connection, value.toBool());
+
+    updateBatching();
+  }
+
+  return QGraphicsItem::itemChange(change, value);
 }
 
 
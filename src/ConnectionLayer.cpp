@@ -0,0 +1,258 @@
+#include "ConnectionLayer.hpp"
+
+#include <unordered_map>
+
+#include <QtGui/QPainter>
+#include <QtWidgets/QStyleOptionGraphicsItem>
+
+#include "FlowScene.hpp"
+#include "Connection.hpp"
+#include "ConnectionGeometry.hpp"
+#include "ConnectionGraphicsObject.hpp"
+#include "ConnectionPainter.hpp"
+#include "StyleCollection.hpp"
+
+using QtNodes::ConnectionLayer;
+using QtNodes::ConnectionGraphicsObject;
+using QtNodes::ConnectionGeometry;
+using QtNodes::Connection;
+using QtNodes::FlowScene;
+using QtNodes::PortType;
+
+ConnectionLayer::
+ConnectionLayer(FlowScene &scene)
+  : _scene(scene)
+  , _promoted(nullptr)
+{
+  _scene.addItem(this);
+
+  setAcceptedMouseButtons(Qt::NoButton);
+  setAcceptHoverEvents(false);
+
+  // below the individual connections (-1.0) and the nodes (0.0)
+  setZValue(-2.0);
+}
+
+
+ConnectionLayer::
+~ConnectionLayer()
+{
+  _scene.removeItem(this);
+}
+
+
+QRectF
+ConnectionLayer::
+boundingRect() const
+{
+  return _bounds;
+}
+
+
+QPainterPath
+ConnectionLayer::
+shape() const
+{
+  return QPainterPath();
+}
+
+
+void
+ConnectionLayer::
+connectionMoved(ConnectionGraphicsObject &cgo)
+{
+  QRectF const r = cgo.mapRectToScene(cgo.boundingRect());
+
+  _grid.insert(&cgo, r);
+
+  if (!_bounds.contains(r))
+  {
+    prepareGeometryChange();
+    _bounds = _bounds.united(r);
+  }
+
+  update(r);
+}
+
+
+void
+ConnectionLayer::
+connectionRemoved(ConnectionGraphicsObject const &cgo)
+{
+  if (_promoted == &cgo)
+    _promoted = nullptr;
+
+  auto item = const_cast<ConnectionGraphicsObject*>(&cgo);
+
+  auto it = _grid.rects().find(item);
+
+  if (it == _grid.rects().end())
+    return;
+
+  QRectF const r = it->second;
+
+  _grid.remove(item);
+
+  update(r);
+
+  // only a connection on the edge holds the bounds out
+  if (r.left() <= _bounds.left() || r.top() <= _bounds.top() ||
+      r.right() >= _bounds.right() || r.bottom() >= _bounds.bottom())
+    resetBounds();
+}
+
+
+void
+ConnectionLayer::
+resetBounds()
+{
+  QRectF bounds;
+
+  for (auto const & pair : _grid.rects())
+    bounds = bounds.united(pair.second);
+
+  prepareGeometryChange();
+  _bounds = bounds;
+}
+
+
+ConnectionGraphicsObject*
+ConnectionLayer::
+promoteAt(QPointF const &scenePoint)
+{
+  auto hits =
+    [&](ConnectionGraphicsObject &cgo)
+    {
+      Connection const &connection = cgo.connection();
+
+      QPointF const p = scenePoint - cgo.pos();
+
+      ConnectionGeometry const &geom = connection.connectionGeometry();
+
+      return geom.boundingRect().contains(p) &&
+             ConnectionPainter::getPainterStroke(geom).contains(p);
+    };
+
+  if (_promoted)
+  {
+    if (hits(*_promoted))
+      return _promoted;
+
+    // batched again unless hovered or selected meanwhile
+    ConnectionGraphicsObject* promoted = _promoted;
+    _promoted = nullptr;
+    promoted->updateBatching();
+  }
+
+  for (ConnectionGraphicsObject* cgo : _grid.query(scenePoint))
+  {
+    if (cgo->isVisible() || !cgo->connection().complete())
+      continue;
+
+    if (hits(*cgo))
+    {
+      cgo->setVisible(true);
+      update(cgo->mapRectToScene(cgo->boundingRect()));
+
+      _promoted = cgo;
+
+      return cgo;
+    }
+  }
+
+  return nullptr;
+}
+
+
+void
+ConnectionLayer::
+promote(ConnectionGraphicsObject &cgo)
+{
+  if (cgo.isVisible())
+    return;
+
+  cgo.setVisible(true);
+  update(cgo.mapRectToScene(cgo.boundingRect()));
+}
+
+
+void
+ConnectionLayer::
+paint(QPainter* painter,
+      QStyleOptionGraphicsItem const* option,
+      QWidget*)
+{
+  QRectF const exposed = option->exposedRect;
+
+  painter->setClipRect(exposed);
+
+  auto const &connectionStyle = StyleCollection::connectionStyle();
+
+  // Lines sharing a color are collected into one path and stroked once.
+  std::unordered_map<QRgb, QPainterPath> lines;
+
+  QPainterPath endPoints;
+  endPoints.setFillRule(Qt::WindingFill);
+
+  double const pointRadius = connectionStyle.pointDiameter() / 2.0;
+
+  for (ConnectionGraphicsObject* item : _grid.query(exposed))
+  {
+    ConnectionGraphicsObject &cgo = *item;
+
+    Connection const &connection = cgo.connection();
+
+    // promoted connections are drawn by their own item
+    if (cgo.isVisible() || !connection.complete())
+      continue;
+
+    ConnectionGeometry const &geom = connection.connectionGeometry();
+
+    QPointF const offset = cgo.pos();
+
+    if (!exposed.intersects(geom.boundingRect().translated(offset)))
+      continue;
+
+    QColor color = connectionStyle.normalColor();
+
+    if (connectionStyle.useDataDefinedColors())
+    {
+      auto const dataTypeOut = connection.dataType(PortType::Out);
+      auto const dataTypeIn  = connection.dataType(PortType::In);
+
+      if (dataTypeOut.id != dataTypeIn.id)
+      {
+        // gradient lines with a converter icon keep the individual look
+        painter->save();
+        painter->translate(offset);
+        ConnectionPainter::paint(painter, connection);
+        painter->restore();
+        continue;
+      }
+
+      color = connectionStyle.normalColor(dataTypeOut.id);
+    }
+
+    lines[color.rgba()].addPath(ConnectionPainter::cubicPath(geom).translated(offset));
+
+    endPoints.addEllipse(geom.source() + offset, pointRadius, pointRadius);
+    endPoints.addEllipse(geom.sink() + offset, pointRadius, pointRadius);
+  }
+
+  QPen p;
+  p.setWidth(connectionStyle.lineWidth());
+
+  painter->setBrush(Qt::NoBrush);
+
+  for (auto const & pair : lines)
+  {
+    p.setColor(QColor::fromRgba(pair.first));
+    painter->setPen(p);
+    painter->drawPath(pair.second);
+  }
+
+  painter->setPen(connectionStyle.constructionColor());
+  painter->setBrush(connectionStyle.constructionColor());
+  painter->drawPath(endPoints);
+}
+
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QtWidgets/QGraphicsItem>
+
+#include "Export.hpp"
+#include "SceneGrid.hpp"
+
+namespace QtNodes
+{
+
+class FlowScene;
+class ConnectionGraphicsObject;
+
+/// Scene-level item drawing all the "batched" connections at once.
+/// A connection is batched while its ConnectionGraphicsObject is hidden,
+/// i.e. when it is complete, not hovered and not selected. Connections
+/// sharing the same pen are stroked with a single call.
+///
+/// The layer keeps the batched connections in a uniform grid of their
+/// scene rects, so painting and hover lookups only visit the connections
+/// near the exposed rect or the cursor.
+class NODE_EDITOR_PUBLIC ConnectionLayer
+  : public QGraphicsItem
+{
+public:
+
+  ConnectionLayer(FlowScene &scene);
+
+  ~ConnectionLayer();
+
+  enum { Type = UserType + 3 };
+
+  int
+  type() const override { return Type; }
+
+public:
+
+  QRectF
+  boundingRect() const override;
+
+  /// Empty shape: the layer never intercepts mouse events,
+  /// `itemAt` and the hover logic skip it.
+  QPainterPath
+  shape() const override;
+
+  /// Files the connection under its current scene rect, grows the layer
+  /// bounds if needed and schedules a repaint of the area it covers.
+  void
+  connectionMoved(ConnectionGraphicsObject &cgo);
+
+  /// Forgets the connection and shrinks the bounds if it was on their edge.
+  void
+  connectionRemoved(ConnectionGraphicsObject const &cgo);
+
+  /// Recomputes the bounds from the filed connections.
+  void
+  resetBounds();
+
+  /// Finds a batched connection under the scene point and turns it
+  /// into an individual interactive item. The connection promoted by
+  /// the previous call is batched again once the point leaves it.
+  ConnectionGraphicsObject*
+  promoteAt(QPointF const &scenePoint);
+
+  /// Turns a batched connection into an individual item, so that it can
+  /// be selected: Qt doesn't select hidden items. It is batched again by
+  /// ConnectionGraphicsObject::updateBatching().
+  void
+  promote(ConnectionGraphicsObject &cgo);
+
+protected:
+
+  void
+  paint(QPainter* painter,
+        QStyleOptionGraphicsItem const* option,
+        QWidget* widget = 0) override;
+
+private:
+
+  FlowScene & _scene;
+
+  QRectF _bounds;
+
+  SceneGrid<ConnectionGraphicsObject*> _grid;
+
+  ConnectionGraphicsObject* _promoted;
+};
+}
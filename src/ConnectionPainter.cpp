@@ -1,7 +1,5 @@
 #include "ConnectionPainter.hpp"
 
-#include <QtGui/QIcon>
-
 #include "ConnectionGeometry.hpp"
 #include "ConnectionState.hpp"
 #include "ConnectionGraphicsObject.hpp"
@@ -10,15 +8,17 @@
 #include "NodeData.hpp"
 
 #include "StyleCollection.hpp"
+#include "PixmapCache.hpp"
 
 
 using QtNodes::ConnectionPainter;
 using QtNodes::ConnectionGeometry;
 using QtNodes::Connection;
+using QtNodes::PixmapCache;
 
 
-static
 QPainterPath
+ConnectionPainter::
 cubicPath(ConnectionGeometry const& geom)
 {
   QPointF const& source = geom.source();
@@ -39,7 +39,7 @@ QPainterPath
 ConnectionPainter::
 getPainterStroke(ConnectionGeometry const& geom)
 {
-  auto cubic = cubicPath(geom);
+  auto cubic = ConnectionPainter::cubicPath(geom);
 
   QPointF const& source = geom.source();
   QPainterPath result(source);
@@ -86,7 +86,7 @@ debugDrawing(QPainter * painter,
 
     painter->setBrush(Qt::NoBrush);
 
-    painter->drawPath(cubicPath(geom));
+    painter->drawPath(ConnectionPainter::cubicPath(geom));
   }
 
   {
@@ -123,7 +123,7 @@ drawSketchLine(QPainter * painter,
     using QtNodes::ConnectionGeometry;
     ConnectionGeometry const& geom = connection.connectionGeometry();
 
-    auto cubic = cubicPath(geom);
+    auto cubic = ConnectionPainter::cubicPath(geom);
     // cubic spline
     painter->drawPath(cubic);
   }
@@ -162,7 +162,7 @@ drawHoveredOrSelected(QPainter * painter,
     painter->setBrush(Qt::NoBrush);
 
     // cubic spline
-    auto cubic = cubicPath(geom);
+    auto cubic = ConnectionPainter::cubicPath(geom);
     painter->drawPath(cubic);
   }
 }
@@ -221,7 +221,7 @@ drawNormalLine(QPainter * painter,
   bool const selected = graphicsObject.isSelected();
 
 
-  auto cubic = cubicPath(geom);
+  auto cubic = ConnectionPainter::cubicPath(geom);
   if (gradientColor)
   {
     painter->setBrush(Qt::NoBrush);
@@ -253,13 +253,17 @@ drawNormalLine(QPainter * painter,
     }
 
     {
-      QIcon icon(":convert.png");
+      qreal const dpr = PixmapCache::devicePixelRatio(painter);
 
-      QPixmap pixmap = icon.pixmap(QSize(22, 22));
-      painter->drawPixmap(cubic.pointAtPercent(0.50) - QPoint(pixmap.width()/2,
-                                                              pixmap.height()/2),
-                          pixmap);
+      QPixmap const pixmap = PixmapCache::icon(QStringLiteral(":convert.png"),
+                                               QSize(22, 22),
+                                               dpr);
+
+      QSizeF const size = QSizeF(pixmap.size()) / dpr;
 
+      painter->drawPixmap(cubic.pointAtPercent(0.50) - QPointF(size.width() / 2,
+                                                               size.height() / 2),
+                          pixmap);
     }
   }
   else
@@ -21,5 +21,9 @@ public:
   static
   QPainterPath
   getPainterStroke(ConnectionGeometry const& geom);
+
+  static
+  QPainterPath
+  cubicPath(ConnectionGeometry const& geom);
 };
 }
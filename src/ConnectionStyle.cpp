@@ -1,23 +1,73 @@
 #include "ConnectionStyle.hpp"
 
 #include <iostream>
+#include <unordered_map>
 
 #include <QtCore/QFile>
 #include <QtCore/QJsonDocument>
 #include <QtCore/QJsonObject>
 #include <QtCore/QJsonValueRef>
 #include <QtCore/QJsonArray>
+#include <QtCore/QReadWriteLock>
 
 #include <QDebug>
 
 #include "StyleCollection.hpp"
+#include "QStringStdHash.hpp"
 
 using QtNodes::ConnectionStyle;
 
 inline void initResources() { Q_INIT_RESOURCE(resources); }
 
+
+class ConnectionStyle::TypeColorCache
+{
+public:
+
+  TypeColorCache() = default;
+
+  TypeColorCache(TypeColorCache const &other)
+  {
+    QReadLocker locker(&other.lock);
+
+    colors = other.colors;
+  }
+
+  mutable QReadWriteLock lock;
+
+  std::unordered_map<QString, QColor> colors;
+};
+
+
+static
+QColor
+generateTypeColor(QString const &typeId)
+{
+  // FNV-1a over UTF-16 code units: the same color in every run,
+  // on every platform, without touching the global RNG.
+  quint32 hash = 2166136261u;
+
+  for (QChar const c : typeId)
+  {
+    hash ^= c.unicode();
+    hash *= 16777619u;
+  }
+
+  // spreads similar ids over the hue range
+  hash ^= hash >> 15;
+  hash *= 0x2c1b3c6du;
+  hash ^= hash >> 12;
+
+  int const hue = hash % 0xFF;
+  int const sat = 120 + (hash >> 8) % 129;
+
+  return QColor::fromHsl(hue, sat, 160);
+}
+
+
 ConnectionStyle::
 ConnectionStyle()
+  : _typeColors(std::make_shared<TypeColorCache>())
 {
   // Explicit resources inialization for preventing the static initialization
   // order fiasco: https://isocpp.org/wiki/faq/ctors#static-init-order
@@ -30,6 +80,7 @@ ConnectionStyle()
 
 ConnectionStyle::
 ConnectionStyle(QString jsonText)
+  : _typeColors(std::make_shared<TypeColorCache>())
 {
   loadJsonFile(":DefaultStyle.json");
   loadJsonText(jsonText);
@@ -139,6 +190,25 @@ loadJsonFromByteArray(QByteArray const &byteArray)
   CONNECTION_STYLE_READ_FLOAT(obj, PointDiameter);
 
   CONNECTION_STYLE_READ_BOOL(obj, UseDataDefinedColors);
+
+  QJsonObject typeColors = obj["DataTypeColors"].toObject();
+
+  for (auto it = typeColors.begin(); it != typeColors.end(); ++it)
+  {
+    QJsonValue const value = it.value();
+
+    if (value.isArray())
+    {
+      QJsonArray const rgb = value.toArray();
+
+      if (rgb.size() >= 3)
+        setTypeColor(it.key(), QColor(rgb[0].toInt(), rgb[1].toInt(), rgb[2].toInt()));
+    }
+    else
+    {
+      setTypeColor(it.key(), QColor(value.toString()));
+    }
+  }
 }
 
 
@@ -162,18 +232,34 @@ QColor
 ConnectionStyle::
 normalColor(QString typeId) const
 {
-  std::size_t hash = qHash(typeId);
+  {
+    QReadLocker locker(&_typeColors->lock);
+
+    auto it = _typeColors->colors.find(typeId);
 
-  std::size_t const hue_range = 0xFF;
+    if (it != _typeColors->colors.end())
+      return it->second;
+  }
+
+  QColor const color = generateTypeColor(typeId);
+
+  QWriteLocker locker(&_typeColors->lock);
+
+  // another thread could have inserted the same id in the meantime
+  return _typeColors->colors.emplace(std::move(typeId), color).first->second;
+}
 
-  qsrand(hash);
-  std::size_t hue = qrand() % hue_range;
 
-  std::size_t sat = 120 + hash % 129;
+void
+ConnectionStyle::
+setTypeColor(QString const &typeId, QColor const &color)
+{
+  if (_typeColors.use_count() > 1)
+    _typeColors = std::make_shared<TypeColorCache>(*_typeColors);
+
+  QWriteLocker locker(&_typeColors->lock);
 
-  return QColor::fromHsl(hue,
-                         sat,
-                         160);
+  _typeColors->colors[typeId] = color;
 }
 
 
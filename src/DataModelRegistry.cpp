@@ -63,3 +63,11 @@ getTypeConverter(NodeDataType const & d1,
 
   return TypeConverter{};
 }
+
+
+bool
+DataModelRegistry::
+concurrentRestore(QString const &modelName) const
+{
+  return _concurrentRestoreModels.count(modelName) != 0;
+}
@@ -0,0 +1,234 @@
+#include "FastUuid.hpp"
+
+#include <atomic>
+
+using QtNodes::FastUuid;
+
+namespace
+{
+
+// the braced form and where its dashes are
+int const BracedLength = 38;
+
+int const DashPositions[] = { 9, 14, 19, 24 };
+
+char const HexDigits[] = "0123456789abcdef";
+
+
+quint64
+rotl(quint64 x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+
+/// xoshiro256**; with 256 bits of state the sequences of the threads
+/// don't overlap in practice.
+struct Xoshiro256
+{
+  Xoshiro256()
+  {
+    // the full 128 bits of two random uuids
+    for (int i = 0; i < 2; ++i)
+    {
+      QUuid const random = QUuid::createUuid();
+
+      s[2 * i] = (quint64(random.data1) << 32) |
+                 (quint64(random.data2) << 16) |
+                 random.data3;
+
+      s[2 * i + 1] = 0;
+
+      for (uchar byte : random.data4)
+        s[2 * i + 1] = (s[2 * i + 1] << 8) | byte;
+    }
+
+    // threads seeded from a weak source still differ
+    static std::atomic<quint64> threads(0);
+
+    s[0] ^= ++threads * 0x9e3779b97f4a7c15ULL;
+
+    // the all zero state is a fixed point
+    if ((s[0] | s[1] | s[2] | s[3]) == 0)
+      s[0] = 1;
+  }
+
+  quint64
+  next()
+  {
+    quint64 const result = rotl(s[1] * 5, 7) * 9;
+    quint64 const t      = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+
+    s[2] ^= t;
+
+    s[3] = rotl(s[3], 45);
+
+    return result;
+  }
+
+  quint64 s[4];
+};
+
+
+/// The value of a hex digit, or -1.
+struct HexTable
+{
+  HexTable()
+  {
+    for (int &value : values)
+      value = -1;
+
+    for (int i = 0; i < 10; ++i)
+      values['0' + i] = i;
+
+    for (int i = 0; i < 6; ++i)
+    {
+      values['a' + i] = 10 + i;
+      values['A' + i] = 10 + i;
+    }
+  }
+
+  int values[128];
+};
+
+
+int
+hexValue(ushort c)
+{
+  static HexTable const table;
+
+  return c < 128 ? table.values[c] : -1;
+}
+
+
+/// Writes the hex digits of `count` bytes of the value, high byte first.
+QChar*
+writeHex(QChar *out, quint64 value, int count)
+{
+  for (int shift = (count - 1) * 8; shift >= 0; shift -= 8)
+  {
+    uchar const byte = uchar(value >> shift);
+
+    *out++ = QLatin1Char(HexDigits[byte >> 4]);
+    *out++ = QLatin1Char(HexDigits[byte & 0xf]);
+  }
+
+  return out;
+}
+
+
+/// Reads the hex digits of `count` bytes; false on a non-digit.
+bool
+readHex(QChar const *in, int count, quint64 &value)
+{
+  value = 0;
+
+  for (int i = 0; i < count * 2; ++i)
+  {
+    int const digit = hexValue(in[i].unicode());
+
+    if (digit < 0)
+      return false;
+
+    value = (value << 4) | quint64(digit);
+  }
+
+  return true;
+}
+}
+
+
+QUuid
+FastUuid::
+create()
+{
+  thread_local Xoshiro256 generator;
+
+  quint64 const high = generator.next();
+  quint64 const low  = generator.next();
+
+  // version 4, variant 10
+  return QUuid(uint(high >> 32),
+               ushort(high >> 16),
+               ushort((high & 0x0fff) | 0x4000),
+               uchar(((low >> 56) & 0x3f) | 0x80),
+               uchar(low >> 48),
+               uchar(low >> 40),
+               uchar(low >> 32),
+               uchar(low >> 24),
+               uchar(low >> 16),
+               uchar(low >> 8),
+               uchar(low));
+}
+
+
+QString
+FastUuid::
+toString(QUuid const &id)
+{
+  QString text(BracedLength, Qt::Uninitialized);
+
+  QChar *out = text.data();
+
+  quint64 clockSeq = (quint64(id.data4[0]) << 8) | id.data4[1];
+  quint64 node     = 0;
+
+  for (int i = 2; i < 8; ++i)
+    node = (node << 8) | id.data4[i];
+
+  *out++ = QLatin1Char('{');
+  out = writeHex(out, id.data1, 4);
+  *out++ = QLatin1Char('-');
+  out = writeHex(out, id.data2, 2);
+  *out++ = QLatin1Char('-');
+  out = writeHex(out, id.data3, 2);
+  *out++ = QLatin1Char('-');
+  out = writeHex(out, clockSeq, 2);
+  *out++ = QLatin1Char('-');
+  out = writeHex(out, node, 6);
+  *out++ = QLatin1Char('}');
+
+  return text;
+}
+
+
+QUuid
+FastUuid::
+fromString(QString const &text)
+{
+  QChar const *in = text.constData();
+
+  bool braced = text.size() == BracedLength &&
+                in[0] == QLatin1Char('{') &&
+                in[BracedLength - 1] == QLatin1Char('}');
+
+  for (int position : DashPositions)
+    braced = braced && in[position] == QLatin1Char('-');
+
+  quint64 data1, data2, data3, clockSeq, node;
+
+  if (!braced ||
+      !readHex(in + 1, 4, data1) ||
+      !readHex(in + 10, 2, data2) ||
+      !readHex(in + 15, 2, data3) ||
+      !readHex(in + 20, 2, clockSeq) ||
+      !readHex(in + 25, 6, node))
+    return QUuid(text);
+
+  return QUuid(uint(data1),
+               ushort(data2),
+               ushort(data3),
+               uchar(clockSeq >> 8),
+               uchar(clockSeq),
+               uchar(node >> 40),
+               uchar(node >> 32),
+               uchar(node >> 24),
+               uchar(node >> 16),
+               uchar(node >> 8),
+               uchar(node));
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <QtCore/QUuid>
+
+namespace QtNodes
+{
+
+/// Cheaper creation, formatting and parsing of the ids of nodes and
+/// connections, compatible with QUuid.
+class FastUuid
+{
+public:
+
+  /// A random version 4 uuid from a per thread xoshiro256** generator,
+  /// seeded once from QUuid::createUuid(). Two ids are as unlikely to
+  /// collide as two random uuids. Unlike those of QUuid::createUuid(),
+  /// the ids are predictable and not fit for cryptographic use.
+  static
+  QUuid
+  create();
+
+  /// Same as QUuid::toString(): "{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}".
+  static
+  QString
+  toString(QUuid const &id);
+
+  /// Parses the output of toString() directly, other forms through QUuid.
+  static
+  QUuid
+  fromString(QString const &text);
+
+private:
+
+  FastUuid() = delete;
+};
+}
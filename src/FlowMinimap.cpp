@@ -0,0 +1,505 @@
+#include "FlowMinimap.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QtGui/QMouseEvent>
+#include <QtGui/QPainter>
+
+#include "Connection.hpp"
+#include "FlowScene.hpp"
+#include "FlowView.hpp"
+#include "Node.hpp"
+#include "StyleCollection.hpp"
+
+using QtNodes::Connection;
+using QtNodes::FlowMinimap;
+using QtNodes::FlowScene;
+using QtNodes::FlowView;
+using QtNodes::Node;
+using QtNodes::PortType;
+
+namespace
+{
+// widget pixels per grid cell
+constexpr int CellPixels = 2;
+
+// fraction of the scene size kept around the nodes, so that
+// moving a node slightly out of the scene does not rebuild the grid
+constexpr double GrowthMargin = 0.25;
+
+constexpr double MinimalMargin = 100.0;
+}
+
+
+FlowMinimap::
+FlowMinimap(FlowScene *scene, QWidget *parent)
+  : QWidget(parent)
+  , _scene(scene)
+  , _cellExtent(1.0)
+  , _rebuildNeeded(true)
+  , _connectionsChanged(true)
+{
+  setMouseTracking(false);
+  setAttribute(Qt::WA_OpaquePaintEvent);
+
+  for (auto const & pair : _scene->nodes())
+    addNode(*pair.second);
+
+  for (auto const & pair : _scene->connections())
+  {
+    if (pair.second->complete())
+      addConnection(*pair.second);
+  }
+
+  connect(_scene, &FlowScene::nodeCreated, this, &FlowMinimap::addNode);
+  connect(_scene, &FlowScene::nodeMoved, this, &FlowMinimap::moveNode);
+  connect(_scene, &FlowScene::nodeDeleted, this, &FlowMinimap::removeNode);
+
+  connect(_scene, &FlowScene::nodeResized,
+          this, [this](Node &node) { moveNode(node, _scene->getNodePosition(node)); });
+
+  connect(_scene, &FlowScene::connectionCreated, this, &FlowMinimap::addConnection);
+  connect(_scene, &FlowScene::connectionDeleted, this, &FlowMinimap::removeConnection);
+
+  // restored and dropped nodes get their position after nodeCreated
+  connect(_scene, &FlowScene::nodePlaced,
+          this, [this](Node &node) { moveNode(node, _scene->getNodePosition(node)); });
+}
+
+
+FlowMinimap::
+~FlowMinimap() = default;
+
+
+void
+FlowMinimap::
+setView(FlowView *view)
+{
+  if (_view)
+    disconnect(_view, nullptr, this, nullptr);
+
+  _view = view;
+
+  if (_view)
+  {
+    _viewRect = _view->visibleSceneRect();
+
+    connect(_view, &FlowView::visibleSceneRectChanged,
+            this, [this](QRectF const &rect)
+    {
+      _viewRect = rect;
+      update();
+    });
+  }
+
+  update();
+}
+
+
+QSize
+FlowMinimap::
+sizeHint() const
+{
+  return QSize(200, 150);
+}
+
+
+void
+FlowMinimap::
+paintEvent(QPaintEvent *)
+{
+  if (_rebuildNeeded)
+    rebuild();
+
+  QPainter painter(this);
+
+  if (_connectionsChanged || _connectionImage.size() != size())
+    drawConnections();
+  else if (!_connectionsDirty.isEmpty())
+    drawConnections(_connectionsDirty);
+
+  _connectionsDirty = QRect();
+
+  painter.fillRect(rect(), StyleCollection::flowViewStyle().BackgroundColor);
+
+  painter.drawImage(QPoint(0, 0), _connectionImage);
+
+  painter.drawImage(QRect(QPoint(0, 0), _image.size() * CellPixels), _image);
+
+  if (_view && !_viewRect.isEmpty())
+  {
+    painter.setPen(palette().highlight().color());
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(mapFromScene(_viewRect));
+  }
+}
+
+
+void
+FlowMinimap::
+resizeEvent(QResizeEvent *event)
+{
+  QWidget::resizeEvent(event);
+
+  _rebuildNeeded = true;
+}
+
+
+void
+FlowMinimap::
+mousePressEvent(QMouseEvent *event)
+{
+  if (event->button() == Qt::LeftButton)
+    centerView(event->pos());
+}
+
+
+void
+FlowMinimap::
+mouseMoveEvent(QMouseEvent *event)
+{
+  if (event->buttons() & Qt::LeftButton)
+    centerView(event->pos());
+}
+
+
+void
+FlowMinimap::
+addNode(Node &node)
+{
+  moveNode(node, _scene->getNodePosition(node));
+}
+
+
+void
+FlowMinimap::
+moveNode(Node &node, QPointF const &newLocation)
+{
+  QRectF const rect(newLocation, _scene->getNodeSize(node));
+
+  auto it = _nodeRects.find(node.id());
+
+  if (it != _nodeRects.end())
+  {
+    if (it->second == rect)
+      return;
+
+    // cleared where the lines were
+    touchConnections(node.id());
+
+    changeCells(it->second, -1);
+    it->second = rect;
+  }
+  else
+  {
+    _nodeRects.emplace(node.id(), rect);
+  }
+
+  touchConnections(node.id());
+
+  QRectF const gridArea(_origin, QSizeF(_image.size()) * _cellExtent);
+
+  if (!gridArea.contains(rect))
+  {
+    _rebuildNeeded = true;
+    update();
+    return;
+  }
+
+  changeCells(rect, +1);
+}
+
+
+void
+FlowMinimap::
+removeNode(Node &node)
+{
+  auto it = _nodeRects.find(node.id());
+
+  if (it == _nodeRects.end())
+    return;
+
+  changeCells(it->second, -1);
+
+  _nodeRects.erase(it);
+  _nodeConnections.erase(node.id());
+}
+
+
+void
+FlowMinimap::
+addConnection(Connection const &connection)
+{
+  auto const nodes = std::make_pair(connection.getNode(PortType::Out)->id(),
+                                    connection.getNode(PortType::In)->id());
+
+  _connections[connection.id()] = nodes;
+
+  _nodeConnections[nodes.first].insert(connection.id());
+  _nodeConnections[nodes.second].insert(connection.id());
+
+  QRect const area = connectionArea(nodes);
+
+  _connectionsDirty |= area;
+  update(area);
+}
+
+
+void
+FlowMinimap::
+removeConnection(Connection const &connection)
+{
+  auto it = _connections.find(connection.id());
+
+  if (it == _connections.end())
+    return;
+
+  for (QUuid const & nodeId : { it->second.first, it->second.second })
+  {
+    auto nodeIt = _nodeConnections.find(nodeId);
+
+    if (nodeIt != _nodeConnections.end())
+      nodeIt->second.erase(connection.id());
+  }
+
+  QRect const area = connectionArea(it->second);
+
+  _connections.erase(it);
+
+  _connectionsDirty |= area;
+  update(area);
+}
+
+
+void
+FlowMinimap::
+drawConnections()
+{
+  _connectionsChanged = false;
+
+  _connectionImage = QImage(size(), QImage::Format_ARGB32_Premultiplied);
+  _connectionImage.fill(Qt::transparent);
+
+  if (_connections.empty())
+    return;
+
+  drawConnections(_connectionImage.rect());
+}
+
+
+void
+FlowMinimap::
+drawConnections(QRect const &area)
+{
+  QPainter painter(&_connectionImage);
+
+  painter.setClipRect(area);
+
+  painter.setCompositionMode(QPainter::CompositionMode_Source);
+  painter.fillRect(area, Qt::transparent);
+  painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+  QPainterPath lines;
+
+  for (auto const & pair : _connections)
+  {
+    if (!connectionArea(pair.second).intersects(area))
+      continue;
+
+    QLineF const line = connectionLine(pair.second);
+
+    lines.moveTo(line.p1());
+    lines.lineTo(line.p2());
+  }
+
+  painter.setPen(StyleCollection::connectionStyle().normalColor());
+  painter.drawPath(lines);
+}
+
+
+QLineF
+FlowMinimap::
+connectionLine(std::pair<QUuid, QUuid> const &nodes) const
+{
+  auto out = _nodeRects.find(nodes.first);
+  auto in  = _nodeRects.find(nodes.second);
+
+  if (out == _nodeRects.end() || in == _nodeRects.end())
+    return QLineF();
+
+  // from the output side of one node to the input side of the other
+  QRectF const from = mapFromScene(out->second);
+  QRectF const to   = mapFromScene(in->second);
+
+  return QLineF(from.right(), from.center().y(), to.left(), to.center().y());
+}
+
+
+QRect
+FlowMinimap::
+connectionArea(std::pair<QUuid, QUuid> const &nodes) const
+{
+  QLineF const line = connectionLine(nodes);
+
+  if (line.isNull())
+    return QRect();
+
+  // the pen and the antialiasing reach a pixel beyond the line
+  return QRectF(line.p1(), line.p2()).normalized()
+         .toAlignedRect().adjusted(-2, -2, 2, 2);
+}
+
+
+void
+FlowMinimap::
+touchConnections(QUuid const &nodeId)
+{
+  auto it = _nodeConnections.find(nodeId);
+
+  if (it == _nodeConnections.end())
+    return;
+
+  QRect area;
+
+  for (QUuid const & connectionId : it->second)
+    area |= connectionArea(_connections.at(connectionId));
+
+  if (area.isEmpty())
+    return;
+
+  _connectionsDirty |= area;
+  update(area);
+}
+
+
+void
+FlowMinimap::
+rebuild()
+{
+  _rebuildNeeded = false;
+
+  // the mapping changes with the grid
+  _connectionsChanged = true;
+
+  QSize const gridSize(std::max(1, (width() + CellPixels - 1) / CellPixels),
+                       std::max(1, (height() + CellPixels - 1) / CellPixels));
+
+  _image = QImage(gridSize, QImage::Format_ARGB32_Premultiplied);
+  _cellCounts.assign(gridSize.width() * gridSize.height(), 0);
+
+  QRectF bounds;
+
+  for (auto const & pair : _nodeRects)
+    bounds = bounds.united(pair.second);
+
+  double const marginX = std::max(MinimalMargin, bounds.width() * GrowthMargin);
+  double const marginY = std::max(MinimalMargin, bounds.height() * GrowthMargin);
+
+  bounds.adjust(-marginX, -marginY, marginX, marginY);
+
+  _cellExtent = std::max(bounds.width() / gridSize.width(),
+                         bounds.height() / gridSize.height());
+
+  // the scene is centered in the grid
+  _origin = bounds.center() -
+            QPointF(gridSize.width(), gridSize.height()) * (_cellExtent / 2.0);
+
+  for (auto const & pair : _nodeRects)
+  {
+    QRect const cells = cellsOf(pair.second);
+
+    for (int y = cells.top(); y <= cells.bottom(); ++y)
+    {
+      for (int x = cells.left(); x <= cells.right(); ++x)
+        ++_cellCounts[y * gridSize.width() + x];
+    }
+  }
+
+  QRgb const nodeColor = StyleCollection::nodeStyle().NormalBoundaryColor.rgb();
+
+  for (int y = 0; y < gridSize.height(); ++y)
+  {
+    auto line = reinterpret_cast<QRgb*>(_image.scanLine(y));
+
+    for (int x = 0; x < gridSize.width(); ++x)
+      line[x] = (_cellCounts[y * gridSize.width() + x] > 0) ? nodeColor : 0;
+  }
+}
+
+
+void
+FlowMinimap::
+changeCells(QRectF const &sceneRect, int delta)
+{
+  // the whole grid is recomputed anyway
+  if (_rebuildNeeded)
+    return;
+
+  QRect const cells = cellsOf(sceneRect);
+
+  if (cells.isEmpty())
+    return;
+
+  QRgb const nodeColor = StyleCollection::nodeStyle().NormalBoundaryColor.rgb();
+
+  int const gridWidth = _image.width();
+
+  for (int y = cells.top(); y <= cells.bottom(); ++y)
+  {
+    auto line = reinterpret_cast<QRgb*>(_image.scanLine(y));
+
+    for (int x = cells.left(); x <= cells.right(); ++x)
+    {
+      int &count = _cellCounts[y * gridWidth + x];
+
+      count += delta;
+
+      line[x] = (count > 0) ? nodeColor : 0;
+    }
+  }
+
+  update(QRect(cells.topLeft() * CellPixels, cells.size() * CellPixels));
+}
+
+
+QRect
+FlowMinimap::
+cellsOf(QRectF const &sceneRect) const
+{
+  QPoint const topLeft(int(std::floor((sceneRect.left() - _origin.x()) / _cellExtent)),
+                       int(std::floor((sceneRect.top() - _origin.y()) / _cellExtent)));
+
+  QPoint const bottomRight(int(std::floor((sceneRect.right() - _origin.x()) / _cellExtent)),
+                           int(std::floor((sceneRect.bottom() - _origin.y()) / _cellExtent)));
+
+  return QRect(topLeft, bottomRight).intersected(_image.rect());
+}
+
+
+QPointF
+FlowMinimap::
+mapToScene(QPoint const &widgetPos) const
+{
+  return _origin + QPointF(widgetPos) * (_cellExtent / CellPixels);
+}
+
+
+QRectF
+FlowMinimap::
+mapFromScene(QRectF const &sceneRect) const
+{
+  double const factor = CellPixels / _cellExtent;
+
+  return QRectF((sceneRect.topLeft() - _origin) * factor,
+                sceneRect.size() * factor);
+}
+
+
+void
+FlowMinimap::
+centerView(QPoint const &widgetPos)
+{
+  if (_view)
+    _view->centerOnScenePoint(mapToScene(widgetPos));
+}
@@ -1,14 +1,21 @@
 #include "FlowScene.hpp"
 
+#include <algorithm>
+#include <exception>
 #include <stdexcept>
 #include <utility>
 
 #include <QtWidgets/QGraphicsSceneMoveEvent>
+#include <QtWidgets/QGraphicsSceneMouseEvent>
 #include <QtWidgets/QFileDialog>
 #include <QtCore/QByteArray>
 #include <QtCore/QBuffer>
 #include <QtCore/QDataStream>
 #include <QtCore/QFile>
+#include <QtCore/QTimer>
+#include <QtCore/QSignalBlocker>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
 
 #include <QtCore/QJsonDocument>
 #include <QtCore/QJsonObject>
@@ -21,8 +28,19 @@
 
 #include "NodeGraphicsObject.hpp"
 #include "ConnectionGraphicsObject.hpp"
+#include "ConnectionLayer.hpp"
+#include "ConnectionPainter.hpp"
+#include "FastUuid.hpp"
+#include "FunctionTask.hpp"
+#include "NodeSpatialIndex.hpp"
+#include "SceneBinaryFormat.hpp"
+#include "SceneCompression.hpp"
+#include "SceneGrid.hpp"
+#include "SceneHistory.hpp"
+#include "SceneJsonStream.hpp"
 
 #include "Connection.hpp"
+#include "ConnectionGeometry.hpp"
 
 #include "FlowView.hpp"
 #include "DataModelRegistry.hpp"
@@ -31,18 +49,85 @@ using QtNodes::FlowScene;
 using QtNodes::Node;
 using QtNodes::NodeGraphicsObject;
 using QtNodes::Connection;
+using QtNodes::ConnectionGraphicsObject;
+using QtNodes::ConnectionGeometry;
+using QtNodes::ConnectionLayer;
+using QtNodes::ConnectionPainter;
+using QtNodes::FastUuid;
+using QtNodes::FunctionTask;
+using QtNodes::NodeSpatialIndex;
+using QtNodes::SceneGrid;
+using QtNodes::SceneHistory;
+using QtNodes::BinarySceneWriter;
+using QtNodes::BinarySceneReader;
+using QtNodes::JsonSceneStreamWriter;
+using QtNodes::JsonSceneStreamReader;
+using QtNodes::NodeDataType;
+using QtNodes::SceneFormat;
+using QtNodes::SceneCompression;
+using QtNodes::ChunkedCompression;
+using QtNodes::ChunkedCompressionWriter;
+using QtNodes::ChunkedCompressionReader;
 using QtNodes::DataModelRegistry;
 using QtNodes::NodeDataModel;
+using QtNodes::NodeState;
+using QtNodes::NodeGeometry;
 using QtNodes::PortType;
 using QtNodes::PortIndex;
 using QtNodes::TypeConverter;
 
+namespace
+{
+
+// items between two progress reports of the streaming save and load
+int const ProgressInterval = 1024;
+
+// nodes kept aside by the streaming loads before restoring them
+std::size_t const RestoreBatchSize = 1024;
+
+// below this, handing the models to worker threads costs more than it saves
+std::size_t const MinConcurrentRestores = 16;
+
+
+/// The scene geometry of a complete connection, computed from its nodes
+/// since a lazy connection may have no up to date geometry.
+ConnectionGeometry
+connectionSceneGeometry(Connection const& connection)
+{
+  ConnectionGeometry geom;
+
+  for (PortType portType: {PortType::In, PortType::Out})
+  {
+    Node const* node = connection.getNode(portType);
+
+    QPointF const nodePos = node->position();
+
+    geom.setEndPoint(portType,
+                     node->nodeGeometry().portScenePosition(connection.getPortIndex(portType),
+                                                            portType,
+                                                            QTransform::fromTranslate(nodePos.x(),
+                                                                                      nodePos.y())));
+  }
+
+  return geom;
+}
+
+
+QRectF
+connectionSceneRect(Connection const& connection)
+{
+  return connectionSceneGeometry(connection).boundingRect();
+}
+}
+
 
 FlowScene::
 FlowScene(std::shared_ptr<DataModelRegistry> registry,
           QObject * parent)
   : QGraphicsScene(parent)
   , _registry(std::move(registry))
+  , _spatialIndex(detail::make_unique<NodeSpatialIndex>())
+  , _connectionIndex(detail::make_unique<SceneGrid<Connection*>>())
 {
   setItemIndexMethod(QGraphicsScene::NoIndex);
 
@@ -50,6 +135,8 @@ FlowScene(std::shared_ptr<DataModelRegistry> registry,
   connect(this, &FlowScene::connectionCreated, this, &FlowScene::setupConnectionSignals);
   connect(this, &FlowScene::connectionCreated, this, &FlowScene::sendConnectionCreatedToNodes);
   connect(this, &FlowScene::connectionDeleted, this, &FlowScene::sendConnectionDeletedToNodes);
+
+  _history = detail::make_unique<SceneHistory>(*this);
 }
 
 FlowScene::
@@ -62,6 +149,9 @@ FlowScene(QObject * parent)
 FlowScene::
 ~FlowScene()
 {
+  // the removals below are not changes to record
+  _history.reset();
+
   clearScene();
 }
 
@@ -76,10 +166,11 @@ createConnection(PortType connectedPort,
 {
   auto connection = std::make_shared<Connection>(connectedPort, node, portIndex);
 
-  auto cgo = detail::make_unique<ConnectionGraphicsObject>(*this, *connection);
+  setGraphicsObjectFactory(*connection);
 
+  // a connection being dragged is always visible;
   // after this function connection points are set to node port
-  connection->setGraphicsObject(std::move(cgo));
+  connection->getConnectionGraphicsObject();
 
   _connections[connection->id()] = connection;
 
@@ -90,6 +181,12 @@ createConnection(PortType connectedPort,
           &Connection::connectionCompleted,
           this,
           [this](Connection const& c) {
+            // filed in the connection index with the node
+            _spatialIndexPending.insert(c.getNode(PortType::In)->id());
+
+            for (PortType portType: {PortType::In, PortType::Out})
+              updatePortRows(*c.getNode(portType), portType, c.getPortIndex(portType));
+
             connectionCreated(c);
           });
 
@@ -112,19 +209,33 @@ createConnection(Node& nodeIn,
                                  portIndexOut,
                                  converter);
 
-  auto cgo = detail::make_unique<ConnectionGraphicsObject>(*this, *connection);
+  setGraphicsObjectFactory(*connection);
 
   nodeIn.nodeState().setConnection(PortType::In, portIndexIn, *connection);
   nodeOut.nodeState().setConnection(PortType::Out, portIndexOut, *connection);
 
+  updatePortRows(nodeIn, PortType::In, portIndexIn);
+  updatePortRows(nodeOut, PortType::Out, portIndexOut);
+
   // after this function connection points are set to node port
-  connection->setGraphicsObject(std::move(cgo));
+  if (!_lazyGraphicsObjects ||
+      nodeIn.hasGraphicsObject() ||
+      nodeOut.hasGraphicsObject())
+  {
+    connection->getConnectionGraphicsObject();
+  }
 
   // trigger data propagation
-  nodeOut.onDataUpdated(portIndexOut);
+  if (_dataPropagationDeferred)
+    _deferredPropagationTargets.insert(nodeIn.id());
+  else
+    nodeOut.onDataUpdated(portIndexOut);
 
   _connections[connection->id()] = connection;
 
+  // filed in the connection index with the node
+  _spatialIndexPending.insert(nodeIn.id());
+
   connectionCreated(*connection);
 
   return connection;
@@ -135,43 +246,58 @@ std::shared_ptr<Connection>
 FlowScene::
 restoreConnection(QJsonObject const &connectionJson)
 {
-  QUuid nodeInId  = QUuid(connectionJson["in_id"].toString());
-  QUuid nodeOutId = QUuid(connectionJson["out_id"].toString());
+  QUuid nodeInId  = FastUuid::fromString(connectionJson["in_id"].toString());
+  QUuid nodeOutId = FastUuid::fromString(connectionJson["out_id"].toString());
 
   PortIndex portIndexIn  = connectionJson["in_index"].toInt();
   PortIndex portIndexOut = connectionJson["out_index"].toInt();
 
-  auto nodeIn  = _nodes[nodeInId].get();
-  auto nodeOut = _nodes[nodeOutId].get();
+  NodeDataType converterIn;
+  NodeDataType converterOut;
 
-  auto getConverter = [&]()
+  QJsonValue converterVal = connectionJson["converter"];
+
+  if (!converterVal.isUndefined())
   {
-    QJsonValue converterVal = connectionJson["converter"];
+    QJsonObject converterJson = converterVal.toObject();
 
-    if (!converterVal.isUndefined())
-    {
-      QJsonObject converterJson = converterVal.toObject();
+    converterIn  = { converterJson["in"].toObject()["id"].toString(),
+                     converterJson["in"].toObject()["name"].toString() };
+
+    converterOut = { converterJson["out"].toObject()["id"].toString(),
+                     converterJson["out"].toObject()["name"].toString() };
+  }
+
+  return restoreConnection(nodeInId, portIndexIn,
+                           nodeOutId, portIndexOut,
+                           converterIn, converterOut);
+}
 
-      NodeDataType inType { converterJson["in"].toObject()["id"].toString(),
-                            converterJson["in"].toObject()["name"].toString() };
 
-      NodeDataType outType { converterJson["out"].toObject()["id"].toString(),
-                             converterJson["out"].toObject()["name"].toString() };
+std::shared_ptr<Connection>
+FlowScene::
+restoreConnection(QUuid const& nodeInId,
+                  PortIndex portIndexIn,
+                  QUuid const& nodeOutId,
+                  PortIndex portIndexOut,
+                  NodeDataType const& converterIn,
+                  NodeDataType const& converterOut)
+{
+  auto nodeIn  = _nodes.find(nodeInId);
+  auto nodeOut = _nodes.find(nodeOutId);
 
-      auto converter  =
-        registry().getTypeConverter(outType, inType);
+  if (nodeIn == _nodes.end() || nodeOut == _nodes.end())
+    throw std::logic_error("Connection refers to a missing node");
 
-      if (converter)
-        return converter;
-    }
+  TypeConverter converter;
 
-    return TypeConverter{};
-  };
+  if (!converterIn.id.isEmpty() || !converterOut.id.isEmpty())
+    converter = registry().getTypeConverter(converterOut, converterIn);
 
   std::shared_ptr<Connection> connection =
-    createConnection(*nodeIn, portIndexIn,
-                     *nodeOut, portIndexOut,
-                     getConverter());
+    createConnection(*nodeIn->second, portIndexIn,
+                     *nodeOut->second, portIndexOut,
+                     converter);
 
   // Note: the connectionCreated(...) signal has already been sent
   // by createConnection(...)
@@ -187,24 +313,66 @@ deleteConnection(Connection& connection)
   auto it = _connections.find(connection.id());
   if (it != _connections.end())
   {
+    _selectedConnections.erase(&connection);
+
+    _connectionIndex->remove(&connection);
+
     connection.removeFromNodes();
+
+    for (PortType portType: {PortType::In, PortType::Out})
+    {
+      if (Node* node = connection.getNode(portType))
+        updatePortRows(*node, portType, connection.getPortIndex(portType));
+    }
+
     _connections.erase(it);
   }
 }
 
 
+Connection*
+FlowScene::
+findConnection(QUuid const& nodeInId,
+               PortIndex portIndexIn,
+               QUuid const& nodeOutId,
+               PortIndex portIndexOut) const
+{
+  auto it = _nodes.find(nodeInId);
+
+  if (it == _nodes.end())
+    return nullptr;
+
+  for (auto const & pair : it->second->nodeState().connections(PortType::In, portIndexIn))
+  {
+    Connection* connection = pair.second;
+
+    Node* nodeOut = connection->getNode(PortType::Out);
+
+    if (nodeOut && nodeOut->id() == nodeOutId &&
+        connection->getPortIndex(PortType::Out) == portIndexOut)
+      return connection;
+  }
+
+  return nullptr;
+}
+
+
 Node&
 FlowScene::
 createNode(std::unique_ptr<NodeDataModel> && dataModel)
 {
   auto node = detail::make_unique<Node>(std::move(dataModel));
-  auto ngo  = detail::make_unique<NodeGraphicsObject>(*this, *node);
 
-  node->setGraphicsObject(std::move(ngo));
+  setGraphicsObjectFactory(*node);
+
+  if (!_lazyGraphicsObjects)
+    node->nodeGraphicsObject();
 
   auto nodePtr = node.get();
   _nodes[node->id()] = std::move(node);
 
+  registerNode(*nodePtr);
+
   nodeCreated(*nodePtr);
   return *nodePtr;
 }
@@ -214,23 +382,223 @@ Node&
 FlowScene::
 restoreNode(QJsonObject const& nodeJson)
 {
-  QString modelName = nodeJson["model"].toObject()["name"].toString();
+  QJsonObject const modelJson = nodeJson["model"].toObject();
+
+  QJsonObject const positionJson = nodeJson["position"].toObject();
 
+  return restoreNode(FastUuid::fromString(nodeJson["id"].toString()),
+                     modelJson["name"].toString(),
+                     QPointF(positionJson["x"].toDouble(),
+                             positionJson["y"].toDouble()),
+                     modelJson);
+}
+
+
+Node&
+FlowScene::
+restoreNode(QUuid const& id,
+            QString const& modelName,
+            QPointF const& position,
+            QJsonObject const& modelJson)
+{
   auto dataModel = registry().create(modelName);
 
   if (!dataModel)
     throw std::logic_error(std::string("No registered model with name ") +
                            modelName.toLocal8Bit().data());
 
+  return placeRestoredNode(std::move(dataModel), id, position, &modelJson);
+}
+
+
+std::vector<Node*>
+FlowScene::
+restoreNodes(QJsonArray const& nodesJson)
+{
+  std::vector<PendingNode> batch;
+  batch.reserve(nodesJson.size());
+
+  for (QJsonValue const& value : nodesJson)
+  {
+    QJsonObject const nodeJson = value.toObject();
+
+    QJsonObject const positionJson = nodeJson["position"].toObject();
+
+    PendingNode pending;
+    pending.id        = FastUuid::fromString(nodeJson["id"].toString());
+    pending.modelJson = nodeJson["model"].toObject();
+    pending.modelName = pending.modelJson["name"].toString();
+    pending.position  = QPointF(positionJson["x"].toDouble(),
+                                positionJson["y"].toDouble());
+
+    batch.push_back(std::move(pending));
+  }
+
+  return restoreNodeBatch(batch);
+}
+
+
+std::vector<Node*>
+FlowScene::
+restoreNodeBatch(std::vector<PendingNode>& batch)
+{
+  DataModelRegistry& modelRegistry = registry();
+
+  std::vector<PendingNode*> concurrent;
+
+  for (PendingNode& pending : batch)
+    if (modelRegistry.concurrentRestore(pending.modelName))
+      concurrent.push_back(&pending);
+
+  int const threads = QThread::idealThreadCount();
+
+  if (concurrent.size() >= MinConcurrentRestores && threads > 1)
+  {
+    QThread* const sceneThread = thread();
+
+    // a few tasks per thread even out models of uneven cost
+    std::size_t const taskCount =
+      std::min<std::size_t>(std::size_t(threads) * 4, concurrent.size());
+
+    std::vector<std::exception_ptr> errors(taskCount);
+
+    if (!_restorePool)
+      _restorePool = detail::make_unique<QThreadPool>();
+
+    QThreadPool& pool = *_restorePool;
+
+    for (std::size_t task = 0; task < taskCount; ++task)
+    {
+      pool.start(new FunctionTask([&, task]()
+      {
+        try
+        {
+          for (std::size_t i = task; i < concurrent.size(); i += taskCount)
+          {
+            PendingNode& pending = *concurrent[i];
+
+            auto dataModel = modelRegistry.create(pending.modelName);
+
+            dataModel->restore(pending.modelJson);
+
+            // only the thread owning an object can hand it over
+            dataModel->moveToThread(sceneThread);
+
+            pending.model = std::move(dataModel);
+          }
+        }
+        catch (...)
+        {
+          errors[task] = std::current_exception();
+        }
+      }));
+    }
+
+    pool.waitForDone();
+
+    for (auto const & error : errors)
+      if (error)
+        std::rethrow_exception(error);
+  }
+
+  std::vector<Node*> nodes;
+  nodes.reserve(batch.size());
+
+  for (PendingNode& pending : batch)
+  {
+    if (pending.model)
+    {
+      nodes.push_back(&placeRestoredNode(std::move(pending.model),
+                                         pending.id,
+                                         pending.position,
+                                         nullptr));
+    }
+    else
+    {
+      nodes.push_back(&restoreNode(pending.id,
+                                   pending.modelName,
+                                   pending.position,
+                                   pending.modelJson));
+    }
+  }
+
+  return nodes;
+}
+
+
+std::vector<Node*>
+FlowScene::
+placeCopies(std::vector<PendingNode>& nodes,
+            std::vector<PendingConnection> const& connections,
+            QString const& text)
+{
+  auto const & creators = registry().registeredModelCreators();
+
+  // a model missing halfway through would leave part of the copies placed
+  for (PendingNode const& pending : nodes)
+  {
+    if (creators.count(pending.modelName) == 0)
+      throw std::logic_error(std::string("No registered model with name ") +
+                             pending.modelName.toLocal8Bit().data());
+  }
+
+  std::vector<Node*> placed;
+
+  _history->beginMacro(text);
+
+  try
+  {
+    deferPropagationDuring([&]()
+    {
+      placed = restoreNodeBatch(nodes);
+
+      for (PendingConnection const& c : connections)
+      {
+        restoreConnection(c.inId, c.inIndex,
+                          c.outId, c.outIndex,
+                          c.converterIn, c.converterOut);
+      }
+    });
+  }
+  catch (...)
+  {
+    // what was placed stays undoable
+    _history->endMacro();
+    throw;
+  }
+
+  _history->endMacro();
+
+  selectNodes(placed);
+
+  return placed;
+}
+
+
+Node&
+FlowScene::
+placeRestoredNode(std::unique_ptr<NodeDataModel>&& dataModel,
+                  QUuid const& id,
+                  QPointF const& position,
+                  QJsonObject const* modelJson)
+{
   auto node = detail::make_unique<Node>(std::move(dataModel));
-  auto ngo  = detail::make_unique<NodeGraphicsObject>(*this, *node);
-  node->setGraphicsObject(std::move(ngo));
 
-  node->restore(nodeJson);
+  setGraphicsObjectFactory(*node);
+
+  if (!_lazyGraphicsObjects)
+    node->nodeGraphicsObject();
+
+  if (modelJson)
+    node->restore(id, position, *modelJson);
+  else
+    node->restore(id, position);
 
   auto nodePtr = node.get();
   _nodes[node->id()] = std::move(node);
 
+  registerNode(*nodePtr);
+
   nodePlaced(*nodePtr);
   nodeCreated(*nodePtr);
   return *nodePtr;
@@ -256,10 +624,178 @@ removeNode(Node& node)
     }
   }
 
+  unregisterNode(node);
+
   _nodes.erase(node.id());
 }
 
 
+QByteArray
+FlowScene::
+copyNodes(std::vector<Node*> const& nodes) const
+{
+  QByteArray data;
+
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::WriteOnly);
+
+  BinarySceneWriter writer(buffer);
+
+  writer.writeHeader();
+
+  std::unordered_set<QUuid> copied;
+  copied.reserve(nodes.size());
+
+  for (Node* node : nodes)
+  {
+    writer.writeNode(*node);
+    copied.insert(node->id());
+  }
+
+  // every connection once, from its input end
+  for (Node* node : nodes)
+  {
+    for (auto const & connections : node->nodeState().getEntries(PortType::In))
+    {
+      for (auto const & pair : connections)
+      {
+        Node* nodeOut = pair.second->getNode(PortType::Out);
+
+        if (nodeOut && copied.count(nodeOut->id()))
+          writer.writeConnection(*pair.second);
+      }
+    }
+  }
+
+  writer.writeEnd();
+
+  return data;
+}
+
+
+std::vector<Node*>
+FlowScene::
+pasteNodes(QByteArray const& data, QPointF const& offset)
+{
+  QBuffer buffer;
+  buffer.setData(data);
+  buffer.open(QIODevice::ReadOnly);
+
+  BinarySceneReader reader(buffer);
+
+  std::unordered_map<QUuid, QUuid> copies;
+
+  std::vector<PendingNode>       nodes;
+  std::vector<PendingConnection> connections;
+
+  for (;;)
+  {
+    switch (reader.next())
+    {
+      case BinarySceneReader::Record::Node:
+      {
+        auto const & r = reader.node();
+
+        PendingNode pending;
+        pending.id        = FastUuid::create();
+        pending.modelName = r.modelName;
+        pending.position  = r.position + offset;
+        pending.modelJson = r.model;
+
+        copies[r.id] = pending.id;
+
+        nodes.push_back(std::move(pending));
+        break;
+      }
+
+      case BinarySceneReader::Record::Connection:
+      {
+        auto const & r = reader.connection();
+
+        auto in  = copies.find(r.inId);
+        auto out = copies.find(r.outId);
+
+        // a connection to a node that wasn't copied
+        if (in == copies.end() || out == copies.end())
+          break;
+
+        connections.push_back({ in->second, r.inIndex,
+                                out->second, r.outIndex,
+                                r.converterIn, r.converterOut });
+        break;
+      }
+
+      case BinarySceneReader::Record::End:
+        return placeCopies(nodes, connections, tr("Paste"));
+    }
+  }
+}
+
+
+std::vector<Node*>
+FlowScene::
+duplicateNodes(std::vector<Node*> const& nodes, QPointF const& offset)
+{
+  std::unordered_map<QUuid, QUuid> copies;
+  copies.reserve(nodes.size());
+
+  std::vector<PendingNode> pendingNodes;
+  pendingNodes.reserve(nodes.size());
+
+  for (Node* node : nodes)
+  {
+    PendingNode pending;
+    pending.id        = FastUuid::create();
+    pending.modelName = node->nodeDataModel()->name();
+    pending.position  = node->position() + offset;
+    pending.modelJson = node->nodeDataModel()->save();
+
+    copies[node->id()] = pending.id;
+
+    pendingNodes.push_back(std::move(pending));
+  }
+
+  std::vector<PendingConnection> connections;
+
+  for (Node* node : nodes)
+  {
+    for (auto const & entries : node->nodeState().getEntries(PortType::In))
+    {
+      for (auto const & pair : entries)
+      {
+        Connection const& connection = *pair.second;
+
+        Node const* nodeOut = connection.getNode(PortType::Out);
+
+        if (!nodeOut)
+          continue;
+
+        auto out = copies.find(nodeOut->id());
+
+        if (out == copies.end())
+          continue;
+
+        PendingConnection pending;
+        pending.inId     = copies[node->id()];
+        pending.inIndex  = connection.getPortIndex(PortType::In);
+        pending.outId    = out->second;
+        pending.outIndex = connection.getPortIndex(PortType::Out);
+
+        if (connection.hasTypeConverter())
+        {
+          pending.converterIn  = connection.dataType(PortType::In);
+          pending.converterOut = connection.dataType(PortType::Out);
+        }
+
+        connections.push_back(std::move(pending));
+      }
+    }
+  }
+
+  return placeCopies(pendingNodes, connections, tr("Duplicate"));
+}
+
+
 DataModelRegistry&
 FlowScene::
 registry() const
@@ -377,7 +913,7 @@ QPointF
 FlowScene::
 getNodePosition(const Node& node) const
 {
-  return node.nodeGraphicsObject().pos();
+  return node.position();
 }
 
 
@@ -385,8 +921,28 @@ void
 FlowScene::
 setNodePosition(Node& node, const QPointF& pos) const
 {
-  node.nodeGraphicsObject().setPos(pos);
-  node.nodeGraphicsObject().moveConnections();
+  node.setPosition(pos);
+
+  _spatialIndexPending.insert(node.id());
+
+  if (node.hasGraphicsObject())
+  {
+    node.nodeGraphicsObject().moveConnections();
+    return;
+  }
+
+  // connections drawn towards a node that is not drawn itself
+  for (PortType portType: {PortType::In, PortType::Out})
+  {
+    for (auto const & connections : node.nodeState().getEntries(portType))
+    {
+      for (auto const & pair : connections)
+      {
+        if (pair.second->hasGraphicsObject())
+          pair.second->getConnectionGraphicsObject().move();
+      }
+    }
+  }
 }
 
 
@@ -398,186 +954,1263 @@ getNodeSize(const Node& node) const
 }
 
 
-std::unordered_map<QUuid, std::unique_ptr<Node> > const &
+void
 FlowScene::
-nodes() const
+scheduleConnectionsUpdate(Node const& node)
 {
-  return _nodes;
-}
+  NodeState const & nodeState = node.nodeState();
 
+  // moves and resizes both end up here
+  _spatialIndexPending.insert(node.id());
+  _pendingGeometryNodes.insert(node.id());
 
-std::unordered_map<QUuid, std::shared_ptr<Connection> > const &
-FlowScene::
-connections() const
-{
+  for (PortType portType: {PortType::In, PortType::Out})
+  {
+    for (auto const & connections : nodeState.getEntries(portType))
+    {
+      for (auto const & pair : connections)
+        _pendingConnectionUpdates.insert(pair.first);
+    }
+  }
+
+  if (!_flushScheduled)
+  {
+    _flushScheduled = true;
+
+    QTimer::singleShot(0, this, [this] { flushPendingUpdates(); });
+  }
+}
+
+
+void
+FlowScene::
+scheduleNodeMoved(Node const& node)
+{
+  if (_pendingMovedNodesSet.insert(node.id()).second)
+    _pendingMovedNodes.push_back(node.id());
+
+  scheduleConnectionsUpdate(node);
+}
+
+
+void
+FlowScene::
+flushPendingUpdates()
+{
+  _flushScheduled = false;
+
+  // The handlers of the signals below may move nodes again
+  std::unordered_set<QUuid> connectionIds;
+  std::vector<QUuid>        movedNodeIds;
+  std::unordered_set<QUuid> movedNodeIdSet;
+  std::unordered_set<QUuid> geometryNodeIds;
+
+  connectionIds.swap(_pendingConnectionUpdates);
+  movedNodeIds.swap(_pendingMovedNodes);
+  movedNodeIdSet.swap(_pendingMovedNodesSet);
+  geometryNodeIds.swap(_pendingGeometryNodes);
+
+  // Nodes and connections removed in the meantime are skipped
+  for (QUuid const & id : connectionIds)
+  {
+    auto it = _connections.find(id);
+
+    if (it != _connections.end() && it->second->hasGraphicsObject())
+      it->second->getConnectionGraphicsObject().move();
+  }
+
+  std::vector<Node*> movedNodes;
+  movedNodes.reserve(movedNodeIds.size());
+
+  for (QUuid const & id : movedNodeIds)
+  {
+    auto it = _nodes.find(id);
+
+    if (it != _nodes.end())
+      movedNodes.push_back(it->second.get());
+  }
+
+  std::vector<Node*> resizedNodes;
+
+  for (QUuid const & id : geometryNodeIds)
+  {
+    auto it = _nodes.find(id);
+
+    if (it != _nodes.end() && movedNodeIdSet.count(id) == 0)
+      resizedNodes.push_back(it->second.get());
+  }
+
+  for (Node* node : resizedNodes)
+    nodeResized(*node);
+
+  if (movedNodes.empty())
+    return;
+
+  for (Node* node : movedNodes)
+    nodeMoved(*node, node->position());
+
+  nodesMoved(movedNodes);
+}
+
+
+void
+FlowScene::
+setDataPropagationDeferred(bool deferred)
+{
+  if (_dataPropagationDeferred == deferred)
+    return;
+
+  _dataPropagationDeferred = deferred;
+
+  if (!deferred)
+    propagateDeferredData();
+}
+
+
+bool
+FlowScene::
+dataPropagationDeferred() const
+{
+  return _dataPropagationDeferred;
+}
+
+
+SceneHistory&
+FlowScene::
+history() const
+{
+  return *_history;
+}
+
+
+void
+FlowScene::
+setConnectionBatching(bool enabled)
+{
+  if (enabled == connectionBatching())
+    return;
+
+  if (enabled)
+    _connectionLayer = detail::make_unique<ConnectionLayer>(*this);
+  else
+    _connectionLayer.reset();
+
+  for (auto const & pair : _connections)
+  {
+    if (pair.second->hasGraphicsObject())
+      pair.second->getConnectionGraphicsObject().updateBatching();
+  }
+}
+
+
+bool
+FlowScene::
+connectionBatching() const
+{
+  return _connectionLayer != nullptr;
+}
+
+
+ConnectionLayer*
+FlowScene::
+connectionLayer() const
+{
+  return _connectionLayer.get();
+}
+
+
+void
+FlowScene::
+setWidgetSnapshots(bool enabled)
+{
+  if (enabled == _widgetSnapshots)
+    return;
+
+  _widgetSnapshots = enabled;
+
+  for (auto const & pair : _nodes)
+  {
+    if (pair.second->hasGraphicsObject())
+      pair.second->nodeGraphicsObject().updateWidgetMode();
+  }
+}
+
+
+bool
+FlowScene::
+widgetSnapshots() const
+{
+  return _widgetSnapshots;
+}
+
+
+void
+FlowScene::
+setLazyGraphicsObjects(bool enabled)
+{
+  _lazyGraphicsObjects = enabled;
+
+  if (!enabled)
+  {
+    // the connections come along with their nodes
+    for (auto const & pair : _nodes)
+      pair.second->nodeGraphicsObject();
+
+    for (auto const & pair : _connections)
+      pair.second->getConnectionGraphicsObject();
+  }
+}
+
+
+bool
+FlowScene::
+lazyGraphicsObjects() const
+{
+  return _lazyGraphicsObjects;
+}
+
+
+void
+FlowScene::
+materializeGraphicsObjects(QRectF const& sceneRect)
+{
+  updateSpatialIndex();
+
+  for (Node* node : _spatialIndex->query(sceneRect))
+  {
+    if (!node->hasGraphicsObject())
+      node->nodeGraphicsObject();
+  }
+
+  // connections between two nodes out of the rect may still cross it
+  for (Connection* connection : _connectionIndex->query(sceneRect))
+  {
+    if (!connection->hasGraphicsObject())
+      connection->getConnectionGraphicsObject();
+  }
+}
+
+
+void
+FlowScene::
+releaseGraphicsObjects(QRectF const& keptSceneRect)
+{
+  QGraphicsItem const* focused = focusItem();
+
+  auto isKept =
+    [&](QGraphicsItem const& item)
+    {
+      return item.isSelected() ||
+             item.isUnderMouse() ||
+             &item == mouseGrabberItem() ||
+             (focused && (&item == focused || item.isAncestorOf(focused))) ||
+             item.mapRectToScene(item.boundingRect()).intersects(keptSceneRect);
+    };
+
+  std::vector<Node*>       nodes;
+  std::vector<Connection*> connections;
+
+  // the existing items, rather than every node and connection
+  for (QGraphicsItem* item : items(Qt::AscendingOrder))
+  {
+    if (auto ngo = qgraphicsitem_cast<NodeGraphicsObject*>(item))
+    {
+      if (!isKept(*ngo))
+        nodes.push_back(&ngo->node());
+    }
+    else if (auto cgo = qgraphicsitem_cast<ConnectionGraphicsObject*>(item))
+    {
+      if (cgo->connection().complete() && !isKept(*cgo))
+        connections.push_back(&cgo->connection());
+    }
+  }
+
+  for (Node* node : nodes)
+    node->releaseGraphicsObject();
+
+  for (Connection* connection : connections)
+  {
+    // the connections of a visible node stay visible
+    if (connection->getNode(PortType::In)->hasGraphicsObject() ||
+        connection->getNode(PortType::Out)->hasGraphicsObject())
+      continue;
+
+    connection->releaseGraphicsObject();
+  }
+
+  if (_connectionLayer)
+    _connectionLayer->update();
+}
+
+
+std::unordered_map<QUuid, std::unique_ptr<Node> > const &
+FlowScene::
+nodes() const
+{
+  return _nodes;
+}
+
+
+std::unordered_map<QUuid, std::shared_ptr<Connection> > const &
+FlowScene::
+connections() const
+{
   return _connections;
 }
 
 
-std::vector<Node*>
+std::vector<Node*>
+FlowScene::
+allNodes() const
+{
+  std::vector<Node*> nodes;
+
+  std::transform(_nodes.begin(),
+                 _nodes.end(),
+                 std::back_inserter(nodes),
+                 [](std::pair<QUuid const, std::unique_ptr<Node>> const & p) { return p.second.get(); });
+
+  return nodes;
+}
+
+
+std::vector<Node*>
+FlowScene::
+selectedNodes() const
+{
+  return std::vector<Node*>(_selectedNodes.begin(), _selectedNodes.end());
+}
+
+
+std::vector<Connection*>
+FlowScene::
+selectedConnections() const
+{
+  return std::vector<Connection*>(_selectedConnections.begin(),
+                                  _selectedConnections.end());
+}
+
+
+std::vector<Node*>
+FlowScene::
+nodesInRect(QRectF const& sceneRect, Qt::ItemSelectionMode mode) const
+{
+  updateSpatialIndex();
+
+  return _spatialIndex->query(sceneRect, mode);
+}
+
+
+std::vector<Connection*>
+FlowScene::
+connectionsInRect(QRectF const& sceneRect, Qt::ItemSelectionMode mode) const
+{
+  updateSpatialIndex();
+
+  std::vector<Connection*> connections;
+
+  // the grid only narrows the candidates down to their cells
+  for (Connection* c : _connectionIndex->query(sceneRect))
+  {
+    QPainterPath const stroke =
+      ConnectionPainter::getPainterStroke(connectionSceneGeometry(*c));
+
+    bool const inside =
+      (mode == Qt::ContainsItemShape || mode == Qt::ContainsItemBoundingRect)
+      ? sceneRect.contains(stroke.boundingRect())
+      : stroke.intersects(sceneRect);
+
+    if (inside)
+      connections.push_back(c);
+  }
+
+  return connections;
+}
+
+
+void
+FlowScene::
+selectNodes(std::vector<Node*> const& nodes,
+            Qt::ItemSelectionOperation operation)
+{
+  changeSelection(nodes, {}, operation);
+}
+
+
+void
+FlowScene::
+selectConnections(std::vector<Connection*> const& connections,
+                  Qt::ItemSelectionOperation operation)
+{
+  changeSelection({}, connections, operation);
+}
+
+
+void
+FlowScene::
+changeSelection(std::vector<Node*> const& nodes,
+                std::vector<Connection*> const& connections,
+                Qt::ItemSelectionOperation operation)
+{
+  bool changed = false;
+
+  // one selectionChanged() for the whole batch; only the selection is
+  // changed with the signals blocked, materializing a graphics object
+  // still reports what it does
+  auto select = [this, &changed](QGraphicsItem& item, bool selected)
+  {
+    QSignalBlocker blocker(this);
+
+    item.setSelected(selected);
+    changed = true;
+  };
+
+  if (operation == Qt::ReplaceSelection)
+  {
+    std::unordered_set<Node*> const wanted(nodes.begin(), nodes.end());
+    std::unordered_set<Connection*> const wantedConnections(connections.begin(),
+                                                            connections.end());
+
+    for (Connection* c : selectedConnections())
+    {
+      if (wantedConnections.count(c) == 0)
+        select(c->getConnectionGraphicsObject(), false);
+    }
+
+    for (Node* n : selectedNodes())
+    {
+      if (wanted.count(n) == 0)
+        select(n->nodeGraphicsObject(), false);
+    }
+  }
+
+  for (Node* n : nodes)
+  {
+    if (_selectedNodes.count(n) != 0)
+      continue;
+
+    select(n->nodeGraphicsObject(), true);
+  }
+
+  for (Connection* c : connections)
+  {
+    if (_selectedConnections.count(c) != 0)
+      continue;
+
+    ConnectionGraphicsObject& cgo = c->getConnectionGraphicsObject();
+
+    if (_connectionLayer)
+      _connectionLayer->promote(cgo);
+
+    select(cgo, true);
+
+    // batched again when it couldn't be selected, e.g. while locked
+    cgo.updateBatching();
+  }
+
+  if (changed)
+    Q_EMIT selectionChanged();
+}
+
+
+void
+FlowScene::
+selectNodesInRect(QRectF const& sceneRect,
+                  Qt::ItemSelectionMode mode,
+                  Qt::ItemSelectionOperation operation)
+{
+  selectNodes(nodesInRect(sceneRect, mode), operation);
+}
+
+
+void
+FlowScene::
+selectInRect(QRectF const& sceneRect,
+             Qt::ItemSelectionMode mode,
+             Qt::ItemSelectionOperation operation)
+{
+  changeSelection(nodesInRect(sceneRect, mode),
+                  connectionsInRect(sceneRect, mode),
+                  operation);
+}
+
+
+void
+FlowScene::
+selectNodesByModelName(QString const& modelName,
+                       Qt::ItemSelectionOperation operation)
+{
+  std::vector<Node*> nodes;
+
+  auto it = _nodesByModelName.find(modelName);
+
+  if (it != _nodesByModelName.end())
+    nodes.assign(it->second.begin(), it->second.end());
+
+  selectNodes(nodes, operation);
+}
+
+
+void
+FlowScene::
+nodeSelectionChanged(Node& node, bool selected)
+{
+  if (selected)
+    _selectedNodes.insert(&node);
+  else
+    _selectedNodes.erase(&node);
+}
+
+
+void
+FlowScene::
+connectionSelectionChanged(Connection& connection, bool selected)
+{
+  if (selected)
+    _selectedConnections.insert(&connection);
+  else
+    _selectedConnections.erase(&connection);
+}
+
+
+void
+FlowScene::
+registerNode(Node& node)
+{
+  _nodesByModelName[node.nodeDataModel()->name()].insert(&node);
+
+  _spatialIndexPending.insert(node.id());
+
+  // a graphics object reports its own moves, a node without one
+  // is only moved through setPosition()
+  connect(&node, &Node::positionChanged, this, [this, &node]
+  {
+    if (!node.hasGraphicsObject())
+      scheduleNodeMoved(node);
+  });
+}
+
+
+void
+FlowScene::
+unregisterNode(Node& node)
+{
+  _selectedNodes.erase(&node);
+
+  auto it = _nodesByModelName.find(node.nodeDataModel()->name());
+
+  if (it != _nodesByModelName.end())
+  {
+    it->second.erase(&node);
+
+    if (it->second.empty())
+      _nodesByModelName.erase(it);
+  }
+
+  _spatialIndex->remove(node);
+
+  _spatialIndexPending.erase(node.id());
+}
+
+
+void
+FlowScene::
+updateSpatialIndex() const
+{
+  for (QUuid const & id : _spatialIndexPending)
+  {
+    auto it = _nodes.find(id);
+
+    if (it == _nodes.end())
+      continue;
+
+    Node& node = *it->second;
+
+    _spatialIndex->update(node);
+
+    for (PortType portType: {PortType::In, PortType::Out})
+    {
+      for (auto const & connections : node.nodeState().getEntries(portType))
+      {
+        for (auto const & pair : connections)
+        {
+          Connection* connection = pair.second;
+
+          if (connection->complete())
+            _connectionIndex->insert(connection, connectionSceneRect(*connection));
+        }
+      }
+    }
+  }
+
+  _spatialIndexPending.clear();
+}
+
+
+//------------------------------------------------------------------------------
+
+void
+FlowScene::
+clearScene()
+{
+  //Manual node cleanup. Simply clearing the holding datastructures doesn't work, the code crashes when
+  // there are both nodes and connections in the scene. (The data propagation internal logic tries to propagate
+  // data through already freed connections.)
+  while (_connections.size() > 0)
+  {
+    deleteConnection( *_connections.begin()->second );
+  }
+
+  while (_nodes.size() > 0)
+  {
+    removeNode( *_nodes.begin()->second );
+  }
+}
+
+
+void
+FlowScene::
+save() const
+{
+  QString fileName =
+    QFileDialog::getSaveFileName(nullptr,
+                                 tr("Open Flow Scene"),
+                                 QDir::homePath(),
+                                 tr("Flow Scene Files (*.flow)"));
+
+  if (!fileName.isEmpty())
+  {
+    if (!fileName.endsWith("flow", Qt::CaseInsensitive))
+      fileName += ".flow";
+
+    QFile file(fileName);
+    if (file.open(QIODevice::WriteOnly))
+    {
+      saveToDevice(file);
+    }
+  }
+}
+
+
+void
+FlowScene::
+load()
+{
+  QString fileName =
+    QFileDialog::getOpenFileName(nullptr,
+                                 tr("Open Flow Scene"),
+                                 QDir::homePath(),
+                                 tr("Flow Scene Files (*.flow)"));
+
+  if (!QFileInfo::exists(fileName))
+    return;
+
+  QFile file(fileName);
+
+  if (!file.open(QIODevice::ReadOnly))
+    return;
+
+  // the removals aren't recorded either
+  loadDeferringPropagation([&]()
+  {
+    clearScene();
+
+    loadFromDevice(file);
+  });
+}
+
+
+QByteArray
+FlowScene::
+saveToMemory(SceneFormat format, SceneCompression compression) const
+{
+  if (format == SceneFormat::Binary || compression != SceneCompression::None)
+  {
+    QByteArray data;
+
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+
+    saveToDevice(buffer, format, ProgressCallback(), compression);
+
+    return data;
+  }
+
+  QJsonObject sceneJson;
+
+  QJsonArray nodesJsonArray;
+
+  for (auto const & pair : _nodes)
+  {
+    auto const &node = pair.second;
+
+    nodesJsonArray.append(node->save());
+  }
+
+  sceneJson["nodes"] = nodesJsonArray;
+
+  QJsonArray connectionJsonArray;
+  for (auto const & pair : _connections)
+  {
+    auto const &connection = pair.second;
+
+    QJsonObject connectionJson = connection->save();
+
+    if (!connectionJson.isEmpty())
+      connectionJsonArray.append(connectionJson);
+  }
+
+  sceneJson["connections"] = connectionJsonArray;
+
+  QJsonDocument document(sceneJson);
+
+  return document.toJson();
+}
+
+
+void
+FlowScene::
+loadFromMemory(const QByteArray& data)
+{
+  if (ChunkedCompression::isCompressed(data))
+  {
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    loadFromDevice(buffer);
+    return;
+  }
+
+  loadDeferringPropagation([&]()
+  {
+    if (BinarySceneReader::isBinary(data))
+    {
+      QBuffer buffer;
+      buffer.setData(data);
+      buffer.open(QIODevice::ReadOnly);
+
+      loadBinary(buffer, ProgressCallback());
+      return;
+    }
+
+    QJsonObject const jsonDocument = QJsonDocument::fromJson(data).object();
+
+    restoreNodes(jsonDocument["nodes"].toArray());
+
+    QJsonArray connectionJsonArray = jsonDocument["connections"].toArray();
+
+    for (QJsonValueRef connection : connectionJsonArray)
+    {
+      restoreConnection(connection.toObject());
+    }
+  });
+}
+
+
+bool
 FlowScene::
-allNodes() const
+saveToDevice(QIODevice& device,
+             SceneFormat format,
+             ProgressCallback const& progress,
+             SceneCompression compression) const
 {
-  std::vector<Node*> nodes;
+  if (compression == SceneCompression::Chunked)
+  {
+    ChunkedCompressionWriter compressed(device);
+    compressed.open(QIODevice::WriteOnly);
 
-  std::transform(_nodes.begin(),
-                 _nodes.end(),
-                 std::back_inserter(nodes),
-                 [](std::pair<QUuid const, std::unique_ptr<Node>> const & p) { return p.second.get(); });
+    bool const saved = saveToDevice(compressed, format, progress);
 
-  return nodes;
+    return compressed.finish() && saved;
+  }
+
+  if (format == SceneFormat::Binary)
+    return saveBinary(device, progress);
+
+  JsonSceneStreamWriter writer(device);
+
+  qint64 const total = _nodes.size() + _connections.size();
+  qint64 done = 0;
+
+  auto report = [&]()
+  {
+    if (progress && (++done % ProgressInterval == 0 || done == total))
+      progress(done, total);
+  };
+
+  writer.beginNodes();
+
+  for (auto const & pair : _nodes)
+  {
+    writer.writeNode(pair.second->save());
+    report();
+  }
+
+  writer.beginConnections();
+
+  for (auto const & pair : _connections)
+  {
+    QJsonObject connectionJson = pair.second->save();
+
+    if (!connectionJson.isEmpty())
+      writer.writeConnection(connectionJson);
+
+    report();
+  }
+
+  writer.end();
+
+  return writer.ok();
 }
 
 
-std::vector<Node*>
+void
 FlowScene::
-selectedNodes() const
+loadFromDevice(QIODevice& device,
+               ProgressCallback const& progress)
 {
-  QList<QGraphicsItem*> graphicsItems = selectedItems();
-
-  std::vector<Node*> ret;
-  ret.reserve(graphicsItems.size());
+  auto load = [this](QIODevice& source, ProgressCallback const& report)
+  {
+    if (BinarySceneReader::isBinary(source.peek(BinarySceneReader::magic().size())))
+      loadBinary(source, report);
+    else
+      loadJson(source, report);
+  };
 
-  for (QGraphicsItem* item : graphicsItems)
+  loadDeferringPropagation([&]()
   {
-    auto ngo = qgraphicsitem_cast<NodeGraphicsObject*>(item);
+    if (!ChunkedCompression::isCompressed(device.peek(ChunkedCompression::magic().size())))
+    {
+      load(device, progress);
+      return;
+    }
+
+    ChunkedCompressionReader decompressed(device);
+    decompressed.open(QIODevice::ReadOnly);
+
+    // the progress goes by the compressed bytes
+    ProgressCallback compressedProgress;
 
-    if (ngo != nullptr)
+    if (progress)
     {
-      ret.push_back(&ngo->node());
+      compressedProgress = [&](qint64, qint64)
+      {
+        progress(device.pos(), device.isSequential() ? 0 : device.size());
+      };
     }
-  }
 
-  return ret;
+    load(decompressed, compressedProgress);
+  });
 }
 
 
-//------------------------------------------------------------------------------
-
 void
 FlowScene::
-clearScene()
+propagateDeferredData()
 {
-  //Manual node cleanup. Simply clearing the holding datastructures doesn't work, the code crashes when
-  // there are both nodes and connections in the scene. (The data propagation internal logic tries to propagate
-  // data through already freed connections.)
-  while (_connections.size() > 0)
+  std::unordered_set<QUuid> targets;
+  targets.swap(_deferredPropagationTargets);
+
+  auto forEachConnection = [](Node& node, PortType portType,
+                              std::function<void(Connection&)> const& f)
   {
-    deleteConnection( *_connections.begin()->second );
+    for (auto const & connections : node.nodeState().getEntries(portType))
+      for (auto const & pair : connections)
+        f(*pair.second);
+  };
+
+  // the inputs of the targets changed, and so may those of
+  // every node downstream of them
+  std::unordered_set<Node*> affected;
+  std::vector<Node*> stack;
+
+  for (QUuid const& id : targets)
+  {
+    auto it = _nodes.find(id);
+
+    if (it != _nodes.end() && affected.insert(it->second.get()).second)
+      stack.push_back(it->second.get());
   }
 
-  while (_nodes.size() > 0)
+  while (!stack.empty())
   {
-    removeNode( *_nodes.begin()->second );
+    Node* node = stack.back();
+    stack.pop_back();
+
+    forEachConnection(*node, PortType::Out, [&](Connection& c)
+    {
+      Node* downstream = c.getNode(PortType::In);
+
+      if (downstream && affected.insert(downstream).second)
+        stack.push_back(downstream);
+    });
   }
-}
 
+  // Kahn's algorithm over the affected nodes, the nodes on or
+  // after a cycle come last in no particular order
+  std::unordered_map<Node*, std::size_t> pendingInputs;
+  std::vector<Node*> ready;
 
-void
-FlowScene::
-save() const
-{
-  QString fileName =
-    QFileDialog::getSaveFileName(nullptr,
-                                 tr("Open Flow Scene"),
-                                 QDir::homePath(),
-                                 tr("Flow Scene Files (*.flow)"));
+  for (Node* node : affected)
+  {
+    std::size_t count = 0;
 
-  if (!fileName.isEmpty())
+    forEachConnection(*node, PortType::In, [&](Connection& c)
+    {
+      if (affected.count(c.getNode(PortType::Out)))
+        ++count;
+    });
+
+    pendingInputs[node] = count;
+
+    if (count == 0)
+      ready.push_back(node);
+  }
+
+  std::vector<Node*> order;
+  order.reserve(affected.size());
+
+  while (!ready.empty())
   {
-    if (!fileName.endsWith("flow", Qt::CaseInsensitive))
-      fileName += ".flow";
+    Node* node = ready.back();
+    ready.pop_back();
 
-    QFile file(fileName);
-    if (file.open(QIODevice::WriteOnly))
+    order.push_back(node);
+
+    forEachConnection(*node, PortType::Out, [&](Connection& c)
+    {
+      Node* downstream = c.getNode(PortType::In);
+
+      if (affected.count(downstream) && --pendingInputs[downstream] == 0)
+        ready.push_back(downstream);
+    });
+  }
+
+  for (auto const & pair : pendingInputs)
+    if (pair.second > 0)
+      order.push_back(pair.first);
+
+  for (Node* node : order)
+  {
+    // The node's dataUpdated() would push its outputs downstream right
+    // away; the pass gets to the downstream nodes itself.
+    node->setDataForwarding(false);
+
+    try
+    {
+      forEachConnection(*node, PortType::In, [](Connection& c)
+      {
+        Node* upstream = c.getNode(PortType::Out);
+
+        if (upstream)
+          c.propagateData(upstream->nodeDataModel()->outData(c.getPortIndex(PortType::Out)));
+      });
+    }
+    catch (...)
     {
-      file.write(saveToMemory());
+      node->setDataForwarding(true);
+      throw;
     }
+
+    node->setDataForwarding(true);
   }
 }
 
 
 void
 FlowScene::
-load()
+deferPropagationDuring(std::function<void()> const& work)
 {
-  QString fileName =
-    QFileDialog::getOpenFileName(nullptr,
-                                 tr("Open Flow Scene"),
-                                 QDir::homePath(),
-                                 tr("Flow Scene Files (*.flow)"));
-
-  if (!QFileInfo::exists(fileName))
+  if (_dataPropagationDeferred)
+  {
+    work();
     return;
+  }
 
-  QFile file(fileName);
+  _dataPropagationDeferred = true;
 
-  if (!file.open(QIODevice::ReadOnly))
-    return;
+  try
+  {
+    work();
+  }
+  catch (...)
+  {
+    // the scene is left half done, nothing worth propagating
+    _dataPropagationDeferred = false;
+    _deferredPropagationTargets.clear();
+    throw;
+  }
 
-  clearScene();
+  setDataPropagationDeferred(false);
+}
+
+
+void
+FlowScene::
+loadDeferringPropagation(std::function<void()> const& load)
+{
+  // the steps recorded before don't apply to the loaded scene
+  bool const recording = _history->isEnabled();
+
+  _history->setEnabled(false);
 
-  QByteArray wholeFile = file.readAll();
+  try
+  {
+    deferPropagationDuring(load);
+  }
+  catch (...)
+  {
+    _history->setEnabled(recording);
+    _history->clear();
+    throw;
+  }
 
-  loadFromMemory(wholeFile);
+  _history->setEnabled(recording);
+  _history->clear();
 }
 
 
-QByteArray
+bool
 FlowScene::
-saveToMemory() const
+saveBinary(QIODevice& device, ProgressCallback const& progress) const
 {
-  QJsonObject sceneJson;
+  BinarySceneWriter writer(device);
 
-  QJsonArray nodesJsonArray;
+  qint64 const total = _nodes.size() + _connections.size();
+  qint64 done = 0;
+
+  auto report = [&]()
+  {
+    if (progress && (++done % ProgressInterval == 0 || done == total))
+      progress(done, total);
+  };
+
+  writer.writeHeader();
 
   for (auto const & pair : _nodes)
   {
-    auto const &node = pair.second;
+    writer.writeNode(*pair.second);
+    report();
+  }
 
-    nodesJsonArray.append(node->save());
+  for (auto const & pair : _connections)
+  {
+    writer.writeConnection(*pair.second);
+    report();
   }
 
-  sceneJson["nodes"] = nodesJsonArray;
+  writer.writeEnd();
 
-  QJsonArray connectionJsonArray;
-  for (auto const & pair : _connections)
+  return writer.ok();
+}
+
+
+void
+FlowScene::
+loadBinary(QIODevice& device, ProgressCallback const& progress)
+{
+  BinarySceneReader reader(device);
+
+  // sequential devices have no size
+  qint64 const total = device.isSequential() ? 0 : device.size();
+  qint64 records = 0;
+
+  auto report = [&]()
   {
-    auto const &connection = pair.second;
+    if (progress && ++records % ProgressInterval == 0)
+      progress(device.pos(), total);
+  };
 
-    QJsonObject connectionJson = connection->save();
+  std::vector<PendingNode> batch;
 
-    if (!connectionJson.isEmpty())
-      connectionJsonArray.append(connectionJson);
-  }
+  auto restoreBatch = [&]()
+  {
+    restoreNodeBatch(batch);
+    batch.clear();
+  };
 
-  sceneJson["connections"] = connectionJsonArray;
+  for (;;)
+  {
+    switch (reader.next())
+    {
+      case BinarySceneReader::Record::Node:
+      {
+        auto const & r = reader.node();
 
-  QJsonDocument document(sceneJson);
+        PendingNode pending;
+        pending.id        = r.id;
+        pending.modelName = r.modelName;
+        pending.position  = r.position;
+        pending.modelJson = r.model;
 
-  return document.toJson();
+        batch.push_back(std::move(pending));
+
+        if (batch.size() == RestoreBatchSize)
+          restoreBatch();
+
+        report();
+        break;
+      }
+
+      case BinarySceneReader::Record::Connection:
+      {
+        auto const & r = reader.connection();
+
+        restoreBatch();
+
+        restoreConnection(r.inId, r.inIndex,
+                          r.outId, r.outIndex,
+                          r.converterIn, r.converterOut);
+        report();
+        break;
+      }
+
+      case BinarySceneReader::Record::End:
+        restoreBatch();
+
+        if (progress)
+          progress(device.pos(), total);
+        return;
+    }
+  }
 }
 
 
 void
 FlowScene::
-loadFromMemory(const QByteArray& data)
+loadJson(QIODevice& device, ProgressCallback const& progress)
 {
-  QJsonObject const jsonDocument = QJsonDocument::fromJson(data).object();
+  JsonSceneStreamReader reader(device);
+
+  qint64 const start = device.isSequential() ? 0 : device.pos();
+  qint64 const total = device.isSequential() ? 0 : device.size() - start;
+  qint64 elements = 0;
+
+  bool nodesRestored = false;
+
+  // connections met before the nodes are read again on a second pass
+  // over a seekable device, kept aside from a sequential one
+  bool secondPass = false;
+
+  std::vector<QJsonObject> pendingConnections;
+
+  using Array = JsonSceneStreamReader::Array;
+
+  QJsonArray batch;
+
+  auto restoreBatch = [&]()
+  {
+    restoreNodes(batch);
+    batch = QJsonArray();
+  };
+
+  reader.read(
+    [&](Array array, QJsonObject const& json)
+    {
+      if (array == Array::Nodes)
+      {
+        batch.append(json);
+
+        if (std::size_t(batch.size()) == RestoreBatchSize)
+          restoreBatch();
+      }
+      else if (nodesRestored)
+        restoreConnection(json);
+      else if (!device.isSequential())
+        secondPass = true;
+      else
+        pendingConnections.push_back(json);
+
+      if (progress && ++elements % ProgressInterval == 0)
+        progress(reader.bytesRead(), total);
+    },
+    [&](Array array)
+    {
+      if (array != Array::Nodes)
+        return;
+
+      restoreBatch();
+
+      nodesRestored = true;
+
+      for (QJsonObject const& connectionJson : pendingConnections)
+        restoreConnection(connectionJson);
 
-  QJsonArray nodesJsonArray = jsonDocument["nodes"].toArray();
+      pendingConnections.clear();
+      pendingConnections.shrink_to_fit();
+    });
+
+  // documents without a node array
+  for (QJsonObject const& connectionJson : pendingConnections)
+    restoreConnection(connectionJson);
 
-  for (QJsonValueRef node : nodesJsonArray)
+  if (secondPass)
   {
-    restoreNode(node.toObject());
+    if (!device.seek(start))
+      throw std::logic_error("JSON scene: cannot read the connections again");
+
+    JsonSceneStreamReader connectionReader(device);
+
+    connectionReader.read(
+      [&](Array array, QJsonObject const& json)
+      {
+        if (array == Array::Connections)
+          restoreConnection(json);
+      },
+      [](Array) {});
   }
 
-  QJsonArray connectionJsonArray = jsonDocument["connections"].toArray();
+  // trailing whitespace is left unread
+  if (progress)
+    progress(total > 0 ? total : reader.bytesRead(), total);
+}
+
 
-  for (QJsonValueRef connection : connectionJsonArray)
+void
+FlowScene::
+mouseMoveEvent(QGraphicsSceneMouseEvent* event)
+{
+  // Batched connections have no hover handling of their own. The one
+  // under the cursor is promoted before the hover events are dispatched.
+  if (_connectionLayer &&
+      event->buttons() == Qt::NoButton &&
+      mouseGrabberItem() == nullptr)
   {
-    restoreConnection(connection.toObject());
+    _connectionLayer->promoteAt(event->scenePos());
   }
+
+  QGraphicsScene::mouseMoveEvent(event);
+}
+
+
+void
+FlowScene::
+setGraphicsObjectFactory(Node& node)
+{
+  node.setGraphicsObjectFactory(
+    [this](Node& n)
+    {
+      return detail::make_unique<NodeGraphicsObject>(*this, n);
+    });
+
+  node.setSizeChangedCallback(
+    [this](Node const& n)
+    {
+      scheduleConnectionsUpdate(n);
+    });
+}
+
+
+void
+FlowScene::
+setGraphicsObjectFactory(Connection& connection)
+{
+  connection.setGraphicsObjectFactory(
+    [this](Connection& c)
+    {
+      return detail::make_unique<ConnectionGraphicsObject>(*this, c);
+    });
 }
 
 
@@ -593,6 +2226,30 @@ setupConnectionSignals(Connection const& c)
 }
 
 
+void
+FlowScene::
+updatePortRows(Node& node, PortType portType, PortIndex portIndex)
+{
+  NodeGeometry const & geom = node.nodeGeometry();
+
+  if (!geom.portsVirtualized())
+    return;
+
+  PortIndex const first = geom.firstVisiblePort();
+
+  if (portIndex >= first &&
+      portIndex < first + static_cast<PortIndex>(geom.maxPortRows()))
+    return;
+
+  geom.recalculateSize();
+
+  if (node.hasGraphicsObject())
+    node.nodeGraphicsObject().update();
+
+  scheduleConnectionsUpdate(node);
+}
+
+
 void
 FlowScene::
 sendConnectionCreatedToNodes(Connection const& c)
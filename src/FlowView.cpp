@@ -8,6 +8,7 @@
 
 #include <QtCore/QRectF>
 #include <QtCore/QPointF>
+#include <QtCore/QElapsedTimer>
 
 #include <QtOpenGL>
 #include <QtWidgets>
@@ -15,23 +16,53 @@
 #include <QDebug>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <stdexcept>
 
 #include "FlowScene.hpp"
+#include "SceneHistory.hpp"
 #include "DataModelRegistry.hpp"
 #include "Node.hpp"
 #include "NodeGraphicsObject.hpp"
+#include "PixmapCache.hpp"
 #include "ConnectionGraphicsObject.hpp"
+#include "Connection.hpp"
 #include "StyleCollection.hpp"
+#include "ViewportUpdatePolicy.hpp"
+#include "memory.hpp"
 
 using QtNodes::FlowView;
 using QtNodes::FlowScene;
+using QtNodes::Node;
+using QtNodes::Connection;
+using QtNodes::ViewportUpdatePolicy;
+using QtNodes::SceneHistory;
+using QtNodes::PixmapCache;
+
+namespace
+{
+
+QString const NodesMimeType = QStringLiteral("application/x-nodeeditor-nodes");
+
+// the copies are shifted so that they don't hide the originals
+QPointF const CopyOffset(20.0, 20.0);
+}
 
 FlowView::
 FlowView(QWidget *parent)
   : QGraphicsView(parent)
   , _clearSelectionAction(Q_NULLPTR)
   , _deleteSelectionAction(Q_NULLPTR)
+  , _undoAction(Q_NULLPTR)
+  , _redoAction(Q_NULLPTR)
+  , _copySelectionAction(Q_NULLPTR)
+  , _pasteAction(Q_NULLPTR)
+  , _duplicateSelectionAction(Q_NULLPTR)
+  , _pasteCount(0)
+  , _rubberBand(Q_NULLPTR)
   , _scene(Q_NULLPTR)
+  , _visibleSceneRectUpdateScheduled(false)
+  , _viewportUpdatePolicy(detail::make_unique<ViewportUpdatePolicy>())
 {
   setDragMode(QGraphicsView::ScrollHandDrag);
   setRenderHint(QPainter::Antialiasing);
@@ -40,8 +71,9 @@ FlowView(QWidget *parent)
 
   setBackgroundBrush(flowViewStyle.BackgroundColor);
 
-  //setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
-  //setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+  // adapted at runtime, see paintEvent()
+  setViewportUpdateMode(_viewportUpdatePolicy->mode());
+
   setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
   setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
 
@@ -61,6 +93,10 @@ FlowView(FlowScene *scene, QWidget *parent)
 }
 
 
+FlowView::
+~FlowView() = default;
+
+
 QAction*
 FlowView::
 clearSelectionAction() const
@@ -77,12 +113,71 @@ deleteSelectionAction() const
 }
 
 
+QAction*
+FlowView::
+undoAction() const
+{
+  return _undoAction;
+}
+
+
+QAction*
+FlowView::
+redoAction() const
+{
+  return _redoAction;
+}
+
+
+QAction*
+FlowView::
+copySelectionAction() const
+{
+  return _copySelectionAction;
+}
+
+
+QAction*
+FlowView::
+pasteAction() const
+{
+  return _pasteAction;
+}
+
+
+QAction*
+FlowView::
+duplicateSelectionAction() const
+{
+  return _duplicateSelectionAction;
+}
+
+
 void
 FlowView::setScene(FlowScene *scene)
 {
+  if (_scene)
+  {
+    disconnect(_scene, &FlowScene::nodeCreated, this, nullptr);
+
+    // the actions stop driving the history of the previous scene
+    if (_undoAction)
+      disconnect(_undoAction, nullptr, &_scene->history(), nullptr);
+
+    if (_redoAction)
+      disconnect(_redoAction, nullptr, &_scene->history(), nullptr);
+  }
+
   _scene = scene;
   QGraphicsView::setScene(_scene);
 
+  // lazily created nodes may appear right in the view
+  if (_scene)
+  {
+    connect(_scene, &FlowScene::nodeCreated,
+            this, [this] { scheduleVisibleSceneRectUpdate(); });
+  }
+
   // setup actions
   delete _clearSelectionAction;
   _clearSelectionAction = new QAction(QStringLiteral("Clear Selection"), this);
@@ -95,6 +190,98 @@ FlowView::setScene(FlowScene *scene)
   _deleteSelectionAction->setShortcut(Qt::Key_Delete);
   connect(_deleteSelectionAction, &QAction::triggered, this, &FlowView::deleteSelectedNodes);
   addAction(_deleteSelectionAction);
+
+  delete _undoAction;
+  _undoAction = new QAction(QStringLiteral("Undo"), this);
+  _undoAction->setShortcut(QKeySequence::Undo);
+  if (_scene)
+    connect(_undoAction, &QAction::triggered, &_scene->history(), &SceneHistory::undo);
+  addAction(_undoAction);
+
+  delete _redoAction;
+  _redoAction = new QAction(QStringLiteral("Redo"), this);
+  _redoAction->setShortcut(QKeySequence::Redo);
+  if (_scene)
+    connect(_redoAction, &QAction::triggered, &_scene->history(), &SceneHistory::redo);
+  addAction(_redoAction);
+
+  delete _copySelectionAction;
+  _copySelectionAction = new QAction(QStringLiteral("Copy Selection"), this);
+  _copySelectionAction->setShortcut(QKeySequence::Copy);
+  connect(_copySelectionAction, &QAction::triggered, this, &FlowView::copySelectedNodes);
+  addAction(_copySelectionAction);
+
+  delete _pasteAction;
+  _pasteAction = new QAction(QStringLiteral("Paste"), this);
+  _pasteAction->setShortcut(QKeySequence::Paste);
+  connect(_pasteAction, &QAction::triggered, this, &FlowView::pasteNodes);
+  addAction(_pasteAction);
+
+  delete _duplicateSelectionAction;
+  _duplicateSelectionAction = new QAction(QStringLiteral("Duplicate Selection"), this);
+  _duplicateSelectionAction->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_D));
+  connect(_duplicateSelectionAction, &QAction::triggered, this, &FlowView::duplicateSelectedNodes);
+  addAction(_duplicateSelectionAction);
+}
+
+
+QRectF
+FlowView::
+visibleSceneRect() const
+{
+  return mapToScene(viewport()->rect()).boundingRect();
+}
+
+
+void
+FlowView::
+centerOnScenePoint(QPointF const& scenePoint)
+{
+  // panning moves the scene rect, like dragging the view does
+  QPointF const center = mapToScene(viewport()->rect().center());
+
+  QPointF const difference = scenePoint - center;
+
+  setSceneRect(sceneRect().translated(difference.x(), difference.y()));
+
+  updateVisibleSceneRect();
+}
+
+
+void
+FlowView::
+setAdaptiveViewportUpdate(bool enabled)
+{
+  if (enabled == adaptiveViewportUpdate())
+    return;
+
+  if (enabled)
+  {
+    _viewportUpdatePolicy = detail::make_unique<ViewportUpdatePolicy>();
+    _viewportUpdatePolicy->reset(viewportUpdateMode());
+  }
+  else
+  {
+    _viewportUpdatePolicy.reset();
+  }
+}
+
+
+bool
+FlowView::
+adaptiveViewportUpdate() const
+{
+  return _viewportUpdatePolicy != nullptr;
+}
+
+
+void
+FlowView::
+pinViewportUpdateMode(QGraphicsView::ViewportUpdateMode mode)
+{
+  setAdaptiveViewportUpdate(false);
+
+  setViewportUpdateMode(mode);
 }
 
 
@@ -208,6 +395,22 @@ void
 FlowView::
 wheelEvent(QWheelEvent *event)
 {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+  QPoint const pos = event->position().toPoint();
+#else
+  QPoint const pos = event->pos();
+#endif
+
+  // nodes with scrollable port rows take the wheel, elsewhere it zooms
+  if (auto ngo = qgraphicsitem_cast<NodeGraphicsObject*>(itemAt(pos)))
+  {
+    if (ngo->node().nodeGeometry().portsVirtualized())
+    {
+      QGraphicsView::wheelEvent(event);
+      return;
+    }
+  }
+
   QPoint delta = event->angleDelta();
 
   if (delta.y() == 0)
@@ -238,6 +441,8 @@ scaleUp()
     return;
 
   scale(factor, factor);
+
+  updateVisibleSceneRect();
 }
 
 
@@ -249,6 +454,8 @@ scaleDown()
   double const factor = std::pow(step, -1.0);
 
   scale(factor, factor);
+
+  updateVisibleSceneRect();
 }
 
 
@@ -259,24 +466,79 @@ deleteSelectedNodes()
   // Delete the selected connections first, ensuring that they won't be
   // automatically deleted when selected nodes are deleted (deleting a node
   // deletes some connections as well)
-  for (QGraphicsItem * item : _scene->selectedItems())
+  for (Connection* c : _scene->selectedConnections())
+    _scene->deleteConnection(*c);
+
+  // Delete the nodes; this will delete many of the connections.
+  // Selected connections were already deleted prior to this loop, so
+  // the selection only holds nodes by now.
+  for (Node* n : _scene->selectedNodes())
+    _scene->removeNode(*n);
+}
+
+
+void
+FlowView::
+copySelectedNodes()
+{
+  std::vector<Node*> const nodes = _scene->selectedNodes();
+
+  if (nodes.empty())
+    return;
+
+  auto mimeData = new QMimeData;
+  mimeData->setData(NodesMimeType, _scene->copyNodes(nodes));
+
+  QApplication::clipboard()->setMimeData(mimeData);
+
+  // the next paste starts next to the copied nodes again
+  _lastPasted.clear();
+  _pasteCount = 0;
+}
+
+
+void
+FlowView::
+pasteNodes()
+{
+  QMimeData const* mimeData = QApplication::clipboard()->mimeData();
+
+  if (!mimeData || !mimeData->hasFormat(NodesMimeType))
+    return;
+
+  QByteArray const data = mimeData->data(NodesMimeType);
+
+  if (data != _lastPasted)
   {
-    if (auto c = qgraphicsitem_cast<ConnectionGraphicsObject*>(item))
-      _scene->deleteConnection(c->connection());
+    _lastPasted = data;
+    _pasteCount = 0;
   }
 
-  // Delete the nodes; this will delete many of the connections.
-  // Selected connections were already deleted prior to this loop, otherwise
-  // qgraphicsitem_cast<NodeGraphicsObject*>(item) could be a use-after-free
-  // when a selected connection is deleted by deleting the node.
-  for (QGraphicsItem * item : _scene->selectedItems())
+  try
   {
-    if (auto n = qgraphicsitem_cast<NodeGraphicsObject*>(item))
-      _scene->removeNode(n->node());
+    _scene->pasteNodes(data, CopyOffset * (_pasteCount + 1));
+
+    ++_pasteCount;
+  }
+  catch (std::logic_error const& e)
+  {
+    // the clipboard may hold data from another build
+    qWarning() << "FlowView: can't paste the nodes:" << e.what();
   }
 }
 
 
+void
+FlowView::
+duplicateSelectedNodes()
+{
+  std::vector<Node*> const nodes = _scene->selectedNodes();
+
+  if (!nodes.empty())
+    _scene->duplicateNodes(nodes, CopyOffset);
+}
+
+
 void
 FlowView::
 keyPressEvent(QKeyEvent *event)
@@ -284,7 +546,8 @@ keyPressEvent(QKeyEvent *event)
   switch (event->key())
   {
     case Qt::Key_Shift:
-      setDragMode(QGraphicsView::RubberBandDrag);
+      // the rubber band is handled by the view, see mousePressEvent()
+      setDragMode(QGraphicsView::NoDrag);
       break;
 
     default:
@@ -316,6 +579,26 @@ void
 FlowView::
 mousePressEvent(QMouseEvent *event)
 {
+  // Qt's own rubber band tests every item of the scene on every move;
+  // ours queries the spatial index of the scene
+  if (_scene &&
+      event->button() == Qt::LeftButton &&
+      (event->modifiers() & Qt::ShiftModifier) &&
+      itemAt(event->pos()) == nullptr)
+  {
+    if (!_rubberBand)
+      _rubberBand = new QRubberBand(QRubberBand::Rectangle, viewport());
+
+    _rubberBandOrigin = event->pos();
+    _rubberBand->setGeometry(QRect(_rubberBandOrigin, QSize()));
+    _rubberBand->show();
+
+    _scene->selectNodes({});
+
+    event->accept();
+    return;
+  }
+
   QGraphicsView::mousePressEvent(event);
   if (event->button() == Qt::LeftButton)
   {
@@ -328,6 +611,18 @@ void
 FlowView::
 mouseMoveEvent(QMouseEvent *event)
 {
+  if (_rubberBand && _rubberBand->isVisible())
+  {
+    QRect const r = QRect(_rubberBandOrigin, event->pos()).normalized();
+
+    _rubberBand->setGeometry(r);
+
+    _scene->selectInRect(mapToScene(r).boundingRect());
+
+    event->accept();
+    return;
+  }
+
   QGraphicsView::mouseMoveEvent(event);
   if (scene()->mouseGrabberItem() == nullptr && event->buttons() == Qt::LeftButton)
   {
@@ -336,60 +631,145 @@ mouseMoveEvent(QMouseEvent *event)
     {
       QPointF difference = _clickPos - mapToScene(event->pos());
       setSceneRect(sceneRect().translated(difference.x(), difference.y()));
+
+      updateVisibleSceneRect();
     }
   }
 }
 
 
+void
+FlowView::
+mouseReleaseEvent(QMouseEvent *event)
+{
+  if (_rubberBand && _rubberBand->isVisible())
+  {
+    _rubberBand->hide();
+
+    event->accept();
+    return;
+  }
+
+  QGraphicsView::mouseReleaseEvent(event);
+}
+
+
 void
 FlowView::
 drawBackground(QPainter* painter, const QRectF& r)
 {
   QGraphicsView::drawBackground(painter, r);
 
-  auto drawGrid =
-    [&](double gridStep)
-    {
-      QRect   windowRect = rect();
-      QPointF tl = mapToScene(windowRect.topLeft());
-      QPointF br = mapToScene(windowRect.bottomRight());
+  double const fineStep   = 15.0;
+  double const coarseStep = 150.0;
 
-      double left   = std::floor(tl.x() / gridStep - 0.5);
-      double right  = std::floor(br.x() / gridStep + 1.0);
-      double bottom = std::floor(tl.y() / gridStep - 0.5);
-      double top    = std::floor (br.y() / gridStep + 1.0);
+  // grid lines closer than this on screen are not drawn
+  double const minLineSpacing = 5.0;
 
-      // vertical lines
-      for (int xi = int(left); xi <= int(right); ++xi)
-      {
-        QLineF line(xi * gridStep, bottom * gridStep,
-                    xi * gridStep, top * gridStep );
+  double const scale = transform().m11();
 
-        painter->drawLine(line);
-      }
+  if (coarseStep * scale < minLineSpacing)
+    return;
 
-      // horizontal lines
-      for (int yi = int(bottom); yi <= int(top); ++yi)
+  bool const drawFine = (fineStep * scale >= minLineSpacing);
+
+  auto const &flowViewStyle = StyleCollection::flowViewStyle();
+
+  // The tile is rendered at device resolution and repeated by a
+  // texture brush, so panning and repainting never draw single lines.
+  qreal const ratio = PixmapCache::devicePixelRatio(painter);
+
+  int const tilePixels = qRound(coarseStep * scale * ratio);
+
+  // the extent of the tile in device independent pixels, the painter
+  // and the brush scale it by the ratio
+  double const tileSize = tilePixels / ratio;
+
+  QString const key = QStringLiteral("%1@%2_%3_%4_%5")
+                      .arg(tilePixels)
+                      .arg(ratio)
+                      .arg(drawFine)
+                      .arg(flowViewStyle.FineGridColor.rgba())
+                      .arg(flowViewStyle.CoarseGridColor.rgba());
+
+  if (key != _gridTileKey)
+  {
+    _gridTile = QPixmap(tilePixels, tilePixels);
+    _gridTile.setDevicePixelRatio(ratio);
+    _gridTile.fill(Qt::transparent);
+
+    double const lineWidth = std::max(1.0, scale);
+
+    QPainter p(&_gridTile);
+
+    if (drawFine)
+    {
+      int const nFine = int(coarseStep / fineStep);
+
+      for (int i = 1; i < nFine; ++i)
       {
-        QLineF line(left * gridStep, yi * gridStep,
-                    right * gridStep, yi * gridStep );
-        painter->drawLine(line);
+        double const pos = i * tileSize / nFine;
+
+        p.fillRect(QRectF(pos, 0, lineWidth, tileSize), flowViewStyle.FineGridColor);
+        p.fillRect(QRectF(0, pos, tileSize, lineWidth), flowViewStyle.FineGridColor);
       }
-    };
+    }
 
-  auto const &flowViewStyle = StyleCollection::flowViewStyle();
+    p.fillRect(QRectF(0, 0, lineWidth, tileSize), flowViewStyle.CoarseGridColor);
+    p.fillRect(QRectF(0, 0, tileSize, lineWidth), flowViewStyle.CoarseGridColor);
+
+    _gridTileKey = key;
+  }
+
+  QBrush brush(_gridTile);
+
+  // maps the tile exactly onto one coarse cell of the scene
+  double const tileScale = coarseStep / tileSize;
+  brush.setTransform(QTransform::fromScale(tileScale, tileScale));
+
+  painter->fillRect(r, brush);
+}
 
-  QBrush bBrush = backgroundBrush();
 
-  QPen pfine(flowViewStyle.FineGridColor, 1.0);
+void
+FlowView::
+paintEvent(QPaintEvent *event)
+{
+  if (!_viewportUpdatePolicy)
+  {
+    QGraphicsView::paintEvent(event);
+    return;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
 
-  painter->setPen(pfine);
-  drawGrid(15);
+  QGraphicsView::paintEvent(event);
 
-  QPen p(flowViewStyle.CoarseGridColor, 1.0);
+  double const paintMilliseconds = timer.nsecsElapsed() / 1.0e6;
 
-  painter->setPen(p);
-  drawGrid(150);
+  QRegion const &region = event->region();
+
+  double dirtyArea = 0.0;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+  for (QRect const &r : region)
+#else
+  for (QRect const &r : region.rects())
+#endif
+    dirtyArea += double(r.width()) * r.height();
+
+  QRect const viewportRect = viewport()->rect();
+
+  double const viewportArea =
+    std::max(1.0, double(viewportRect.width()) * viewportRect.height());
+
+  if (_viewportUpdatePolicy->addFrame(paintMilliseconds,
+                                      dirtyArea / viewportArea,
+                                      region.rectCount()))
+  {
+    setViewportUpdateMode(_viewportUpdatePolicy->mode());
+  }
 }
 
 
@@ -399,6 +779,59 @@ showEvent(QShowEvent *event)
 {
   _scene->setSceneRect(this->rect());
   QGraphicsView::showEvent(event);
+
+  updateVisibleSceneRect();
+}
+
+
+void
+FlowView::
+resizeEvent(QResizeEvent *event)
+{
+  QGraphicsView::resizeEvent(event);
+
+  updateVisibleSceneRect();
+}
+
+
+void
+FlowView::
+scrollContentsBy(int dx, int dy)
+{
+  QGraphicsView::scrollContentsBy(dx, dy);
+
+  updateVisibleSceneRect();
+}
+
+
+void
+FlowView::
+updateVisibleSceneRect()
+{
+  _visibleSceneRectUpdateScheduled = false;
+
+  if (!_scene)
+    return;
+
+  QRectF const rect = visibleSceneRect();
+
+  if (_scene->lazyGraphicsObjects())
+    _scene->materializeGraphicsObjects(rect);
+
+  visibleSceneRectChanged(rect);
+}
+
+
+void
+FlowView::
+scheduleVisibleSceneRectUpdate()
+{
+  if (_visibleSceneRectUpdateScheduled)
+    return;
+
+  _visibleSceneRectUpdateScheduled = true;
+
+  QTimer::singleShot(0, this, [this] { updateVisibleSceneRect(); });
 }
 
 
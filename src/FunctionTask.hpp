@@ -0,0 +1,28 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+
+#include <QtCore/QRunnable>
+
+namespace QtNodes
+{
+
+/// Runs a function on a QThreadPool.
+class FunctionTask : public QRunnable
+{
+public:
+
+  explicit
+  FunctionTask(std::function<void()> function)
+    : _function(std::move(function))
+  {}
+
+  void
+  run() override { _function(); }
+
+private:
+
+  std::function<void()> _function;
+};
+}
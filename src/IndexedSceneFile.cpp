@@ -0,0 +1,902 @@
+#include "IndexedSceneFile.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <QtCore/QDebug>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtEndian>
+
+#include "FlowScene.hpp"
+#include "FlowView.hpp"
+#include "Node.hpp"
+#include "NodeDataModel.hpp"
+#include "Connection.hpp"
+#include "NodeSpatialIndex.hpp"
+#include "SceneBinaryFormat.hpp"
+#include "SceneHistory.hpp"
+
+using QtNodes::IndexedSceneFile;
+using QtNodes::FlowScene;
+using QtNodes::FlowView;
+using QtNodes::Node;
+using QtNodes::Connection;
+using QtNodes::NodeSpatialIndex;
+using QtNodes::BinaryEncoding;
+using QtNodes::BinaryCursor;
+using QtNodes::BinarySceneReader;
+using QtNodes::PortType;
+using QtNodes::PortIndex;
+using QtNodes::SceneHistory;
+
+// The layout, all numbers little endian:
+//
+//   header        "NEDX", format version, payload encoding
+//   node records  position as two doubles, model name string,
+//                 length prefixed payload
+//   connections   the BinaryEncoding::appendConnection() layout
+//   adjacency     the offsets of the connection records of every node,
+//                 as 64 bit integers grouped by node
+//   node table    one entry per node sorted by the uuid bytes: uuid,
+//                 64 bit record offset, scene rect as four doubles,
+//                 32 bit first adjacency and adjacency count
+//   bucket table  one entry per non empty grid cell sorted by cell key:
+//                 64 bit key, 32 bit first member and member count
+//   members       the node table indices of the buckets, 32 bit each
+//   trailer       the offsets of the adjacency, node table, bucket table
+//                 and members, the cell size and the largest node width
+//                 and height, the node, bucket and connection counts,
+//                 "NEDX"
+//
+// As in NodeSpatialIndex, a node is filed in the cell holding the top
+// left corner of its rect.
+
+namespace
+{
+
+quint8 const FormatVersion = 1;
+
+qint64 const HeaderSize      = 6;
+qint64 const NodeEntrySize   = 64;
+qint64 const BucketEntrySize = 16;
+qint64 const TrailerSize     = 4 * 8 + 3 * 8 + 3 * 4 + 4;
+
+QByteArray
+magic()
+{
+  return QByteArrayLiteral("NEDX");
+}
+
+
+/// Keeps the history off while in scope.
+class HistoryPause
+{
+public:
+
+  explicit
+  HistoryPause(SceneHistory& history)
+    : _history(history)
+    , _enabled(history.isEnabled())
+  {
+    _history.setEnabled(false);
+  }
+
+  ~HistoryPause()
+  {
+    _history.setEnabled(_enabled);
+  }
+
+private:
+
+  SceneHistory& _history;
+
+  bool const _enabled;
+};
+
+
+void
+appendFixed32(QByteArray &out, quint32 value)
+{
+  uchar bytes[sizeof(value)];
+  qToLittleEndian(value, bytes);
+
+  out.append(reinterpret_cast<char const*>(bytes), sizeof(bytes));
+}
+
+
+void
+appendFixed64(QByteArray &out, quint64 value)
+{
+  uchar bytes[sizeof(value)];
+  qToLittleEndian(value, bytes);
+
+  out.append(reinterpret_cast<char const*>(bytes), sizeof(bytes));
+}
+
+
+quint32
+readFixed32(uchar const *p)
+{
+  return qFromLittleEndian<quint32>(p);
+}
+
+
+qint64
+readFixed64(uchar const *p)
+{
+  return static_cast<qint64>(qFromLittleEndian<quint64>(p));
+}
+
+
+double
+readDouble(uchar const *p)
+{
+  quint64 const bits = qFromLittleEndian<quint64>(p);
+
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+
+  return value;
+}
+
+
+int
+cellCoordinate(double v, double cellSize)
+{
+  return static_cast<int>(std::floor(v / cellSize));
+}
+
+
+qint64
+cellKey(int x, int y)
+{
+  return static_cast<qint64>((static_cast<quint64>(static_cast<quint32>(x)) << 32) |
+                             static_cast<quint32>(y));
+}
+
+
+BinarySceneReader::ConnectionRecord
+readConnection(uchar const *data, qint64 recordsEnd, qint64 offset)
+{
+  if (offset < HeaderSize || offset >= recordsEnd)
+    throw std::logic_error("Indexed scene: bad connection record offset");
+
+  BinaryCursor cursor(data, recordsEnd, offset);
+
+  BinarySceneReader::ConnectionRecord r;
+
+  r.inId     = cursor.readUuid();
+  r.inIndex  = static_cast<PortIndex>(cursor.readVarint());
+  r.outId    = cursor.readUuid();
+  r.outIndex = static_cast<PortIndex>(cursor.readVarint());
+
+  r.hasConverter = (cursor.readByte() != 0);
+
+  if (r.hasConverter)
+  {
+    r.converterIn.id    = cursor.readString();
+    r.converterIn.name  = cursor.readString();
+    r.converterOut.id   = cursor.readString();
+    r.converterOut.name = cursor.readString();
+  }
+
+  return r;
+}
+
+
+struct NodeEntry
+{
+  QByteArray id;
+  Node const* node;
+  qint64 recordOffset;
+  std::vector<qint64> connections;
+};
+}
+
+
+IndexedSceneFile::
+IndexedSceneFile(FlowScene& scene, QObject* parent)
+  : QObject(parent)
+  , _scene(scene)
+  , _data(nullptr)
+  , _size(0)
+  , _payloadEncoding(0)
+  , _adjacencyOffset(0)
+  , _nodeTableOffset(0)
+  , _bucketTableOffset(0)
+  , _bucketMembersOffset(0)
+  , _cellSize(0.0)
+  , _maxWidth(0.0)
+  , _maxHeight(0.0)
+  , _nodeCount(0)
+  , _bucketCount(0)
+  , _connectionCount(0)
+{}
+
+
+IndexedSceneFile::
+~IndexedSceneFile()
+{
+  close();
+}
+
+
+bool
+IndexedSceneFile::
+write(FlowScene const& scene,
+      QString const& fileName,
+      double cellSize)
+{
+  Q_ASSERT(cellSize > 0.0);
+
+  QSaveFile file(fileName);
+
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+
+  qint64 offset = 0;
+
+  // a failed write makes commit() fail
+  auto put = [&](QByteArray const& bytes)
+  {
+    file.write(bytes);
+    offset += bytes.size();
+  };
+
+  std::vector<NodeEntry> entries;
+  entries.reserve(scene.nodes().size());
+
+  for (auto const & pair : scene.nodes())
+  {
+    NodeEntry entry;
+    entry.id           = pair.first.toRfc4122();
+    entry.node         = pair.second.get();
+    entry.recordOffset = 0;
+
+    entries.push_back(std::move(entry));
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](NodeEntry const& a, NodeEntry const& b)
+            {
+              return std::memcmp(a.id.constData(), b.id.constData(), 16) < 0;
+            });
+
+  std::unordered_map<QUuid, quint32> indices;
+
+  for (quint32 i = 0; i < entries.size(); ++i)
+    indices[entries[i].node->id()] = i;
+
+  QByteArray buffer = magic();
+  buffer.append(static_cast<char>(FormatVersion));
+  buffer.append(static_cast<char>(BinaryEncoding::payloadEncoding()));
+
+  put(buffer);
+
+  for (auto & entry : entries)
+  {
+    entry.recordOffset = offset;
+
+    QPointF const pos = entry.node->position();
+
+    buffer.clear();
+    BinaryEncoding::appendDouble(buffer, pos.x());
+    BinaryEncoding::appendDouble(buffer, pos.y());
+    BinaryEncoding::appendString(buffer, entry.node->nodeDataModel()->name());
+    BinaryEncoding::appendBytes(buffer,
+                                BinaryEncoding::encodePayload(entry.node->nodeDataModel()->save()));
+
+    put(buffer);
+  }
+
+  quint32 connectionCount = 0;
+
+  for (auto const & pair : scene.connections())
+  {
+    Connection const &connection = *pair.second;
+
+    Node const* nodeIn  = connection.getNode(PortType::In);
+    Node const* nodeOut = connection.getNode(PortType::Out);
+
+    if (!nodeIn || !nodeOut)
+      continue;
+
+    entries[indices[nodeIn->id()]].connections.push_back(offset);
+
+    if (nodeOut != nodeIn)
+      entries[indices[nodeOut->id()]].connections.push_back(offset);
+
+    buffer.clear();
+    BinaryEncoding::appendConnection(buffer, connection);
+
+    put(buffer);
+
+    ++connectionCount;
+  }
+
+  qint64 const adjacencyOffset = offset;
+
+  buffer.clear();
+
+  for (auto const & entry : entries)
+    for (qint64 connectionOffset : entry.connections)
+      appendFixed64(buffer, connectionOffset);
+
+  put(buffer);
+
+  qint64 const nodeTableOffset = offset;
+
+  double maxWidth  = 0.0;
+  double maxHeight = 0.0;
+
+  std::map<qint64, std::vector<quint32>> buckets;
+
+  quint32 adjacencyStart = 0;
+
+  buffer.clear();
+  buffer.reserve(int(entries.size() * NodeEntrySize));
+
+  for (quint32 i = 0; i < entries.size(); ++i)
+  {
+    NodeEntry const & entry = entries[i];
+
+    QRectF const r = NodeSpatialIndex::sceneRect(*entry.node);
+
+    quint32 const adjacencyCount = static_cast<quint32>(entry.connections.size());
+
+    buffer.append(entry.id);
+    appendFixed64(buffer, entry.recordOffset);
+    BinaryEncoding::appendDouble(buffer, r.x());
+    BinaryEncoding::appendDouble(buffer, r.y());
+    BinaryEncoding::appendDouble(buffer, r.width());
+    BinaryEncoding::appendDouble(buffer, r.height());
+    appendFixed32(buffer, adjacencyStart);
+    appendFixed32(buffer, adjacencyCount);
+
+    adjacencyStart += adjacencyCount;
+
+    maxWidth  = std::max(maxWidth, r.width());
+    maxHeight = std::max(maxHeight, r.height());
+
+    buckets[cellKey(cellCoordinate(r.left(), cellSize),
+                    cellCoordinate(r.top(), cellSize))].push_back(i);
+  }
+
+  put(buffer);
+
+  qint64 const bucketTableOffset = offset;
+
+  QByteArray members;
+  quint32 firstMember = 0;
+
+  buffer.clear();
+
+  for (auto const & bucket : buckets)
+  {
+    quint32 const memberCount = static_cast<quint32>(bucket.second.size());
+
+    appendFixed64(buffer, static_cast<quint64>(bucket.first));
+    appendFixed32(buffer, firstMember);
+    appendFixed32(buffer, memberCount);
+
+    for (quint32 index : bucket.second)
+      appendFixed32(members, index);
+
+    firstMember += memberCount;
+  }
+
+  put(buffer);
+
+  qint64 const bucketMembersOffset = offset;
+
+  put(members);
+
+  buffer.clear();
+  appendFixed64(buffer, adjacencyOffset);
+  appendFixed64(buffer, nodeTableOffset);
+  appendFixed64(buffer, bucketTableOffset);
+  appendFixed64(buffer, bucketMembersOffset);
+  BinaryEncoding::appendDouble(buffer, cellSize);
+  BinaryEncoding::appendDouble(buffer, maxWidth);
+  BinaryEncoding::appendDouble(buffer, maxHeight);
+  appendFixed32(buffer, static_cast<quint32>(entries.size()));
+  appendFixed32(buffer, static_cast<quint32>(buckets.size()));
+  appendFixed32(buffer, connectionCount);
+  buffer.append(magic());
+
+  put(buffer);
+
+  return file.commit();
+}
+
+
+bool
+IndexedSceneFile::
+open(QString const& fileName)
+{
+  close();
+
+  _file.setFileName(fileName);
+
+  if (!_file.open(QIODevice::ReadOnly))
+    return false;
+
+  _size = _file.size();
+
+  if (_size < HeaderSize + TrailerSize)
+  {
+    close();
+    return false;
+  }
+
+  _data = _file.map(0, _size);
+
+  QByteArray const expected = magic();
+
+  if (!_data ||
+      std::memcmp(_data, expected.constData(), 4) != 0 ||
+      std::memcmp(_data + _size - 4, expected.constData(), 4) != 0 ||
+      _data[4] != FormatVersion)
+  {
+    close();
+    return false;
+  }
+
+  _payloadEncoding = _data[5];
+
+  uchar const *trailer = _data + _size - TrailerSize;
+
+  _adjacencyOffset     = readFixed64(trailer);
+  _nodeTableOffset     = readFixed64(trailer + 8);
+  _bucketTableOffset   = readFixed64(trailer + 16);
+  _bucketMembersOffset = readFixed64(trailer + 24);
+  _cellSize            = readDouble(trailer + 32);
+  _maxWidth            = readDouble(trailer + 40);
+  _maxHeight           = readDouble(trailer + 48);
+  _nodeCount           = readFixed32(trailer + 56);
+  _bucketCount         = readFixed32(trailer + 60);
+  _connectionCount     = readFixed32(trailer + 64);
+
+  bool const valid =
+    _adjacencyOffset >= HeaderSize &&
+    _adjacencyOffset <= _nodeTableOffset &&
+    (_nodeTableOffset - _adjacencyOffset) % 8 == 0 &&
+    _nodeTableOffset + _nodeCount * NodeEntrySize == _bucketTableOffset &&
+    _bucketTableOffset + _bucketCount * BucketEntrySize == _bucketMembersOffset &&
+    _bucketMembersOffset + _nodeCount * qint64(4) == _size - TrailerSize &&
+    _cellSize > 0.0;
+
+  if (!valid)
+  {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+
+void
+IndexedSceneFile::
+close()
+{
+  if (_data)
+    _file.unmap(_data);
+
+  _file.close();
+
+  _data = nullptr;
+  _size = 0;
+
+  _nodeCount       = 0;
+  _bucketCount     = 0;
+  _connectionCount = 0;
+
+  _restoredNodes.clear();
+  _restoredConnections.clear();
+}
+
+
+bool
+IndexedSceneFile::
+isOpen() const
+{
+  return _data != nullptr;
+}
+
+
+std::size_t
+IndexedSceneFile::
+nodeCount() const
+{
+  return _nodeCount;
+}
+
+
+std::size_t
+IndexedSceneFile::
+connectionCount() const
+{
+  return _connectionCount;
+}
+
+
+std::size_t
+IndexedSceneFile::
+materializeRegion(QRectF const& sceneRect)
+{
+  QRectF const r = sceneRect.normalized();
+
+  if (!isOpen() || r.isEmpty() || _nodeCount == 0)
+    return 0;
+
+  // a node may start up to one extent left of or above the rect
+  int const x0 = cellCoordinate(r.left() - _maxWidth, _cellSize);
+  int const y0 = cellCoordinate(r.top() - _maxHeight, _cellSize);
+  int const x1 = cellCoordinate(r.right(), _cellSize);
+  int const y1 = cellCoordinate(r.bottom(), _cellSize);
+
+  std::vector<quint32> restored;
+
+  auto visit = [&](uchar const *entry)
+  {
+    quint32 const first = readFixed32(entry + 8);
+    quint32 const count = readFixed32(entry + 12);
+
+    if (qint64(first) + count > _nodeCount)
+      throw std::logic_error("Indexed scene: bad bucket");
+
+    uchar const *members = _data + _bucketMembersOffset + qint64(first) * 4;
+
+    for (quint32 k = 0; k < count; ++k)
+    {
+      quint32 const index = readFixed32(members + qint64(k) * 4);
+
+      if (index >= _nodeCount)
+        throw std::logic_error("Indexed scene: bad bucket member");
+
+      if (r.intersects(nodeRect(index)) && restoreNode(index))
+        restored.push_back(index);
+    }
+  };
+
+  // huge rects over a sparse grid are cheaper to answer bucket by bucket
+  double const cellCount = double(x1 - x0 + 1) * (y1 - y0 + 1);
+
+  if (cellCount > _bucketCount)
+  {
+    for (quint32 i = 0; i < _bucketCount; ++i)
+    {
+      uchar const *entry = bucket(i);
+
+      quint64 const key = static_cast<quint64>(readFixed64(entry));
+
+      int const x = static_cast<qint32>(static_cast<quint32>(key >> 32));
+      int const y = static_cast<qint32>(static_cast<quint32>(key));
+
+      if (x >= x0 && x <= x1 && y >= y0 && y <= y1)
+        visit(entry);
+    }
+  }
+  else
+  {
+    for (int x = x0; x <= x1; ++x)
+    {
+      for (int y = y0; y <= y1; ++y)
+      {
+        if (uchar const *entry = findBucket(cellKey(x, y)))
+          visit(entry);
+      }
+    }
+  }
+
+  restoreConnections(restored);
+
+  return restored.size();
+}
+
+
+Node*
+IndexedSceneFile::
+materializeNode(QUuid const& id)
+{
+  auto const & nodes = _scene.nodes();
+
+  auto it = nodes.find(id);
+
+  if (it != nodes.end())
+    return it->second.get();
+
+  if (!isOpen())
+    return nullptr;
+
+  qint64 const index = findNode(id);
+
+  if (index < 0 || !restoreNode(static_cast<quint32>(index)))
+    return nullptr;
+
+  restoreConnections({ static_cast<quint32>(index) });
+
+  return nodes.at(id).get();
+}
+
+
+std::size_t
+IndexedSceneFile::
+materializeSubgraph(QUuid const& id, int depth)
+{
+  if (!isOpen())
+    return 0;
+
+  qint64 const start = findNode(id);
+
+  if (start < 0)
+    return 0;
+
+  std::vector<quint32> restored;
+
+  std::unordered_set<quint32> visited { static_cast<quint32>(start) };
+  std::vector<quint32> frontier { static_cast<quint32>(start) };
+
+  for (int level = 0; !frontier.empty(); ++level)
+  {
+    std::vector<quint32> next;
+
+    for (quint32 index : frontier)
+    {
+      if (restoreNode(index))
+        restored.push_back(index);
+
+      if (level < depth)
+      {
+        for (quint32 neighbour : neighbours(index))
+          if (visited.insert(neighbour).second)
+            next.push_back(neighbour);
+      }
+    }
+
+    frontier.swap(next);
+  }
+
+  restoreConnections(restored);
+
+  return restored.size();
+}
+
+
+void
+IndexedSceneFile::
+followView(FlowView& view)
+{
+  // exceptions must not cross the event loop
+  auto materialize = [this](QRectF const& rect)
+  {
+    try
+    {
+      materializeRegion(rect);
+    }
+    catch (std::logic_error const& e)
+    {
+      qWarning() << "IndexedSceneFile:" << e.what();
+    }
+  };
+
+  connect(&view, &FlowView::visibleSceneRectChanged, this, materialize);
+
+  materialize(view.visibleSceneRect());
+}
+
+
+qint64
+IndexedSceneFile::
+findNode(QUuid const& id) const
+{
+  QByteArray const key = id.toRfc4122();
+
+  quint32 lo = 0;
+  quint32 hi = _nodeCount;
+
+  while (lo < hi)
+  {
+    quint32 const mid = lo + (hi - lo) / 2;
+
+    int const c = std::memcmp(nodeEntry(mid), key.constData(), 16);
+
+    if (c < 0)
+      lo = mid + 1;
+    else if (c > 0)
+      hi = mid;
+    else
+      return mid;
+  }
+
+  return -1;
+}
+
+
+QUuid
+IndexedSceneFile::
+nodeId(quint32 index) const
+{
+  return QUuid::fromRfc4122(
+    QByteArray::fromRawData(reinterpret_cast<char const*>(nodeEntry(index)), 16));
+}
+
+
+QRectF
+IndexedSceneFile::
+nodeRect(quint32 index) const
+{
+  uchar const *entry = nodeEntry(index);
+
+  return QRectF(readDouble(entry + 24), readDouble(entry + 32),
+                readDouble(entry + 40), readDouble(entry + 48));
+}
+
+
+bool
+IndexedSceneFile::
+restoreNode(quint32 index)
+{
+  if (!_restoredNodes.insert(index).second)
+    return false;
+
+  QUuid const id = nodeId(index);
+
+  // restored by other means, e.g. a previous load
+  if (_scene.nodes().count(id))
+    return false;
+
+  qint64 const offset = readFixed64(nodeEntry(index) + 16);
+
+  if (offset < HeaderSize || offset >= _adjacencyOffset)
+    throw std::logic_error("Indexed scene: bad node record offset");
+
+  BinaryCursor cursor(_data, _adjacencyOffset, offset);
+
+  double const x = cursor.readDouble();
+  double const y = cursor.readDouble();
+
+  QString const modelName = cursor.readString();
+
+  QJsonObject const modelJson =
+    BinaryEncoding::decodePayload(cursor.readBytes(), _payloadEncoding);
+
+  // paging the file in isn't a change to undo
+  HistoryPause pause(_scene.history());
+
+  _scene.restoreNode(id, modelName, QPointF(x, y), modelJson);
+
+  return true;
+}
+
+
+void
+IndexedSceneFile::
+restoreConnections(std::vector<quint32> const& nodes)
+{
+  auto const & sceneNodes = _scene.nodes();
+
+  HistoryPause pause(_scene.history());
+
+  for (quint32 index : nodes)
+  {
+    quint32 count = 0;
+    uchar const *offsets = adjacency(index, count);
+
+    for (quint32 k = 0; k < count; ++k)
+    {
+      qint64 const offset = readFixed64(offsets + qint64(k) * 8);
+
+      if (_restoredConnections.count(offset))
+        continue;
+
+      auto const r = readConnection(_data, _adjacencyOffset, offset);
+
+      // the other end isn't restored yet
+      if (!sceneNodes.count(r.inId) || !sceneNodes.count(r.outId))
+        continue;
+
+      _scene.restoreConnection(r.inId, r.inIndex,
+                               r.outId, r.outIndex,
+                               r.converterIn, r.converterOut);
+
+      _restoredConnections.insert(offset);
+    }
+  }
+}
+
+
+std::vector<quint32>
+IndexedSceneFile::
+neighbours(quint32 index) const
+{
+  std::vector<quint32> result;
+
+  QUuid const id = nodeId(index);
+
+  quint32 count = 0;
+  uchar const *offsets = adjacency(index, count);
+
+  for (quint32 k = 0; k < count; ++k)
+  {
+    auto const r = readConnection(_data, _adjacencyOffset,
+                                  readFixed64(offsets + qint64(k) * 8));
+
+    QUuid const & other = (r.inId == id) ? r.outId : r.inId;
+
+    if (other == id)
+      continue;
+
+    qint64 const otherIndex = findNode(other);
+
+    if (otherIndex >= 0)
+      result.push_back(static_cast<quint32>(otherIndex));
+  }
+
+  return result;
+}
+
+
+uchar const*
+IndexedSceneFile::
+nodeEntry(quint32 index) const
+{
+  return _data + _nodeTableOffset + qint64(index) * NodeEntrySize;
+}
+
+
+uchar const*
+IndexedSceneFile::
+adjacency(quint32 index, quint32& count) const
+{
+  uchar const *entry = nodeEntry(index);
+
+  quint32 const first = readFixed32(entry + 56);
+
+  count = readFixed32(entry + 60);
+
+  if (qint64(first) + count > (_nodeTableOffset - _adjacencyOffset) / 8)
+    throw std::logic_error("Indexed scene: bad adjacency");
+
+  return _data + _adjacencyOffset + qint64(first) * 8;
+}
+
+
+uchar const*
+IndexedSceneFile::
+findBucket(qint64 key) const
+{
+  quint32 lo = 0;
+  quint32 hi = _bucketCount;
+
+  while (lo < hi)
+  {
+    quint32 const mid = lo + (hi - lo) / 2;
+
+    uchar const *entry = bucket(mid);
+
+    qint64 const midKey = readFixed64(entry);
+
+    if (midKey < key)
+      lo = mid + 1;
+    else if (midKey > key)
+      hi = mid;
+    else
+      return entry;
+  }
+
+  return nullptr;
+}
+
+
+uchar const*
+IndexedSceneFile::
+bucket(quint32 index) const
+{
+  return _data + _bucketTableOffset + qint64(index) * BucketEntrySize;
+}
@@ -1,6 +1,7 @@
 #include "Node.hpp"
 
 #include <QtCore/QObject>
+#include <QtWidgets/QWidget>
 
 #include <utility>
 #include <iostream>
@@ -12,6 +13,7 @@
 
 #include "ConnectionGraphicsObject.hpp"
 #include "ConnectionState.hpp"
+#include "FastUuid.hpp"
 
 using QtNodes::Node;
 using QtNodes::NodeGeometry;
@@ -20,15 +22,17 @@ using QtNodes::NodeData;
 using QtNodes::NodeDataType;
 using QtNodes::NodeDataModel;
 using QtNodes::NodeGraphicsObject;
+using QtNodes::NodeStyle;
 using QtNodes::PortIndex;
 using QtNodes::PortType;
+using QtNodes::FastUuid;
 
 Node::
 Node(std::unique_ptr<NodeDataModel> && dataModel)
-  : _uid(QUuid::createUuid())
+  : _uid(FastUuid::create())
   , _nodeDataModel(std::move(dataModel))
   , _nodeState(_nodeDataModel)
-  , _nodeGeometry(_nodeDataModel)
+  , _nodeGeometry(_nodeDataModel, &_nodeState)
   , _nodeGraphicsObject(nullptr)
 {
   _nodeGeometry.recalculateSize();
@@ -43,7 +47,12 @@ Node(std::unique_ptr<NodeDataModel> && dataModel)
 
 
 Node::
-~Node() = default;
+~Node()
+{
+  // A graphics object owns the embedded widget, without one nobody does
+  if (!_nodeGraphicsObject)
+    delete _nodeDataModel->embeddedWidget();
+}
 
 QJsonObject
 Node::
@@ -51,13 +60,15 @@ save() const
 {
   QJsonObject nodeJson;
 
-  nodeJson["id"] = _uid.toString();
+  nodeJson["id"] = FastUuid::toString(_uid);
 
   nodeJson["model"] = _nodeDataModel->save();
 
+  QPointF const pos = position();
+
   QJsonObject obj;
-  obj["x"] = _nodeGraphicsObject->pos().x();
-  obj["y"] = _nodeGraphicsObject->pos().y();
+  obj["x"] = pos.x();
+  obj["y"] = pos.y();
   nodeJson["position"] = obj;
 
   return nodeJson;
@@ -68,14 +79,34 @@ void
 Node::
 restore(QJsonObject const& json)
 {
-  _uid = QUuid(json["id"].toString());
-
   QJsonObject positionJson = json["position"].toObject();
   QPointF     point(positionJson["x"].toDouble(),
                     positionJson["y"].toDouble());
-  _nodeGraphicsObject->setPos(point);
 
-  _nodeDataModel->restore(json["model"].toObject());
+  restore(FastUuid::fromString(json["id"].toString()), point, json["model"].toObject());
+}
+
+
+void
+Node::
+restore(QUuid const &id,
+        QPointF const &position,
+        QJsonObject const &modelJson)
+{
+  restore(id, position);
+
+  _nodeDataModel->restore(modelJson);
+}
+
+
+void
+Node::
+restore(QUuid const &id,
+        QPointF const &position)
+{
+  _uid = id;
+
+  setPosition(position);
 }
 
 
@@ -93,13 +124,12 @@ reactToPossibleConnection(PortType reactingPortType,
                           NodeDataType const &reactingDataType,
                           QPointF const &scenePoint)
 {
-  QTransform const t = _nodeGraphicsObject->sceneTransform();
-
-  QPointF p = t.inverted().map(scenePoint);
+  QPointF p = scenePoint - position();
 
   _nodeGeometry.setDraggingPosition(p);
 
-  _nodeGraphicsObject->update();
+  if (_nodeGraphicsObject)
+    _nodeGraphicsObject->update();
 
   _nodeState.setReaction(NodeState::REACTING,
                          reactingPortType,
@@ -112,7 +142,9 @@ Node::
 resetReactionToConnection()
 {
   _nodeState.setReaction(NodeState::NOT_REACTING);
-  _nodeGraphicsObject->update();
+
+  if (_nodeGraphicsObject)
+    _nodeGraphicsObject->update();
 }
 
 
@@ -120,7 +152,8 @@ NodeGraphicsObject const &
 Node::
 nodeGraphicsObject() const
 {
-  return *_nodeGraphicsObject.get();
+  // creating the graphics object does not change the node itself
+  return const_cast<Node*>(this)->nodeGraphicsObject();
 }
 
 
@@ -128,6 +161,9 @@ NodeGraphicsObject &
 Node::
 nodeGraphicsObject()
 {
+  if (!_nodeGraphicsObject && _graphicsObjectFactory)
+    setGraphicsObject(_graphicsObjectFactory(*this));
+
   return *_nodeGraphicsObject.get();
 }
 
@@ -139,6 +175,77 @@ setGraphicsObject(std::unique_ptr<NodeGraphicsObject>&& graphics)
   _nodeGraphicsObject = std::move(graphics);
 
   _nodeGeometry.recalculateSize();
+
+  // the connections of a visible node are visible too
+  for (PortType portType: {PortType::In, PortType::Out})
+  {
+    for (auto const & connections : _nodeState.getEntries(portType))
+    {
+      for (auto const & pair : connections)
+        pair.second->getConnectionGraphicsObject();
+    }
+  }
+}
+
+
+void
+Node::
+setGraphicsObjectFactory(GraphicsObjectFactory factory)
+{
+  _graphicsObjectFactory = std::move(factory);
+}
+
+
+void
+Node::
+setSizeChangedCallback(SizeChangedCallback callback)
+{
+  _sizeChangedCallback = std::move(callback);
+}
+
+
+bool
+Node::
+hasGraphicsObject() const
+{
+  return _nodeGraphicsObject != nullptr;
+}
+
+
+void
+Node::
+releaseGraphicsObject()
+{
+  if (!_nodeGraphicsObject)
+    return;
+
+  _position = _nodeGraphicsObject->pos();
+
+  // the widget is embedded again by the next graphics object
+  _nodeGraphicsObject->detachEmbeddedWidget();
+
+  _nodeGraphicsObject.reset();
+}
+
+
+QPointF
+Node::
+position() const
+{
+  return _nodeGraphicsObject ? _nodeGraphicsObject->pos() : _position;
+}
+
+
+void
+Node::
+setPosition(QPointF const& position)
+{
+  _position = position;
+
+  if (_nodeGraphicsObject)
+    _nodeGraphicsObject->setPos(position);
+
+  Q_EMIT positionChanged();
 }
 
 
@@ -182,6 +289,25 @@ nodeDataModel() const
 }
 
 
+std::size_t
+Node::
+footprint() const
+{
+  std::size_t bytes = sizeof(Node);
+
+  bytes += _nodeState.footprint();
+  bytes += _nodeGeometry.footprint();
+
+  auto const &style = _nodeDataModel->sharedNodeStyle();
+  bytes += sizeof(NodeStyle) / style.use_count();
+
+  if (_nodeGraphicsObject)
+    bytes += sizeof(NodeGraphicsObject);
+
+  return bytes;
+}
+
+
 void
 Node::
 propagateData(std::shared_ptr<NodeData> nodeData,
@@ -190,10 +316,22 @@ propagateData(std::shared_ptr<NodeData> nodeData,
   _nodeDataModel->setInData(std::move(nodeData), inPortIndex);
 
   //Recalculate the nodes visuals. A data change can result in the node taking more space than before, so this forces a recalculate+repaint on the affected node
-  _nodeGraphicsObject->setGeometryChanged();
+  if (_nodeGraphicsObject)
+    _nodeGraphicsObject->setGeometryChanged();
+
+  // the model may name its ports after the data
+  _nodeGeometry.invalidatePortWidths();
   _nodeGeometry.recalculateSize();
-  _nodeGraphicsObject->update();
-  _nodeGraphicsObject->moveConnections();
+
+  if (_nodeGraphicsObject)
+  {
+    _nodeGraphicsObject->update();
+    _nodeGraphicsObject->widgetChanged();
+  }
+
+  // the indexes and the connections follow the new size
+  if (_sizeChangedCallback)
+    _sizeChangedCallback(*this);
 }
 
 
@@ -201,6 +339,9 @@ void
 Node::
 onDataUpdated(PortIndex index)
 {
+  if (!_dataForwarding)
+    return;
+
   auto nodeData = _nodeDataModel->outData(index);
 
   auto connections =
@@ -219,15 +360,8 @@ onNodeSizeUpdated()
         nodeDataModel()->embeddedWidget()->adjustSize();
     }
     nodeGeometry().recalculateSize();
-    for(PortType type: {PortType::In, PortType::Out})
-    {
-        for(auto& conn_set : nodeState().getEntries(type))
-        {
-            for(auto& pair: conn_set)
-            {
-                Connection* conn = pair.second;
-                conn->getConnectionGraphicsObject().move();
-            }
-        }
-    }
+    if (hasGraphicsObject())
+        nodeGraphicsObject().widgetChanged();
+    if (_sizeChangedCallback)
+        _sizeChangedCallback(*this);
 }
@@ -149,7 +149,7 @@ disconnect(PortType portToDisconnect) const
   NodeState &state = _node->nodeState();
 
   // clear pointer to Connection in the NodeState
-  state.getEntries(portToDisconnect)[portIndex].clear();
+  state.clearConnections(portToDisconnect, portIndex);
 
   // 4) Propagate invalid data to IN node
   _connection->propagateEmptyData();
@@ -7,7 +7,7 @@ using QtNodes::NodeStyle;
 
 NodeDataModel::
 NodeDataModel()
-  : _nodeStyle(StyleCollection::nodeStyle())
+  : _nodeStyle(StyleCollection::sharedNodeStyle())
 {
   // Derived classes can initialize specific style here
 }
@@ -29,7 +29,7 @@ NodeStyle const&
 NodeDataModel::
 nodeStyle() const
 {
-  return _nodeStyle;
+  return *_nodeStyle;
 }
 
 
@@ -37,5 +37,21 @@ void
 NodeDataModel::
 setNodeStyle(NodeStyle const& style)
 {
-  _nodeStyle = style;
+  _nodeStyle = std::make_shared<NodeStyle const>(style);
+}
+
+
+void
+NodeDataModel::
+setNodeStyle(std::shared_ptr<NodeStyle const> style)
+{
+  _nodeStyle = std::move(style);
+}
+
+
+std::shared_ptr<NodeStyle const> const&
+NodeDataModel::
+sharedNodeStyle() const
+{
+  return _nodeStyle;
 }
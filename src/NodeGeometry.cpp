@@ -2,6 +2,12 @@
 
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <iterator>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QHash>
+#include <QtCore/QThread>
 
 #include "PortType.hpp"
 #include "NodeState.hpp"
@@ -10,33 +16,82 @@
 #include "NodeGraphicsObject.hpp"
 
 #include "StyleCollection.hpp"
+#include "TextLayoutCache.hpp"
 
 using QtNodes::NodeGeometry;
 using QtNodes::NodeDataModel;
 using QtNodes::PortIndex;
 using QtNodes::PortType;
 using QtNodes::Node;
+using QtNodes::TextLayoutCache;
+
+struct NodeGeometry::Fonts
+{
+  Fonts(QFont const &f)
+    : font(f)
+    , boldFont(f)
+  {
+    boldFont.setBold(true);
+
+    height = QFontMetrics(font).height();
+  }
+
+  QFont font;
+  QFont boldFont;
+
+  unsigned int height;
+};
+
+
+std::shared_ptr<NodeGeometry::Fonts const>
+NodeGeometry::
+sharedFonts(QFont const &font)
+{
+  // the registry isn't locked; models restored on worker threads get
+  // their node and geometry on the scene's thread
+  Q_ASSERT(QThread::currentThread() == QCoreApplication::instance()->thread());
+
+  static QHash<QFont, std::weak_ptr<Fonts const>> registry;
+
+  if (auto fonts = registry.value(font).lock())
+    return fonts;
+
+  for (auto it = registry.begin(); it != registry.end();)
+  {
+    if (it.value().expired())
+      it = registry.erase(it);
+    else
+      ++it;
+  }
+
+  auto fonts = std::make_shared<Fonts const>(font);
+
+  registry.insert(font, fonts);
+
+  return fonts;
+}
+
 
 NodeGeometry::
-NodeGeometry(std::unique_ptr<NodeDataModel> const &dataModel)
+NodeGeometry(std::unique_ptr<NodeDataModel> const &dataModel,
+             NodeState const *nodeState)
   : _width(100)
   , _height(150)
   , _inputPortWidth(70)
   , _outputPortWidth(70)
+  , _portWidthsValid(false)
   , _entryHeight(20)
   , _spacing(20)
   , _hovered(false)
   , _nSources(dataModel->nPorts(PortType::Out))
   , _nSinks(dataModel->nPorts(PortType::In))
+  , _maxPortRows(32)
+  , _firstVisiblePort(0)
   , _draggingPos(-1000, -1000)
   , _dataModel(dataModel)
-  , _fontMetrics(QFont())
-  , _boldFontMetrics(QFont())
-{
-  QFont f; f.setBold(true);
-
-  _boldFontMetrics = QFontMetrics(f);
-}
+  , _nodeState(nodeState)
+  , _fonts(sharedFonts(QFont()))
+{}
 
 unsigned int
 NodeGeometry::nSources() const
@@ -82,12 +137,13 @@ void
 NodeGeometry::
 recalculateSize() const
 {
-  _entryHeight = _fontMetrics.height();
+  _entryHeight = _fonts->height;
+
+  clampFirstVisiblePort();
 
   {
-    unsigned int maxNumOfEntries = std::max(_nSinks, _nSources);
     unsigned int step = _entryHeight + _spacing;
-    _height = step * maxNumOfEntries;
+    _height = step * portRows();
   }
 
   if (auto w = _dataModel->embeddedWidget())
@@ -97,8 +153,15 @@ recalculateSize() const
 
   _height += captionHeight();
 
-  _inputPortWidth  = portWidth(PortType::In);
-  _outputPortWidth = portWidth(PortType::Out);
+  // measuring each caption is the costly part, scrolling and
+  // resizing the widget keep the widths
+  if (!_portWidthsValid)
+  {
+    _inputPortWidth  = portWidth(PortType::In);
+    _outputPortWidth = portWidth(PortType::Out);
+
+    _portWidthsValid = true;
+  }
 
   _width = _inputPortWidth +
            _outputPortWidth +
@@ -123,20 +186,24 @@ void
 NodeGeometry::
 recalculateSize(QFont const & font) const
 {
-  QFontMetrics fontMetrics(font);
-  QFont boldFont = font;
+  // Called on every paint; comparing fonts is much cheaper
+  // than building two QFontMetrics objects.
+  if (font == _fonts->font)
+    return;
 
-  boldFont.setBold(true);
+  _fonts = sharedFonts(font);
 
-  QFontMetrics boldFontMetrics(boldFont);
+  _portWidthsValid = false;
 
-  if (_boldFontMetrics != boldFontMetrics)
-  {
-    _fontMetrics     = fontMetrics;
-    _boldFontMetrics = boldFontMetrics;
+  recalculateSize();
+}
 
-    recalculateSize();
-  }
+
+void
+NodeGeometry::
+invalidatePortWidths() const
+{
+  _portWidthsValid = false;
 }
 
 
@@ -156,10 +223,19 @@ portScenePosition(PortIndex index,
 
   totalHeight += captionHeight();
 
-  totalHeight += step * index;
+  totalHeight += step * portRow(index, portType);
 
-  // TODO: why?
-  totalHeight += step / 2.0;
+  bool const shown =
+    !portsVirtualized() ||
+    (index >= _firstVisiblePort &&
+     index < _firstVisiblePort + static_cast<PortIndex>(_maxPortRows)) ||
+    connectedPorts(portType, index, index + 1) != 0;
+
+  if (shown)
+  {
+    // TODO: why?
+    totalHeight += step / 2.0;
+  }
 
   switch (portType)
   {
@@ -202,9 +278,7 @@ checkHitScenePoint(PortType portType,
 
   double const tolerance = 2.0 * nodeStyle.ConnectionPointDiameter;
 
-  unsigned int const nItems = _dataModel->nPorts(portType);
-
-  for (unsigned int i = 0; i < nItems; ++i)
+  for (PortIndex i : visiblePorts(portType))
   {
     auto pp = portScenePosition(i, portType, sceneTransform);
 
@@ -222,6 +296,130 @@ checkHitScenePoint(PortType portType,
 }
 
 
+void
+NodeGeometry::
+setMaxPortRows(unsigned int rows)
+{
+  _maxPortRows = rows;
+}
+
+
+unsigned int
+NodeGeometry::
+portRows() const
+{
+  if (!portsVirtualized())
+    return totalPortRows();
+
+  auto rows = [this](PortType portType)
+  {
+    PortIndex const nPorts = _dataModel->nPorts(portType);
+
+    return windowPorts(portType) +
+           connectedPorts(portType, 0, _firstVisiblePort) +
+           connectedPorts(portType,
+                          _firstVisiblePort + static_cast<PortIndex>(_maxPortRows),
+                          nPorts);
+  };
+
+  return std::max(rows(PortType::In), rows(PortType::Out));
+}
+
+
+bool
+NodeGeometry::
+portsVirtualized() const
+{
+  return _maxPortRows != 0 && totalPortRows() > _maxPortRows;
+}
+
+
+bool
+NodeGeometry::
+scrollPorts(int rows)
+{
+  PortIndex const old = _firstVisiblePort;
+
+  _firstVisiblePort += rows;
+
+  clampFirstVisiblePort();
+
+  if (_firstVisiblePort == old)
+    return false;
+
+  // the connected ports entering or leaving the window change the rows
+  recalculateSize();
+
+  return true;
+}
+
+
+bool
+NodeGeometry::
+ensurePortVisible(PortIndex index)
+{
+  PortIndex const rows = _maxPortRows;
+
+  if (!portsVirtualized())
+    return false;
+
+  if (index < _firstVisiblePort)
+    return scrollPorts(index - _firstVisiblePort);
+
+  if (index >= _firstVisiblePort + rows)
+    return scrollPorts(index - _firstVisiblePort - rows + 1);
+
+  return false;
+}
+
+
+std::vector<PortIndex>
+NodeGeometry::
+visiblePorts(PortType portType) const
+{
+  std::vector<PortIndex> result;
+
+  PortIndex const nPorts = _dataModel->nPorts(portType);
+
+  if (!portsVirtualized())
+  {
+    result.reserve(nPorts);
+
+    for (PortIndex i = 0; i < nPorts; ++i)
+      result.push_back(i);
+
+    return result;
+  }
+
+  PortIndex const first = std::min(_firstVisiblePort, nPorts);
+  PortIndex const last  =
+    std::min(nPorts, _firstVisiblePort + static_cast<PortIndex>(_maxPortRows));
+
+  result.reserve(last - first);
+
+  auto addConnected = [&](PortIndex from, PortIndex to)
+  {
+    if (!_nodeState)
+      return;
+
+    auto const &entries = _nodeState->getEntries(portType).entries();
+
+    for (auto it = entries.lower_bound(from);
+         it != entries.end() && it->first < to; ++it)
+      result.push_back(it->first);
+  };
+
+  addConnected(0, first);
+
+  for (PortIndex i = first; i < last; ++i)
+    result.push_back(i);
+
+  addConnected(last, nPorts);
+
+  return result;
+}
+
+
 QRect
 NodeGeometry::
 resizeRect() const
@@ -244,17 +442,17 @@ widgetPosition() const
     if (w->sizePolicy().verticalPolicy() & QSizePolicy::ExpandFlag)
     {
       // If the widget wants to use as much vertical space as possible, place it immediately after the caption.
-      return QPointF(_spacing + portWidth(PortType::In), captionHeight());
+      return QPointF(_spacing + _inputPortWidth, captionHeight());
     }
     else
     {
       if (_dataModel->validationState() != NodeValidationState::Valid)
       {
-        return QPointF(_spacing + portWidth(PortType::In),
+        return QPointF(_spacing + _inputPortWidth,
                       (captionHeight() + _height - validationHeight() - _spacing - w->height()) / 2.0);
       }
 
-      return QPointF(_spacing + portWidth(PortType::In), 
+      return QPointF(_spacing + _inputPortWidth, 
                     (captionHeight() + _height - w->height()) / 2.0);
     }
   }
@@ -282,7 +480,7 @@ captionHeight() const
 
   QString name = _dataModel->caption();
 
-  return _boldFontMetrics.boundingRect(name).height();
+  return TextLayoutCache::layout(_fonts->boldFont, name).boundingRect.height();
 }
 
 
@@ -295,7 +493,7 @@ captionWidth() const
 
   QString name = _dataModel->caption();
 
-  return _boldFontMetrics.boundingRect(name).width();
+  return TextLayoutCache::layout(_fonts->boldFont, name).boundingRect.width();
 }
 
 
@@ -305,7 +503,7 @@ validationHeight() const
 {
   QString msg = _dataModel->validationMessage();
 
-  return _boldFontMetrics.boundingRect(msg).height();
+  return TextLayoutCache::layout(_fonts->boldFont, msg).boundingRect.height();
 }
 
 
@@ -315,7 +513,15 @@ validationWidth() const
 {
   QString msg = _dataModel->validationMessage();
 
-  return _boldFontMetrics.boundingRect(msg).width();
+  return TextLayoutCache::layout(_fonts->boldFont, msg).boundingRect.width();
+}
+
+
+std::size_t
+NodeGeometry::
+footprint() const
+{
+  return sizeof(Fonts) / _fonts.use_count();
 }
 
 
@@ -329,14 +535,81 @@ calculateNodePositionBetweenNodePorts(PortIndex targetPortIndex, PortType target
   //The first line calculates the halfway point between the ports (node position + port position on the node for both nodes averaged).
   //The second line offsets this coordinate with the size of the new node, so that the new nodes center falls on the originally
   //calculated coordinate, instead of it's upper left corner.
-  auto converterNodePos = (sourceNode->nodeGraphicsObject().pos() + sourceNode->nodeGeometry().portScenePosition(sourcePortIndex, sourcePort) +
-    targetNode->nodeGraphicsObject().pos() + targetNode->nodeGeometry().portScenePosition(targetPortIndex, targetPort)) / 2.0f;
+  auto converterNodePos = (sourceNode->position() + sourceNode->nodeGeometry().portScenePosition(sourcePortIndex, sourcePort) +
+    targetNode->position() + targetNode->nodeGeometry().portScenePosition(targetPortIndex, targetPort)) / 2.0f;
   converterNodePos.setX(converterNodePos.x() - newNode.nodeGeometry().width() / 2.0f);
   converterNodePos.setY(converterNodePos.y() - newNode.nodeGeometry().height() / 2.0f);
   return converterNodePos;
 }
 
 
+unsigned int
+NodeGeometry::
+totalPortRows() const
+{
+  return std::max(_nSinks, _nSources);
+}
+
+
+void
+NodeGeometry::
+clampFirstVisiblePort() const
+{
+  int const last = portsVirtualized() ?
+                   static_cast<int>(totalPortRows() - _maxPortRows) : 0;
+
+  _firstVisiblePort = std::max(0, std::min(last, _firstVisiblePort));
+}
+
+
+unsigned int
+NodeGeometry::
+windowPorts(PortType portType) const
+{
+  int const nPorts = _dataModel->nPorts(portType);
+
+  return std::max(0, std::min(nPorts - _firstVisiblePort,
+                              static_cast<int>(_maxPortRows)));
+}
+
+
+unsigned int
+NodeGeometry::
+connectedPorts(PortType portType, PortIndex first, PortIndex last) const
+{
+  if (!_nodeState || first >= last)
+    return 0;
+
+  auto const &entries = _nodeState->getEntries(portType).entries();
+
+  return static_cast<unsigned int>(std::distance(entries.lower_bound(first),
+                                                 entries.lower_bound(last)));
+}
+
+
+unsigned int
+NodeGeometry::
+portRow(PortIndex index, PortType portType) const
+{
+  if (!portsVirtualized())
+    return index;
+
+  PortIndex const first = _firstVisiblePort;
+  PortIndex const last  = first + static_cast<PortIndex>(_maxPortRows);
+
+  // the connected ports above the window, the window, then the
+  // connected ports below it
+  unsigned int row = connectedPorts(portType, 0, std::min(index, first));
+
+  row += std::max(0, std::min(index, last) - first);
+
+  if (index > last)
+    row += connectedPorts(portType, last, index);
+
+  return row;
+}
+
+
 unsigned int
 NodeGeometry::
 portWidth(PortType portType) const
@@ -356,7 +629,7 @@ portWidth(PortType portType) const
       name = _dataModel->dataType(portType, i).name;
     }
 
-    width = std::max(unsigned(_fontMetrics.width(name)),
+    width = std::max(unsigned(TextLayoutCache::layout(_fonts->font, name).advance),
                      width);
   }
 
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
 
 #include <QtWidgets/QtWidgets>
 #include <QtWidgets/QGraphicsEffect>
@@ -21,6 +22,14 @@
 using QtNodes::NodeGraphicsObject;
 using QtNodes::Node;
 using QtNodes::FlowScene;
+using QtNodes::NodeDataModel;
+
+namespace
+{
+// Below this zoom level an embedded widget is too small to be used,
+// hovering its node keeps showing the snapshot.
+constexpr double MinInteractiveLevelOfDetail = 0.5;
+}
 
 NodeGraphicsObject::
 NodeGraphicsObject(FlowScene &scene,
@@ -29,7 +38,12 @@ NodeGraphicsObject(FlowScene &scene,
   , _node(node)
   , _locked(false)
   , _proxyWidget(nullptr)
+  , _widgetSnapshotDirty(true)
+  , _widgetDetached(false)
 {
+  // positioned before any change notification is enabled
+  setPos(node.position());
+
   _scene.addItem(this);
 
   setFlag(QGraphicsItem::ItemDoesntPropagateOpacityToChildren, true);
@@ -42,14 +56,8 @@ NodeGraphicsObject(FlowScene &scene,
 
   auto const &nodeStyle = node.nodeDataModel()->nodeStyle();
 
-  {
-    auto effect = new QGraphicsDropShadowEffect;
-    effect->setOffset(4, 4);
-    effect->setBlurRadius(20);
-    effect->setColor(nodeStyle.ShadowColor);
-
-    setGraphicsEffect(effect);
-  }
+  // The drop shadow is painted by NodePainter from a cached nine-patch;
+  // a QGraphicsDropShadowEffect would blur offscreen on every repaint.
 
   setOpacity(nodeStyle.Opacity);
 
@@ -59,18 +67,18 @@ NodeGraphicsObject(FlowScene &scene,
 
   embedQWidget();
 
-  // connect to the move signals to emit the move signals in FlowScene
-  auto onMoveSlot = [this] {
-    _scene.nodeMoved(_node, pos());
-  };
-  connect(this, &QGraphicsObject::xChanged, this, onMoveSlot);
-  connect(this, &QGraphicsObject::yChanged, this, onMoveSlot);
+  connect(node.nodeDataModel(), &NodeDataModel::dataUpdated,
+          this, [this] { widgetChanged(); });
 }
 
 
 NodeGraphicsObject::
 ~NodeGraphicsObject()
 {
+  // A released widget has no proxy to delete it
+  if (_proxyWidget == nullptr && !_widgetDetached)
+    delete _node.nodeDataModel()->embeddedWidget();
+
   _scene.removeItem(this);
 }
 
@@ -95,31 +103,188 @@ void
 NodeGraphicsObject::
 embedQWidget()
 {
+  auto w = _node.nodeDataModel()->embeddedWidget();
+
+  if (w == nullptr)
+    return;
+
+  if (!_scene.widgetSnapshots())
+  {
+    acquireProxyWidget();
+    return;
+  }
+
   NodeGeometry & geom = _node.nodeGeometry();
 
-  if (auto w = _node.nodeDataModel()->embeddedWidget())
+  // the size a proxy with a preferred width of 5 would give the widget
+  QSize size(5, w->sizeHint().height());
+
+  size = size.expandedTo(w->minimumSizeHint())
+             .expandedTo(w->minimumSize())
+             .boundedTo(w->maximumSize());
+
+  w->resize(size);
+
+  geom.recalculateSize();
+
+  if (w->sizePolicy().verticalPolicy() & QSizePolicy::ExpandFlag)
   {
-    _proxyWidget = new QGraphicsProxyWidget(this);
+    w->resize(w->width(),
+              std::max(w->height(), static_cast<int>(geom.equivalentWidgetHeight())));
+  }
+
+  widgetChanged();
+}
+
+
+void
+NodeGraphicsObject::
+acquireProxyWidget()
+{
+  auto w = _node.nodeDataModel()->embeddedWidget();
 
-    _proxyWidget->setWidget(w);
+  if (_proxyWidget != nullptr || w == nullptr)
+    return;
+
+  NodeGeometry & geom = _node.nodeGeometry();
+
+  _proxyWidget = new QGraphicsProxyWidget(this);
+
+  _proxyWidget->setWidget(w);
 
-    _proxyWidget->setPreferredWidth(5);
+  // shown again after a release
+  if (w->isHidden())
+    w->show();
 
-    geom.recalculateSize();
+  _proxyWidget->setPreferredWidth(5);
+
+  geom.recalculateSize();
+
+  if (w->sizePolicy().verticalPolicy() & QSizePolicy::ExpandFlag)
+  {
+    // If the widget wants to use as much vertical space as possible, set it to have the geom's equivalentWidgetHeight.
+    _proxyWidget->setMinimumHeight(geom.equivalentWidgetHeight());
+  }
 
-    if (w->sizePolicy().verticalPolicy() & QSizePolicy::ExpandFlag)
+  _proxyWidget->setPos(geom.widgetPosition());
+
+  update();
+
+  _proxyWidget->setOpacity(1.0);
+  _proxyWidget->setFlag(QGraphicsItem::ItemIgnoresParentOpacity);
+
+  // only the nodes with a live proxy listen to the focus changes
+  _proxyFocusConnection =
+    connect(&_scene, &QGraphicsScene::focusItemChanged,
+            this, [this](QGraphicsItem*, QGraphicsItem* oldFocusItem, Qt::FocusReason)
     {
-      // If the widget wants to use as much vertical space as possible, set it to have the geom's equivalentWidgetHeight.
-      _proxyWidget->setMinimumHeight(geom.equivalentWidgetHeight());
+      if (_proxyWidget != nullptr && oldFocusItem == _proxyWidget)
+        scheduleProxyRelease();
+    });
+}
+
+
+void
+NodeGraphicsObject::
+releaseProxyWidget()
+{
+  if (_proxyWidget == nullptr)
+    return;
+
+  disconnect(_proxyFocusConnection);
+
+  QWidget* w = _proxyWidget->widget();
+
+  // Unembedding a visible widget would turn it into a window
+  w->hide();
+
+  _proxyWidget->setWidget(nullptr);
+
+  delete _proxyWidget;
+  _proxyWidget = nullptr;
+
+  // the widget was possibly edited while it was live
+  widgetChanged();
+}
+
+
+void
+NodeGraphicsObject::
+scheduleProxyRelease()
+{
+  QTimer::singleShot(0, this, [this]
+  {
+    if (_scene.widgetSnapshots() &&
+        _proxyWidget != nullptr &&
+        !isUnderMouse() &&
+        !_proxyWidget->hasFocus())
+    {
+      releaseProxyWidget();
     }
+  });
+}
 
-    _proxyWidget->setPos(geom.widgetPosition());
 
+void
+NodeGraphicsObject::
+updateWidgetMode()
+{
+  if (_node.nodeDataModel()->embeddedWidget() == nullptr)
+    return;
+
+  if (!_scene.widgetSnapshots())
+    acquireProxyWidget();
+  else if (!isUnderMouse())
+    releaseProxyWidget();
+}
+
+
+void
+NodeGraphicsObject::
+widgetChanged()
+{
+  _widgetSnapshotDirty = true;
+
+  if (_proxyWidget == nullptr)
     update();
+}
+
+
+void
+NodeGraphicsObject::
+detachEmbeddedWidget()
+{
+  releaseProxyWidget();
+
+  _widgetDetached = true;
+}
+
+
+QPixmap const&
+NodeGraphicsObject::
+widgetSnapshot()
+{
+  if (_widgetSnapshotDirty)
+  {
+    QWidget* w = _node.nodeDataModel()->embeddedWidget();
+
+    // hidden widgets do not lay out their children on their own
+    if (w->layout())
+      w->layout()->activate();
+
+    qreal const dpr = qApp->devicePixelRatio();
 
-    _proxyWidget->setOpacity(1.0);
-    _proxyWidget->setFlag(QGraphicsItem::ItemIgnoresParentOpacity);
+    _widgetSnapshot = QPixmap(w->size() * dpr);
+    _widgetSnapshot.setDevicePixelRatio(dpr);
+    _widgetSnapshot.fill(Qt::transparent);
+
+    // no window background, like QGraphicsProxyWidget draws it
+    w->render(&_widgetSnapshot, QPoint(), QRegion(), QWidget::DrawChildren);
+
+    _widgetSnapshotDirty = false;
   }
+
+  return _widgetSnapshot;
 }
 
 
@@ -159,6 +324,14 @@ moveConnections() const
 }
 
 
+void
+NodeGraphicsObject::
+scheduleMoveConnections() const
+{
+  _scene.scheduleConnectionsUpdate(_node);
+}
+
+
 void
 NodeGraphicsObject::
 lock(bool locked)
@@ -180,6 +353,11 @@ paint(QPainter * painter,
   painter->setClipRect(option->exposedRect);
 
   NodePainter::paint(painter, _node, _scene);
+
+  if (_proxyWidget == nullptr && _node.nodeDataModel()->embeddedWidget())
+  {
+    painter->drawPixmap(_node.nodeGeometry().widgetPosition(), widgetSnapshot());
+  }
 }
 
 
@@ -187,9 +365,15 @@ QVariant
 NodeGraphicsObject::
 itemChange(GraphicsItemChange change, const QVariant &value)
 {
-  if (change == ItemPositionChange && scene())
+  // Dragging a selection moves every selected node on each mouse event;
+  // the connections and the move signals are coalesced by the scene.
+  if (change == ItemScenePositionHasChanged && scene())
+  {
+    _scene.scheduleNodeMoved(_node);
+  }
+  else if (change == ItemSelectedHasChanged)
   {
-    moveConnections();
+    _scene.nodeSelectionChanged(_node, value.toBool());
   }
 
   return QGraphicsItem::itemChange(change, value);
@@ -295,14 +479,21 @@ mouseMoveEvent(QGraphicsSceneMouseEvent * event)
 
       w->setFixedSize(oldSize);
 
-      _proxyWidget->setMinimumSize(oldSize);
-      _proxyWidget->setMaximumSize(oldSize);
-      _proxyWidget->setPos(geom.widgetPosition());
+      if (_proxyWidget != nullptr)
+      {
+        _proxyWidget->setMinimumSize(oldSize);
+        _proxyWidget->setMaximumSize(oldSize);
+        _proxyWidget->setPos(geom.widgetPosition());
+      }
+      else
+      {
+        widgetChanged();
+      }
 
       geom.recalculateSize();
       update();
 
-      moveConnections();
+      scheduleMoveConnections();
 
       event->accept();
     }
@@ -311,9 +502,6 @@ mouseMoveEvent(QGraphicsSceneMouseEvent * event)
   {
     QGraphicsObject::mouseMoveEvent(event);
 
-    if (event->lastPos() != event->pos())
-      moveConnections();
-
     event->ignore();
   }
 
@@ -336,7 +524,7 @@ mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
   QGraphicsObject::mouseReleaseEvent(event);
 
   // position connections precisely after fast node move
-  moveConnections();
+  _scene.flushPendingUpdates();
 }
 
 
@@ -358,6 +546,20 @@ hoverEnterEvent(QGraphicsSceneHoverEvent * event)
   // bring this node forward
   setZValue(1.0);
 
+  if (_scene.widgetSnapshots() && _proxyWidget == nullptr)
+  {
+    auto view = event->widget() ?
+                qobject_cast<QGraphicsView*>(event->widget()->parentWidget()) :
+                nullptr;
+
+    double const lod = view ?
+                       QStyleOptionGraphicsItem::levelOfDetailFromTransform(view->transform()) :
+                       1.0;
+
+    if (lod >= MinInteractiveLevelOfDetail)
+      acquireProxyWidget();
+  }
+
   _node.nodeGeometry().setHovered(true);
   update();
   _scene.nodeHovered(node(), event->screenPos());
@@ -371,6 +573,10 @@ hoverLeaveEvent(QGraphicsSceneHoverEvent * event)
 {
   _node.nodeGeometry().setHovered(false);
   update();
+
+  if (_scene.widgetSnapshots())
+    scheduleProxyRelease();
+
   _scene.nodeHoverLeft(node());
   event->accept();
 }
@@ -397,6 +603,41 @@ hoverMoveEvent(QGraphicsSceneHoverEvent * event)
 }
 
 
+void
+NodeGraphicsObject::
+wheelEvent(QGraphicsSceneWheelEvent* event)
+{
+  auto & geom = _node.nodeGeometry();
+
+  if (!geom.portsVirtualized() || event->orientation() != Qt::Vertical)
+  {
+    event->ignore();
+    return;
+  }
+
+  // three rows per notch of a usual mouse wheel
+  int const rows = -3 * event->delta() / 120;
+
+  if (rows == 0)
+  {
+    event->accept();
+    return;
+  }
+
+  // the rows of the connected ports change the height
+  prepareGeometryChange();
+
+  if (geom.scrollPorts(rows))
+  {
+    update();
+
+    scheduleMoveConnections();
+  }
+
+  event->accept();
+}
+
+
 void
 NodeGraphicsObject::
 mouseDoubleClickEvent(QGraphicsSceneMouseEvent* event)
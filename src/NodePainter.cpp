@@ -1,8 +1,12 @@
 #include "NodePainter.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 #include <QtCore/QMargins>
+#include <QtWidgets/QStyleOptionGraphicsItem>
+#include <QtWidgets/qdrawutil.h>
 
 #include "StyleCollection.hpp"
 #include "PortType.hpp"
@@ -12,6 +16,8 @@
 #include "NodeDataModel.hpp"
 #include "Node.hpp"
 #include "FlowScene.hpp"
+#include "TextLayoutCache.hpp"
+#include "PixmapCache.hpp"
 
 using QtNodes::NodePainter;
 using QtNodes::NodeGeometry;
@@ -20,6 +26,8 @@ using QtNodes::Node;
 using QtNodes::NodeState;
 using QtNodes::NodeDataModel;
 using QtNodes::FlowScene;
+using QtNodes::TextLayoutCache;
+using QtNodes::PixmapCache;
 
 void
 NodePainter::
@@ -38,6 +46,8 @@ paint(QPainter* painter,
   //--------------------------------------------
   NodeDataModel const * model = node.nodeDataModel();
 
+  drawShadow(painter, geom, model);
+
   drawNodeRect(painter, geom, model, graphicsObject);
 
   drawConnectionPoints(painter, geom, state, model, scene);
@@ -48,6 +58,8 @@ paint(QPainter* painter,
 
   drawEntryLabels(painter, geom, state, model);
 
+  drawPortScrollBar(painter, geom, model);
+
   drawResizeRect(painter, geom, model);
 
   drawValidationRect(painter, geom, model, graphicsObject);
@@ -60,6 +72,179 @@ paint(QPainter* painter,
 }
 
 
+namespace
+{
+
+int const ShadowBlurRadius = 20;
+
+QPointF const ShadowOffset(4.0, 4.0);
+
+// Below this zoom level the shadow is not worth painting
+double const ShadowMinLevelOfDetail = 0.4;
+
+/// Three box blur passes approximate a Gaussian blur of the alpha channel.
+void
+blurAlpha(QImage &image, int radius)
+{
+  int const w = image.width();
+  int const h = image.height();
+
+  std::vector<int> alpha(w * h);
+  std::vector<int> tmp(w * h);
+
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      alpha[y * w + x] = qAlpha(image.pixel(x, y));
+
+  auto pass = [&](std::vector<int> const &src, std::vector<int> &dst,
+                  int length, int lines, int step, int lineStep)
+  {
+    int const window = 2 * radius + 1;
+
+    for (int l = 0; l < lines; ++l)
+    {
+      int const base = l * lineStep;
+      int sum = 0;
+
+      for (int i = -radius; i <= radius; ++i)
+        if (i >= 0 && i < length)
+          sum += src[base + i * step];
+
+      for (int i = 0; i < length; ++i)
+      {
+        dst[base + i * step] = sum / window;
+
+        int const out = i - radius;
+        int const in  = i + radius + 1;
+
+        if (out >= 0)
+          sum -= src[base + out * step];
+
+        if (in < length)
+          sum += src[base + in * step];
+      }
+    }
+  };
+
+  for (int i = 0; i < 3; ++i)
+  {
+    pass(alpha, tmp, w, h, 1, w);
+    pass(tmp, alpha, h, w, w, 1);
+  }
+
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      image.setPixel(x, y, qRgba(0, 0, 0, alpha[y * w + x]));
+}
+
+
+/// The shadow of a rounded rect as a nine-patch: blurred corners and
+/// edges around a one pixel stretchable center. It is rendered once per
+/// (color, blur radius, corner radius, device pixel ratio) and fits any
+/// node size; `margin` is in scene units.
+QPixmap
+shadowNinePatch(QColor const &color,
+                int blurRadius,
+                int cornerRadius,
+                qreal devicePixelRatio,
+                int &margin)
+{
+  // outer blur + inner blur falloff + corner
+  margin = 2 * blurRadius + cornerRadius;
+
+  int const size = 2 * margin + 1;
+
+  QString const key = QStringLiteral("shadow_%1_%2_%3")
+                      .arg(color.rgba())
+                      .arg(blurRadius)
+                      .arg(cornerRadius);
+
+  // the nine-patch is stretched in scene units, at the pixel density
+  // of the device so that the blur stays smooth on high DPI screens
+  return PixmapCache::pixmap(key,
+                             QSize(size, size),
+                             devicePixelRatio,
+                             [&](QSize const& pixelSize)
+  {
+    QImage image(pixelSize, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    qreal const scale = qreal(pixelSize.width()) / size;
+
+    {
+      QPainter p(&image);
+      p.setRenderHint(QPainter::Antialiasing);
+      p.scale(scale, scale);
+      p.setPen(Qt::NoPen);
+      p.setBrush(Qt::black);
+      p.drawRoundedRect(QRectF(blurRadius, blurRadius,
+                               size - 2 * blurRadius, size - 2 * blurRadius),
+                        cornerRadius, cornerRadius);
+    }
+
+    blurAlpha(image, qRound(blurRadius * scale / 3.0));
+
+    {
+      QPainter p(&image);
+      p.setCompositionMode(QPainter::CompositionMode_SourceIn);
+      p.fillRect(image.rect(), color);
+    }
+
+    return image;
+  });
+}
+}
+
+
+void
+NodePainter::
+drawShadow(QPainter* painter,
+           NodeGeometry const& geom,
+           NodeDataModel const* model)
+{
+  double const lod =
+    QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+
+  if (lod < ShadowMinLevelOfDetail)
+    return;
+
+  NodeStyle const& nodeStyle = model->nodeStyle();
+
+  float diam = nodeStyle.ConnectionPointDiameter;
+
+  double const radius = 3.0;
+
+  int margin = 0;
+
+  QPixmap const pixmap = shadowNinePatch(nodeStyle.ShadowColor,
+                                         ShadowBlurRadius,
+                                         std::ceil(radius),
+                                         PixmapCache::devicePixelRatio(painter),
+                                         margin);
+
+  QRectF const boundary(-diam, -diam, 2.0 * diam + geom.width(), 2.0 * diam + geom.height());
+
+  QRect const target =
+    boundary.adjusted(-ShadowBlurRadius, -ShadowBlurRadius,
+                      ShadowBlurRadius, ShadowBlurRadius)
+    .translated(ShadowOffset)
+    .toAlignedRect();
+
+  // small nodes get proportionally thinner corners
+  int const targetMargin = std::min({margin, target.width() / 2, target.height() / 2});
+
+  // the source rect and margins are device independent, like the margin
+  int const size = 2 * margin + 1;
+
+  qDrawBorderPixmap(painter,
+                    target,
+                    QMargins(targetMargin, targetMargin, targetMargin, targetMargin),
+                    pixmap,
+                    QRect(0, 0, size, size),
+                    QMargins(margin, margin, margin, margin));
+}
+
+
 void
 NodePainter::
 drawNodeRect(QPainter* painter,
@@ -120,9 +305,7 @@ drawConnectionPoints(QPainter* painter,
 
   for(PortType portType: {PortType::Out, PortType::In})
   {
-    size_t n = state.getEntries(portType).size();
-
-    for (unsigned int i = 0; i < n; ++i)
+    for (PortIndex i : geom.visiblePorts(portType))
     {
       QPointF p = geom.portScenePosition(i, portType);
 
@@ -200,13 +383,18 @@ drawFilledConnectionPoints(QPainter * painter,
 
   for(PortType portType: {PortType::Out, PortType::In})
   {
-    size_t n = state.getEntries(portType).size();
+    auto const & entries = state.getEntries(portType);
 
-    for (size_t i = 0; i < n; ++i)
+    // only the connected ports own an entry, and they are always shown
+    for (auto it  = entries.entries().begin();
+              it != entries.entries().end();
+              ++it)
     {
+      PortIndex const i = it->first;
+
       QPointF p = geom.portScenePosition(i, portType);
 
-      if (!state.getEntries(portType)[i].empty())
+      if (!it->second.empty())
       {
         auto const & dataType = model->dataType(portType, i);
 
@@ -251,16 +439,16 @@ drawModelName(QPainter * painter,
 
   f.setBold(true);
 
-  QFontMetrics metrics(f);
+  auto const layout = TextLayoutCache::layout(f, name);
 
-  auto rect = metrics.boundingRect(name);
-
-  QPointF position((geom.width() - rect.width()) / 2.0,
+  // baseline position; static text is placed by its top left corner
+  QPointF position((geom.width() - layout.boundingRect.width()) / 2.0,
                    (geom.spacing() + geom.entryHeight()) / 3.0);
 
   painter->setFont(f);
   painter->setPen(nodeStyle.FontColor);
-  painter->drawText(position, name);
+  painter->drawStaticText(position - QPointF(0.0, layout.ascent),
+                          layout.staticText);
 
   f.setBold(false);
   painter->setFont(f);
@@ -274,8 +462,7 @@ drawEntryLabels(QPainter * painter,
                 NodeState const & state,
                 NodeDataModel const * model)
 {
-  QFontMetrics const & metrics =
-    painter->fontMetrics();
+  QFont const font = painter->font();
 
   for(PortType portType: {PortType::Out, PortType::In})
   {
@@ -283,9 +470,7 @@ drawEntryLabels(QPainter * painter,
 
     auto& entries = state.getEntries(portType);
 
-    size_t n = entries.size();
-
-    for (size_t i = 0; i < n; ++i)
+    for (PortIndex i : geom.visiblePorts(portType))
     {
       QPointF p = geom.portScenePosition(i, portType);
 
@@ -305,7 +490,9 @@ drawEntryLabels(QPainter * painter,
         s = model->dataType(portType, i).name;
       }
 
-      auto rect = metrics.boundingRect(s);
+      auto const layout = TextLayoutCache::layout(font, s);
+
+      auto const & rect = layout.boundingRect;
 
       p.setY(p.y() + rect.height() / 4.0);
 
@@ -323,12 +510,52 @@ drawEntryLabels(QPainter * painter,
         break;
       }
 
-      painter->drawText(p, s);
+      painter->drawStaticText(p - QPointF(0.0, layout.ascent),
+                              layout.staticText);
     }
   }
 }
 
 
+void
+NodePainter::
+drawPortScrollBar(QPainter * painter,
+                  NodeGeometry const & geom,
+                  NodeDataModel const * model)
+{
+  if (!geom.portsVirtualized())
+    return;
+
+  auto const &nodeStyle = model->nodeStyle();
+
+  unsigned int const step = geom.entryHeight() + geom.spacing();
+
+  double const rows  = geom.portRows();
+  double const total = std::max(model->nPorts(PortType::In),
+                                model->nPorts(PortType::Out));
+
+  // the side with the most ports always shows some in the window
+  PortType const side =
+    model->nPorts(PortType::In) >= model->nPorts(PortType::Out) ?
+    PortType::In : PortType::Out;
+
+  // the first shown port of a side takes the first row, centered half a
+  // step below the track top
+  double const trackTop =
+    geom.portScenePosition(geom.visiblePorts(side).front(), side).y() - step / 2.0;
+  double const trackHeight = rows * step;
+
+  QRectF const thumb(geom.width() - 4.0,
+                     trackTop + trackHeight * geom.firstVisiblePort() / total,
+                     2.0,
+                     std::max(4.0, trackHeight * geom.maxPortRows() / total));
+
+  painter->setPen(Qt::NoPen);
+  painter->setBrush(nodeStyle.FontColorFaded);
+  painter->drawRoundedRect(thumb, 1.0, 1.0);
+}
+
+
 void
 NodePainter::
 drawResizeRect(QPainter * painter,
@@ -400,15 +627,14 @@ drawValidationRect(QPainter * painter,
 
     QFont f = painter->font();
 
-    QFontMetrics metrics(f);
-
-    auto rect = metrics.boundingRect(errorMsg);
+    auto const layout = TextLayoutCache::layout(f, errorMsg);
 
-    QPointF position((geom.width() - rect.width()) / 2.0,
+    QPointF position((geom.width() - layout.boundingRect.width()) / 2.0,
                      geom.height() - (geom.validationHeight() - diam) / 2.0);
 
     painter->setFont(f);
     painter->setPen(nodeStyle.FontColor);
-    painter->drawText(position, errorMsg);
+    painter->drawStaticText(position - QPointF(0.0, layout.ascent),
+                            layout.staticText);
   }
 }
@@ -27,6 +27,12 @@ public:
         Node& node,
         FlowScene const& scene);
 
+  static
+  void
+  drawShadow(QPainter* painter,
+             NodeGeometry const& geom,
+             NodeDataModel const* model);
+
   static
   void
   drawNodeRect(QPainter* painter,
@@ -63,6 +69,13 @@ public:
                              NodeState const& state,
                              NodeDataModel const * model);
 
+  /// Shows the position of the port window of virtualized nodes.
+  static
+  void
+  drawPortScrollBar(QPainter* painter,
+                    NodeGeometry const& geom,
+                    NodeDataModel const* model);
+
   static
   void
   drawResizeRect(QPainter* painter,
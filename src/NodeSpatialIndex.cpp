@@ -0,0 +1,167 @@
+#include "NodeSpatialIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Node.hpp"
+#include "NodeGeometry.hpp"
+
+using QtNodes::NodeSpatialIndex;
+using QtNodes::Node;
+
+NodeSpatialIndex::
+NodeSpatialIndex(double cellSize)
+  : _cellSize(cellSize)
+{}
+
+
+void
+NodeSpatialIndex::
+update(Node &node)
+{
+  QRectF const r = sceneRect(node);
+
+  _maxExtent = _maxExtent.expandedTo(r.size());
+
+  qint64 const key = cellKey(cellCoordinate(r.left()),
+                             cellCoordinate(r.top()));
+
+  auto it = _nodeCells.find(&node);
+
+  if (it != _nodeCells.end())
+  {
+    if (it->second == key)
+      return;
+
+    remove(node);
+  }
+
+  _cells[key].push_back(&node);
+  _nodeCells[&node] = key;
+}
+
+
+void
+NodeSpatialIndex::
+remove(Node const &node)
+{
+  auto it = _nodeCells.find(&node);
+
+  if (it == _nodeCells.end())
+    return;
+
+  auto cell = _cells.find(it->second);
+
+  if (cell != _cells.end())
+  {
+    auto &nodes = cell->second;
+
+    nodes.erase(std::remove(nodes.begin(), nodes.end(), &node), nodes.end());
+
+    if (nodes.empty())
+      _cells.erase(cell);
+  }
+
+  _nodeCells.erase(it);
+}
+
+
+void
+NodeSpatialIndex::
+clear()
+{
+  _cells.clear();
+  _nodeCells.clear();
+  _maxExtent = QSizeF();
+}
+
+
+std::vector<Node*>
+NodeSpatialIndex::
+query(QRectF const &rect,
+      Qt::ItemSelectionMode mode) const
+{
+  std::vector<Node*> result;
+
+  QRectF const r = rect.normalized();
+
+  if (r.isEmpty() || _nodeCells.empty())
+    return result;
+
+  bool const contains = (mode == Qt::ContainsItemShape ||
+                         mode == Qt::ContainsItemBoundingRect);
+
+  // a node may start up to one extent left of or above the rect
+  int const x0 = cellCoordinate(r.left() - _maxExtent.width());
+  int const y0 = cellCoordinate(r.top() - _maxExtent.height());
+  int const x1 = cellCoordinate(r.right());
+  int const y1 = cellCoordinate(r.bottom());
+
+  auto visit = [&](std::vector<Node*> const &nodes)
+  {
+    for (Node* node : nodes)
+    {
+      QRectF const nodeRect = sceneRect(*node);
+
+      if (contains ? r.contains(nodeRect) : r.intersects(nodeRect))
+        result.push_back(node);
+    }
+  };
+
+  // huge rects over a sparse grid are cheaper to answer cell by cell
+  double const cellCount = double(x1 - x0 + 1) * (y1 - y0 + 1);
+
+  if (cellCount > _cells.size())
+  {
+    for (auto const & cell : _cells)
+    {
+      quint64 const key = static_cast<quint64>(cell.first);
+
+      int const x = static_cast<qint32>(static_cast<quint32>(key >> 32));
+      int const y = static_cast<qint32>(static_cast<quint32>(key));
+
+      if (x >= x0 && x <= x1 && y >= y0 && y <= y1)
+        visit(cell.second);
+    }
+
+    return result;
+  }
+
+  for (int y = y0; y <= y1; ++y)
+  {
+    for (int x = x0; x <= x1; ++x)
+    {
+      auto it = _cells.find(cellKey(x, y));
+
+      if (it != _cells.end())
+        visit(it->second);
+    }
+  }
+
+  return result;
+}
+
+
+QRectF
+NodeSpatialIndex::
+sceneRect(Node const &node)
+{
+  return node.nodeGeometry().boundingRect().translated(node.position());
+}
+
+
+qint64
+NodeSpatialIndex::
+cellKey(int x, int y) const
+{
+  return static_cast<qint64>((static_cast<quint64>(static_cast<quint32>(x)) << 32) |
+                             static_cast<quint32>(y));
+}
+
+
+int
+NodeSpatialIndex::
+cellCoordinate(double v) const
+{
+  return static_cast<int>(std::floor(v / _cellSize));
+}
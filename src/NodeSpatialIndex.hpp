@@ -0,0 +1,68 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include <QtCore/QRectF>
+#include <QtCore/QSizeF>
+#include <QtCore/QtGlobal>
+
+namespace QtNodes
+{
+
+class Node;
+
+/// Uniform grid over the nodes of a scene answering rect queries
+/// without visiting every node. A node is filed in the cell holding its
+/// top left corner and queries are grown by the largest node extent
+/// seen so far, so resizing a node never moves it to other cells.
+class NodeSpatialIndex
+{
+public:
+
+  explicit
+  NodeSpatialIndex(double cellSize = 256.0);
+
+public:
+
+  /// Files the node under its current position, moving it if needed.
+  void
+  update(Node &node);
+
+  void
+  remove(Node const &node);
+
+  void
+  clear();
+
+  /// The nodes whose bounding rect intersects the scene rect, or lies
+  /// within it for Qt::ContainsItemShape and Qt::ContainsItemBoundingRect.
+  std::vector<Node*>
+  query(QRectF const &sceneRect,
+        Qt::ItemSelectionMode mode = Qt::IntersectsItemShape) const;
+
+  /// The bounding rect of the node in scene coordinates.
+  static
+  QRectF
+  sceneRect(Node const &node);
+
+private:
+
+  qint64
+  cellKey(int x, int y) const;
+
+  int
+  cellCoordinate(double v) const;
+
+private:
+
+  double _cellSize;
+
+  std::unordered_map<qint64, std::vector<Node*>> _cells;
+
+  std::unordered_map<Node const*, qint64> _nodeCells;
+
+  // only grows: a node shrinking back leaves the queries a bit wider
+  QSizeF _maxExtent;
+};
+}
@@ -1,16 +1,124 @@
 #include "NodeState.hpp"
 
+#include <stdexcept>
+
 #include "NodeDataModel.hpp"
 
 #include "Connection.hpp"
 
 using QtNodes::NodeState;
+using QtNodes::PortConnections;
 using QtNodes::NodeDataType;
 using QtNodes::NodeDataModel;
 using QtNodes::PortType;
 using QtNodes::PortIndex;
 using QtNodes::Connection;
 
+PortConnections::
+PortConnections(std::size_t nPorts)
+  : _size(nPorts)
+{}
+
+
+void
+PortConnections::
+resize(std::size_t nPorts)
+{
+  _size = nPorts;
+
+  _entries.erase(_entries.lower_bound(static_cast<PortIndex>(nPorts)),
+                 _entries.end());
+}
+
+
+PortConnections::ConnectionPtrSet const&
+PortConnections::
+operator[](PortIndex portIndex) const
+{
+  static ConnectionPtrSet const empty;
+
+  auto it = _entries.find(portIndex);
+
+  return it != _entries.end() ? it->second : empty;
+}
+
+
+PortConnections::ConnectionPtrSet&
+PortConnections::
+operator[](PortIndex portIndex)
+{
+  return _entries[portIndex];
+}
+
+
+PortConnections::ConnectionPtrSet const&
+PortConnections::
+at(PortIndex portIndex) const
+{
+  if (portIndex < 0 || static_cast<std::size_t>(portIndex) >= _size)
+    throw std::out_of_range("PortConnections: invalid port index");
+
+  return (*this)[portIndex];
+}
+
+
+PortConnections::ConnectionPtrSet&
+PortConnections::
+at(PortIndex portIndex)
+{
+  if (portIndex < 0 || static_cast<std::size_t>(portIndex) >= _size)
+    throw std::out_of_range("PortConnections: invalid port index");
+
+  return (*this)[portIndex];
+}
+
+
+void
+PortConnections::
+erase(PortIndex portIndex, QUuid const &id)
+{
+  auto it = _entries.find(portIndex);
+
+  if (it == _entries.end())
+    return;
+
+  it->second.erase(id);
+
+  if (it->second.empty())
+    _entries.erase(it);
+}
+
+
+void
+PortConnections::
+clear(PortIndex portIndex)
+{
+  _entries.erase(portIndex);
+}
+
+
+std::size_t
+PortConnections::
+footprint() const
+{
+  // map nodes: key, value and three pointers plus the color
+  std::size_t bytes =
+    _entries.size() * (sizeof(Entries::value_type) + 4 * sizeof(void*));
+
+  for (auto const & entry : _entries)
+  {
+    auto const & connections = entry.second;
+
+    bytes += connections.bucket_count() * sizeof(void*);
+    bytes += connections.size() *
+             (sizeof(ConnectionPtrSet::value_type) + sizeof(void*));
+  }
+
+  return bytes;
+}
+
+//------------------------------------------------------------------------------
+
 NodeState::
 NodeState(std::unique_ptr<NodeDataModel> const &model)
   : _inConnections(model->nPorts(PortType::In))
@@ -21,7 +129,7 @@ NodeState(std::unique_ptr<NodeDataModel> const &model)
 {}
 
 
-std::vector<NodeState::ConnectionPtrSet> const &
+PortConnections const &
 NodeState::
 getEntries(PortType portType) const
 {
@@ -32,7 +140,7 @@ getEntries(PortType portType) const
 }
 
 
-std::vector<NodeState::ConnectionPtrSet> &
+PortConnections &
 NodeState::
 getEntries(PortType portType)
 {
@@ -72,7 +180,16 @@ eraseConnection(PortType portType,
                 PortIndex portIndex,
                 QUuid id)
 {
-  getEntries(portType)[portIndex].erase(id);
+  getEntries(portType).erase(portIndex, id);
+}
+
+
+void
+NodeState::
+clearConnections(PortType portType,
+                 PortIndex portIndex)
+{
+  getEntries(portType).clear(portIndex);
 }
 
 
@@ -136,3 +253,11 @@ resizing() const
 {
   return _resizing;
 }
+
+
+std::size_t
+NodeState::
+footprint() const
+{
+  return _inConnections.footprint() + _outConnections.footprint();
+}
@@ -0,0 +1,110 @@
+#include "PixmapCache.hpp"
+
+#include <cmath>
+#include <unordered_set>
+
+#include <QtGui/QIcon>
+#include <QtGui/QPainter>
+#include <QtGui/QPaintDevice>
+#include <QtGui/QPixmapCache>
+
+#include "QStringStdHash.hpp"
+
+using QtNodes::PixmapCache;
+
+namespace
+{
+
+/// QPixmapCache has no prefix removal, the keys are remembered
+/// to drop our entries only.
+std::unordered_set<QString>&
+cacheKeys()
+{
+  static std::unordered_set<QString> keys;
+
+  return keys;
+}
+
+
+QSize
+pixelSize(QSize const& size, qreal devicePixelRatio)
+{
+  return QSize(std::ceil(size.width() * devicePixelRatio),
+               std::ceil(size.height() * devicePixelRatio));
+}
+}
+
+
+QPixmap
+PixmapCache::
+icon(QString const& path,
+     QSize const& size,
+     qreal devicePixelRatio)
+{
+  return pixmap(QStringLiteral("icon_") + path,
+                size,
+                devicePixelRatio,
+                [&path](QSize const& pixelSize)
+                {
+                  // QIcon picks the best source size and scales it down,
+                  // it never scales small files up
+                  return QIcon(path).pixmap(pixelSize).toImage();
+                });
+}
+
+
+QPixmap
+PixmapCache::
+pixmap(QString const& key,
+       QSize const& size,
+       qreal devicePixelRatio,
+       Generator const& generator)
+{
+  QString const fullKey = QStringLiteral("nodeeditor_%1_%2x%3@%4")
+                          .arg(key)
+                          .arg(size.width())
+                          .arg(size.height())
+                          .arg(devicePixelRatio);
+
+  QPixmap result;
+
+  if (QPixmapCache::find(fullKey, &result))
+    return result;
+
+  result = QPixmap::fromImage(generator(pixelSize(size, devicePixelRatio)));
+  result.setDevicePixelRatio(devicePixelRatio);
+
+  QPixmapCache::insert(fullKey, result);
+
+  cacheKeys().insert(fullKey);
+
+  return result;
+}
+
+
+qreal
+PixmapCache::
+devicePixelRatio(QPainter const* painter)
+{
+  QPaintDevice const* device = painter ? painter->device() : nullptr;
+
+  if (!device)
+    return 1.0;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
+  return device->devicePixelRatioF();
+#else
+  return device->devicePixelRatio();
+#endif
+}
+
+
+void
+PixmapCache::
+clear()
+{
+  for (QString const& key : cacheKeys())
+    QPixmapCache::remove(key);
+
+  cacheKeys().clear();
+}
@@ -0,0 +1,211 @@
+#include "PngStreamWriter.hpp"
+
+#include <algorithm>
+#include <array>
+
+using QtNodes::PngStreamWriter;
+
+namespace
+{
+
+// largest payload of a stored deflate block
+int const MaxBlockSize = 65535;
+
+quint32 const AdlerModulo = 65521;
+
+std::array<quint32, 256> const &
+crcTable()
+{
+  static std::array<quint32, 256> const table = []
+  {
+    std::array<quint32, 256> t;
+
+    for (quint32 n = 0; n < 256; ++n)
+    {
+      quint32 c = n;
+
+      for (int k = 0; k < 8; ++k)
+        c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+
+      t[n] = c;
+    }
+
+    return t;
+  }();
+
+  return table;
+}
+
+
+quint32
+crc32(QByteArray const &data, quint32 crc = 0xFFFFFFFFu)
+{
+  auto const &table = crcTable();
+
+  for (char ch : data)
+    crc = table[(crc ^ static_cast<uchar>(ch)) & 0xFF] ^ (crc >> 8);
+
+  return crc;
+}
+
+
+void
+appendBigEndian(QByteArray &out, quint32 value)
+{
+  out.append(char((value >> 24) & 0xFF));
+  out.append(char((value >> 16) & 0xFF));
+  out.append(char((value >> 8) & 0xFF));
+  out.append(char(value & 0xFF));
+}
+
+}
+
+
+PngStreamWriter::
+PngStreamWriter(QIODevice &device, QSize size)
+  : _device(device)
+  , _size(size)
+  , _zlibHeaderWritten(false)
+  , _adlerA(1)
+  , _adlerB(0)
+  , _scanlinesWritten(0)
+{
+  _block.reserve(MaxBlockSize);
+}
+
+
+bool
+PngStreamWriter::
+begin()
+{
+  static char const signature[] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1A', '\n' };
+
+  if (_device.write(signature, sizeof(signature)) != qint64(sizeof(signature)))
+    return false;
+
+  QByteArray header;
+
+  appendBigEndian(header, quint32(_size.width()));
+  appendBigEndian(header, quint32(_size.height()));
+
+  header.append(char(8)); // bit depth
+  header.append(char(6)); // RGBA
+  header.append(char(0)); // deflate
+  header.append(char(0)); // adaptive filtering
+  header.append(char(0)); // no interlace
+
+  return writeChunk("IHDR", header);
+}
+
+
+bool
+PngStreamWriter::
+writeScanline(uchar const* rgba)
+{
+  // filter type "None"
+  char const filter = 0;
+  appendData(&filter, 1);
+
+  if (_block.size() == MaxBlockSize && !flushBlock(false))
+    return false;
+
+  int remaining = _size.width() * 4;
+  auto data = reinterpret_cast<char const*>(rgba);
+
+  while (remaining > 0)
+  {
+    int const n = std::min(remaining, MaxBlockSize - _block.size());
+
+    appendData(data, n);
+
+    data      += n;
+    remaining -= n;
+
+    if (_block.size() == MaxBlockSize && !flushBlock(false))
+      return false;
+  }
+
+  ++_scanlinesWritten;
+
+  return true;
+}
+
+
+bool
+PngStreamWriter::
+finish()
+{
+  if (_scanlinesWritten != _size.height())
+    return false;
+
+  if (!flushBlock(true))
+    return false;
+
+  return writeChunk("IEND", QByteArray());
+}
+
+
+bool
+PngStreamWriter::
+writeChunk(char const* type, QByteArray const &data)
+{
+  QByteArray chunk;
+  chunk.reserve(data.size() + 12);
+
+  appendBigEndian(chunk, quint32(data.size()));
+  chunk.append(type, 4);
+  chunk.append(data);
+
+  // the checksum covers the type and the data
+  appendBigEndian(chunk, crc32(chunk.mid(4)) ^ 0xFFFFFFFFu);
+
+  return _device.write(chunk) == chunk.size();
+}
+
+
+bool
+PngStreamWriter::
+flushBlock(bool final)
+{
+  QByteArray idat;
+  idat.reserve(_block.size() + 11);
+
+  if (!_zlibHeaderWritten)
+  {
+    // deflate, 32K window, no dictionary, fastest
+    idat.append(char(0x78));
+    idat.append(char(0x01));
+
+    _zlibHeaderWritten = true;
+  }
+
+  quint16 const length = quint16(_block.size());
+
+  idat.append(char(final ? 1 : 0));
+  idat.append(char(length & 0xFF));
+  idat.append(char(length >> 8));
+  idat.append(char(~length & 0xFF));
+  idat.append(char((~length >> 8) & 0xFF));
+  idat.append(_block);
+
+  if (final)
+    appendBigEndian(idat, (_adlerB << 16) | _adlerA);
+
+  _block.clear();
+
+  return writeChunk("IDAT", idat);
+}
+
+
+void
+PngStreamWriter::
+appendData(char const* data, int size)
+{
+  for (int i = 0; i < size; ++i)
+  {
+    _adlerA = (_adlerA + static_cast<uchar>(data[i])) % AdlerModulo;
+    _adlerB = (_adlerB + _adlerA) % AdlerModulo;
+  }
+
+  _block.append(data, size);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QIODevice>
+#include <QtCore/QSize>
+
+namespace QtNodes
+{
+
+/// Writes a PNG image scanline by scanline, so that images larger
+/// than the available memory can be produced.
+/// Qt offers no streaming deflate, the image data is stored in
+/// uncompressed deflate blocks.
+class PngStreamWriter
+{
+public:
+
+  PngStreamWriter(QIODevice &device, QSize size);
+
+  /// Writes the signature and the header.
+  bool
+  begin();
+
+  /// `rgba` holds width() non-premultiplied RGBA pixels,
+  /// as in QImage::Format_RGBA8888.
+  bool
+  writeScanline(uchar const* rgba);
+
+  /// Writes the end of the image data and the trailer.
+  bool
+  finish();
+
+private:
+
+  bool
+  writeChunk(char const* type, QByteArray const &data);
+
+  /// Wraps the pending data into a stored deflate block.
+  bool
+  flushBlock(bool final);
+
+  void
+  appendData(char const* data, int size);
+
+private:
+
+  QIODevice &_device;
+
+  QSize _size;
+
+  // uncompressed data of the current deflate block
+  QByteArray _block;
+
+  bool _zlibHeaderWritten;
+
+  // running Adler-32 checksum of the uncompressed data
+  quint32 _adlerA;
+  quint32 _adlerB;
+
+  int _scanlinesWritten;
+};
+}
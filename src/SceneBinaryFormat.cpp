@@ -0,0 +1,578 @@
+#include "SceneBinaryFormat.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <QtCore/QIODevice>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QtEndian>
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+#include <QtCore/QCborValue>
+#endif
+
+#include "Node.hpp"
+#include "NodeDataModel.hpp"
+#include "Connection.hpp"
+#include "SceneDeviceWait.hpp"
+
+using QtNodes::BinaryEncoding;
+using QtNodes::BinaryCursor;
+using QtNodes::BinarySceneWriter;
+using QtNodes::BinarySceneReader;
+using QtNodes::Node;
+using QtNodes::Connection;
+using QtNodes::PortType;
+using QtNodes::PortIndex;
+using QtNodes::waitForSceneData;
+
+namespace
+{
+
+quint8 const FormatVersion = 1;
+
+enum PayloadEncoding : quint8
+{
+  PayloadJson = 0,
+  PayloadCbor = 1
+};
+
+enum RecordTag : char
+{
+  ModelNameTag  = 'M',
+  NodeTag       = 'N',
+  ConnectionTag = 'C',
+  EndTag        = 'E'
+};
+
+}
+
+
+void
+BinaryEncoding::
+appendVarint(QByteArray &out, quint64 value)
+{
+  while (value >= 0x80)
+  {
+    out.append(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+
+  out.append(static_cast<char>(value));
+}
+
+
+void
+BinaryEncoding::
+appendString(QByteArray &out, QString const &s)
+{
+  appendBytes(out, s.toUtf8());
+}
+
+
+void
+BinaryEncoding::
+appendUuid(QByteArray &out, QUuid const &id)
+{
+  out.append(id.toRfc4122());
+}
+
+
+void
+BinaryEncoding::
+appendDouble(QByteArray &out, double value)
+{
+  quint64 bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  uchar bytes[sizeof(bits)];
+  qToLittleEndian(bits, bytes);
+
+  out.append(reinterpret_cast<char const*>(bytes), sizeof(bytes));
+}
+
+
+void
+BinaryEncoding::
+appendBytes(QByteArray &out, QByteArray const &bytes)
+{
+  appendVarint(out, bytes.size());
+  out.append(bytes);
+}
+
+
+void
+BinaryEncoding::
+appendConnection(QByteArray &out, Connection const &connection)
+{
+  appendUuid(out, connection.getNode(PortType::In)->id());
+  appendVarint(out, connection.getPortIndex(PortType::In));
+  appendUuid(out, connection.getNode(PortType::Out)->id());
+  appendVarint(out, connection.getPortIndex(PortType::Out));
+
+  bool const hasConverter = connection.hasTypeConverter();
+
+  out.append(static_cast<char>(hasConverter));
+
+  if (hasConverter)
+  {
+    for (PortType portType : {PortType::In, PortType::Out})
+    {
+      auto const dataType = connection.dataType(portType);
+
+      appendString(out, dataType.id);
+      appendString(out, dataType.name);
+    }
+  }
+}
+
+
+quint8
+BinaryEncoding::
+payloadEncoding()
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+  return PayloadCbor;
+#else
+  return PayloadJson;
+#endif
+}
+
+
+QByteArray
+BinaryEncoding::
+encodePayload(QJsonObject const &json)
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+  return QCborValue::fromJsonValue(json).toCbor();
+#else
+  return QJsonDocument(json).toJson(QJsonDocument::Compact);
+#endif
+}
+
+
+QJsonObject
+BinaryEncoding::
+decodePayload(QByteArray const &bytes, quint8 encoding)
+{
+  switch (encoding)
+  {
+    case PayloadJson:
+      return QJsonDocument::fromJson(bytes).object();
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+    case PayloadCbor:
+      return QCborValue::fromCbor(bytes).toJsonValue().toObject();
+#endif
+
+    default:
+      throw std::logic_error("Binary scene: unsupported payload encoding");
+  }
+}
+
+//------------------------------------------------------------------------------
+
+BinaryCursor::
+BinaryCursor(uchar const *data, qint64 size, qint64 offset)
+  : _data(data)
+  , _size(size)
+  , _offset(offset)
+{}
+
+
+quint8
+BinaryCursor::
+readByte()
+{
+  return *take(1);
+}
+
+
+quint64
+BinaryCursor::
+readVarint()
+{
+  quint64 value = 0;
+
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    quint8 const byte = readByte();
+
+    value |= static_cast<quint64>(byte & 0x7f) << shift;
+
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+
+  throw std::logic_error("Binary scene: malformed varint");
+}
+
+
+QString
+BinaryCursor::
+readString()
+{
+  quint64 const size = readVarint();
+
+  if (size > static_cast<quint64>(_size - _offset))
+    throw std::logic_error("Binary scene: truncated data");
+
+  return QString::fromUtf8(reinterpret_cast<char const*>(take(size)), int(size));
+}
+
+
+QUuid
+BinaryCursor::
+readUuid()
+{
+  return QUuid::fromRfc4122(QByteArray::fromRawData(reinterpret_cast<char const*>(take(16)), 16));
+}
+
+
+double
+BinaryCursor::
+readDouble()
+{
+  quint64 const bits = qFromLittleEndian<quint64>(take(sizeof(quint64)));
+
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+
+  return value;
+}
+
+
+QByteArray
+BinaryCursor::
+readBytes()
+{
+  quint64 const size = readVarint();
+
+  if (size > static_cast<quint64>(_size - _offset))
+    throw std::logic_error("Binary scene: truncated data");
+
+  return QByteArray(reinterpret_cast<char const*>(take(size)), int(size));
+}
+
+
+uchar const*
+BinaryCursor::
+take(qint64 size)
+{
+  if (size < 0 || size > _size - _offset)
+    throw std::logic_error("Binary scene: truncated data");
+
+  uchar const *p = _data + _offset;
+
+  _offset += size;
+
+  return p;
+}
+
+//------------------------------------------------------------------------------
+
+BinarySceneWriter::
+BinarySceneWriter(QIODevice &device)
+  : _device(device)
+  , _ok(true)
+{}
+
+
+void
+BinarySceneWriter::
+writeHeader()
+{
+  _buffer.append(BinarySceneReader::magic());
+  _buffer.append(static_cast<char>(FormatVersion));
+  _buffer.append(static_cast<char>(BinaryEncoding::payloadEncoding()));
+
+  flush();
+}
+
+
+void
+BinarySceneWriter::
+writeNode(Node const &node)
+{
+  QString const modelName = node.nodeDataModel()->name();
+
+  auto it = _modelNames.find(modelName);
+
+  if (it == _modelNames.end())
+  {
+    it = _modelNames.emplace(modelName, _modelNames.size()).first;
+
+    _buffer.append(ModelNameTag);
+    BinaryEncoding::appendVarint(_buffer, it->second);
+    BinaryEncoding::appendString(_buffer, modelName);
+  }
+
+  QPointF const pos = node.position();
+
+  _buffer.append(NodeTag);
+  BinaryEncoding::appendUuid(_buffer, node.id());
+  BinaryEncoding::appendVarint(_buffer, it->second);
+  BinaryEncoding::appendDouble(_buffer, pos.x());
+  BinaryEncoding::appendDouble(_buffer, pos.y());
+  BinaryEncoding::appendBytes(_buffer, BinaryEncoding::encodePayload(node.nodeDataModel()->save()));
+
+  flush();
+}
+
+
+void
+BinarySceneWriter::
+writeConnection(Connection const &connection)
+{
+  Node const* nodeIn  = connection.getNode(PortType::In);
+  Node const* nodeOut = connection.getNode(PortType::Out);
+
+  if (!nodeIn || !nodeOut)
+    return;
+
+  _buffer.append(ConnectionTag);
+  BinaryEncoding::appendConnection(_buffer, connection);
+
+  flush();
+}
+
+
+void
+BinarySceneWriter::
+writeEnd()
+{
+  _buffer.append(EndTag);
+
+  flush();
+}
+
+
+void
+BinarySceneWriter::
+flush()
+{
+  if (_ok && _device.write(_buffer) != _buffer.size())
+    _ok = false;
+
+  _buffer.clear();
+}
+
+//------------------------------------------------------------------------------
+
+BinarySceneReader::
+BinarySceneReader(QIODevice &device)
+  : _device(device)
+  , _payloadEncoding(PayloadJson)
+{
+  QByteArray const expected = magic();
+
+  QByteArray head(expected.size(), Qt::Uninitialized);
+  read(head.data(), head.size());
+
+  if (head != expected)
+    throw std::logic_error("Binary scene: bad magic");
+
+  if (readByte() != FormatVersion)
+    throw std::logic_error("Binary scene: unsupported format version");
+
+  _payloadEncoding = readByte();
+}
+
+
+BinarySceneReader::Record
+BinarySceneReader::
+next()
+{
+  for (;;)
+  {
+    switch (static_cast<char>(readByte()))
+    {
+      case ModelNameTag:
+      {
+        quint64 const id = readVarint();
+
+        _modelNames[id] = readString();
+        break;
+      }
+
+      case NodeTag:
+      {
+        _node.id = readUuid();
+
+        auto it = _modelNames.find(readVarint());
+
+        if (it == _modelNames.end())
+          throw std::logic_error("Binary scene: unknown model name id");
+
+        _node.modelName = it->second;
+
+        double const x = readDouble();
+        double const y = readDouble();
+        _node.position = QPointF(x, y);
+
+        _node.model = BinaryEncoding::decodePayload(readBytes(), _payloadEncoding);
+
+        return Record::Node;
+      }
+
+      case ConnectionTag:
+      {
+        _connection.inId     = readUuid();
+        _connection.inIndex  = static_cast<PortIndex>(readVarint());
+        _connection.outId    = readUuid();
+        _connection.outIndex = static_cast<PortIndex>(readVarint());
+
+        _connection.hasConverter = (readByte() != 0);
+
+        if (_connection.hasConverter)
+        {
+          _connection.converterIn.id    = readString();
+          _connection.converterIn.name  = readString();
+          _connection.converterOut.id   = readString();
+          _connection.converterOut.name = readString();
+        }
+        else
+        {
+          _connection.converterIn  = NodeDataType();
+          _connection.converterOut = NodeDataType();
+        }
+
+        return Record::Connection;
+      }
+
+      case EndTag:
+        return Record::End;
+
+      default:
+        throw std::logic_error("Binary scene: unknown record");
+    }
+  }
+}
+
+
+QByteArray
+BinarySceneReader::
+magic()
+{
+  return QByteArrayLiteral("NEDB");
+}
+
+
+bool
+BinarySceneReader::
+isBinary(QByteArray const &head)
+{
+  return head.startsWith(magic());
+}
+
+
+void
+BinarySceneReader::
+read(char *data, qint64 size)
+{
+  while (size > 0)
+  {
+    qint64 const n = _device.read(data, size);
+
+    if (n < 0 || (n == 0 && !waitForSceneData(_device)))
+      throw std::logic_error("Binary scene: truncated data");
+
+    data += n;
+    size -= n;
+  }
+}
+
+
+quint8
+BinarySceneReader::
+readByte()
+{
+  char c;
+  read(&c, 1);
+
+  return static_cast<quint8>(c);
+}
+
+
+quint64
+BinarySceneReader::
+readVarint()
+{
+  quint64 value = 0;
+
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    quint8 const byte = readByte();
+
+    value |= static_cast<quint64>(byte & 0x7f) << shift;
+
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+
+  throw std::logic_error("Binary scene: malformed varint");
+}
+
+
+QString
+BinarySceneReader::
+readString()
+{
+  return QString::fromUtf8(readBytes());
+}
+
+
+QUuid
+BinarySceneReader::
+readUuid()
+{
+  char bytes[16];
+  read(bytes, sizeof(bytes));
+
+  return QUuid::fromRfc4122(QByteArray::fromRawData(bytes, sizeof(bytes)));
+}
+
+
+double
+BinarySceneReader::
+readDouble()
+{
+  uchar bytes[sizeof(quint64)];
+  read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+
+  quint64 const bits = qFromLittleEndian<quint64>(bytes);
+
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+
+  return value;
+}
+
+
+QByteArray
+BinarySceneReader::
+readBytes()
+{
+  quint64 const size = readVarint();
+
+  // a corrupted length must not turn into a huge allocation up front
+  if (size > static_cast<quint64>(std::numeric_limits<int>::max()))
+    throw std::logic_error("Binary scene: malformed length");
+
+  QByteArray bytes;
+
+  while (static_cast<quint64>(bytes.size()) < size)
+  {
+    int const chunk =
+      static_cast<int>(std::min<quint64>(size - bytes.size(), 1 << 20));
+
+    int const offset = bytes.size();
+
+    bytes.resize(offset + chunk);
+    read(bytes.data() + offset, chunk);
+  }
+
+  return bytes;
+}
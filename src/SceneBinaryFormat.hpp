@@ -0,0 +1,274 @@
+#pragma once
+
+#include <unordered_map>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QPointF>
+#include <QtCore/QString>
+#include <QtCore/QUuid>
+
+#include "NodeData.hpp"
+#include "PortType.hpp"
+#include "QStringStdHash.hpp"
+
+class QIODevice;
+
+namespace QtNodes
+{
+
+class Node;
+class Connection;
+
+/// Encodings shared by the binary scene layouts: LEB128 varints,
+/// varint length prefixed UTF-8 strings and byte arrays, 16 byte uuids
+/// and little endian doubles.
+class BinaryEncoding
+{
+public:
+
+  static
+  void
+  appendVarint(QByteArray &out, quint64 value);
+
+  static
+  void
+  appendString(QByteArray &out, QString const &s);
+
+  static
+  void
+  appendUuid(QByteArray &out, QUuid const &id);
+
+  static
+  void
+  appendDouble(QByteArray &out, double value);
+
+  static
+  void
+  appendBytes(QByteArray &out, QByteArray const &bytes);
+
+  /// In uuid, varint in index, out uuid, varint out index, converter
+  /// flag followed by the four converter type strings. The connection
+  /// must be complete.
+  static
+  void
+  appendConnection(QByteArray &out, Connection const &connection);
+
+  /// The model payload encoding written by this build.
+  static
+  quint8
+  payloadEncoding();
+
+  static
+  QByteArray
+  encodePayload(QJsonObject const &json);
+
+  /// Throws std::logic_error for encodings this build can't read.
+  static
+  QJsonObject
+  decodePayload(QByteArray const &bytes, quint8 encoding);
+
+private:
+
+  BinaryEncoding() = delete;
+};
+
+
+/// Reads the shared encodings from memory, e.g. a mapped file.
+/// Reading past the end throws std::logic_error.
+class BinaryCursor
+{
+public:
+
+  BinaryCursor(uchar const *data, qint64 size, qint64 offset = 0);
+
+public:
+
+  qint64
+  offset() const { return _offset; }
+
+  quint8
+  readByte();
+
+  quint64
+  readVarint();
+
+  QString
+  readString();
+
+  QUuid
+  readUuid();
+
+  double
+  readDouble();
+
+  QByteArray
+  readBytes();
+
+private:
+
+  uchar const*
+  take(qint64 size);
+
+private:
+
+  uchar const *_data;
+
+  qint64 _size;
+
+  qint64 _offset;
+};
+
+
+/// The binary scene layout, a sequence of records:
+///
+///   header      "NEDB", format version, payload encoding
+///   model name  'M', varint id, string
+///   node        'N', 16 byte uuid, varint model name id,
+///               two doubles for the position, length prefixed payload
+///   connection  'C', in uuid, varint in index, out uuid, varint out index,
+///               converter flag followed by the four converter type strings
+///   end         'E'
+///
+/// Strings are varint length prefixed UTF-8, doubles are little endian.
+/// Model names are interned: each one is written once and referred to by
+/// id afterwards. The payload is the model's save() output, encoded as
+/// CBOR when Qt supports it and as compact JSON otherwise.
+class BinarySceneWriter
+{
+public:
+
+  BinarySceneWriter(QIODevice &device);
+
+public:
+
+  void
+  writeHeader();
+
+  void
+  writeNode(Node const &node);
+
+  /// Incomplete connections are skipped, like in the JSON format.
+  void
+  writeConnection(Connection const &connection);
+
+  void
+  writeEnd();
+
+  /// False once a write to the device has failed.
+  bool
+  ok() const { return _ok; }
+
+private:
+
+  void
+  flush();
+
+private:
+
+  QIODevice &_device;
+
+  std::unordered_map<QString, quint64> _modelNames;
+
+  // the record being assembled
+  QByteArray _buffer;
+
+  bool _ok;
+};
+
+
+/// Reads the records written by BinarySceneWriter one at a time.
+/// Malformed or truncated input throws std::logic_error.
+class BinarySceneReader
+{
+public:
+
+  enum class Record
+  {
+    Node,
+    Connection,
+    End
+  };
+
+  struct NodeRecord
+  {
+    QUuid id;
+    QString modelName;
+    QPointF position;
+    QJsonObject model;
+  };
+
+  struct ConnectionRecord
+  {
+    QUuid inId;
+    PortIndex inIndex;
+    QUuid outId;
+    PortIndex outIndex;
+
+    bool hasConverter;
+    NodeDataType converterIn;
+    NodeDataType converterOut;
+  };
+
+public:
+
+  /// Reads and checks the header.
+  BinarySceneReader(QIODevice &device);
+
+public:
+
+  /// Reads up to the next node or connection record.
+  Record
+  next();
+
+  NodeRecord const&
+  node() const { return _node; }
+
+  ConnectionRecord const&
+  connection() const { return _connection; }
+
+  static
+  QByteArray
+  magic();
+
+  /// True if the data starts like a binary scene.
+  static
+  bool
+  isBinary(QByteArray const &head);
+
+private:
+
+  void
+  read(char *data, qint64 size);
+
+  quint8
+  readByte();
+
+  quint64
+  readVarint();
+
+  QString
+  readString();
+
+  QUuid
+  readUuid();
+
+  double
+  readDouble();
+
+  QByteArray
+  readBytes();
+
+private:
+
+  QIODevice &_device;
+
+  quint8 _payloadEncoding;
+
+  std::unordered_map<quint64, QString> _modelNames;
+
+  NodeRecord _node;
+
+  ConnectionRecord _connection;
+};
+}
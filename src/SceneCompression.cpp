@@ -0,0 +1,386 @@
+#include "SceneCompression.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <QtCore/QThread>
+#include <QtCore/QtEndian>
+
+#include "FunctionTask.hpp"
+#include "SceneDeviceWait.hpp"
+
+using QtNodes::ChunkedCompression;
+using QtNodes::ChunkedCompressionWriter;
+using QtNodes::ChunkedCompressionReader;
+using QtNodes::FunctionTask;
+using QtNodes::waitForSceneData;
+
+namespace
+{
+
+quint8 const FormatVersion = 1;
+
+qint64 const HeaderSize = 4 + 1 + 4;
+
+// larger chunks are refused as malformed
+quint32 const MaxChunkSize = 64 * 1024 * 1024;
+
+void
+appendFixed32(QByteArray &out, quint32 value)
+{
+  uchar bytes[sizeof(value)];
+  qToLittleEndian(value, bytes);
+
+  out.append(reinterpret_cast<char const*>(bytes), sizeof(bytes));
+}
+
+
+void
+appendFixed64(QByteArray &out, quint64 value)
+{
+  uchar bytes[sizeof(value)];
+  qToLittleEndian(value, bytes);
+
+  out.append(reinterpret_cast<char const*>(bytes), sizeof(bytes));
+}
+
+
+quint32
+readFixed32(char const *p)
+{
+  return qFromLittleEndian<quint32>(reinterpret_cast<uchar const*>(p));
+}
+
+
+/// Same as fn(0) ... fn(count - 1), on the pool when there are several.
+template <typename Function>
+void
+runOnPool(QThreadPool &pool, std::size_t count, Function const &fn)
+{
+  if (count == 1)
+  {
+    fn(0);
+    return;
+  }
+
+  for (std::size_t i = 0; i < count; ++i)
+    pool.start(new FunctionTask([&fn, i]() { fn(i); }));
+
+  pool.waitForDone();
+}
+}
+
+
+QByteArray
+ChunkedCompression::
+magic()
+{
+  return QByteArrayLiteral("NEFZ");
+}
+
+
+bool
+ChunkedCompression::
+isCompressed(QByteArray const &head)
+{
+  return head.startsWith(magic());
+}
+
+
+//------------------------------------------------------------------------------
+
+ChunkedCompressionWriter::
+ChunkedCompressionWriter(QIODevice &target, int chunkSize)
+  : _target(target)
+  , _chunkSize(chunkSize)
+  , _written(0)
+  , _uncompressed(0)
+  , _ok(true)
+  , _finished(false)
+{
+  _pool.setMaxThreadCount(QThread::idealThreadCount());
+
+  QByteArray header = ChunkedCompression::magic();
+  header.append(static_cast<char>(FormatVersion));
+  appendFixed32(header, quint32(_chunkSize));
+
+  writeRaw(header);
+}
+
+
+ChunkedCompressionWriter::
+~ChunkedCompressionWriter() = default;
+
+
+bool
+ChunkedCompressionWriter::
+finish()
+{
+  if (_finished)
+    return _ok;
+
+  _finished = true;
+
+  if (!_current.isEmpty())
+  {
+    _chunks.push_back(_current);
+    _current.clear();
+  }
+
+  compressChunks();
+
+  QByteArray tail;
+  appendFixed32(tail, 0);
+
+  quint64 const indexOffset = quint64(_written + tail.size());
+
+  appendFixed32(tail, quint32(_index.size()));
+
+  for (ChunkEntry const & entry : _index)
+  {
+    appendFixed64(tail, entry.offset);
+    appendFixed64(tail, entry.uncompressedOffset);
+  }
+
+  appendFixed64(tail, indexOffset);
+  tail.append(ChunkedCompression::magic());
+
+  writeRaw(tail);
+
+  return _ok;
+}
+
+
+qint64
+ChunkedCompressionWriter::
+writeData(char const *data, qint64 size)
+{
+  if (!_ok || _finished)
+    return -1;
+
+  qint64 left = size;
+
+  while (left > 0)
+  {
+    qint64 const n = std::min<qint64>(left, _chunkSize - _current.size());
+
+    _current.append(data, int(n));
+
+    data += n;
+    left -= n;
+
+    if (_current.size() == _chunkSize)
+    {
+      _chunks.push_back(_current);
+      _current.clear();
+
+      // one chunk per thread
+      if (_chunks.size() >= std::size_t(std::max(1, _pool.maxThreadCount())))
+        compressChunks();
+    }
+  }
+
+  return _ok ? size : -1;
+}
+
+
+void
+ChunkedCompressionWriter::
+compressChunks()
+{
+  if (_chunks.empty())
+    return;
+
+  std::vector<QByteArray> compressed(_chunks.size());
+
+  runOnPool(_pool, _chunks.size(), [&](std::size_t i)
+  {
+    compressed[i] = qCompress(_chunks[i]);
+  });
+
+  for (std::size_t i = 0; i < _chunks.size(); ++i)
+  {
+    _index.push_back({ quint64(_written), quint64(_uncompressed) });
+
+    QByteArray record;
+    appendFixed32(record, quint32(compressed[i].size()));
+    appendFixed32(record, quint32(_chunks[i].size()));
+
+    writeRaw(record);
+    writeRaw(compressed[i]);
+
+    _uncompressed += _chunks[i].size();
+  }
+
+  _chunks.clear();
+}
+
+
+void
+ChunkedCompressionWriter::
+writeRaw(QByteArray const &bytes)
+{
+  if (_ok && _target.write(bytes) != bytes.size())
+    _ok = false;
+
+  _written += bytes.size();
+}
+
+
+//------------------------------------------------------------------------------
+
+ChunkedCompressionReader::
+ChunkedCompressionReader(QIODevice &source)
+  : _source(source)
+  , _chunkSize(0)
+  , _position(0)
+  , _atEnd(false)
+  , _truncated(false)
+{
+  _pool.setMaxThreadCount(QThread::idealThreadCount());
+
+  char header[HeaderSize];
+
+  if (!readFully(header, HeaderSize))
+    throw std::logic_error("Compressed scene: truncated data");
+
+  if (!QByteArray(header, 4).startsWith(ChunkedCompression::magic()))
+    throw std::logic_error("Compressed scene: bad magic");
+
+  if (static_cast<quint8>(header[4]) != FormatVersion)
+    throw std::logic_error("Compressed scene: unsupported format version");
+
+  quint32 const chunkSize = readFixed32(header + 5);
+
+  if (chunkSize == 0 || chunkSize > MaxChunkSize)
+    throw std::logic_error("Compressed scene: bad chunk size");
+
+  _chunkSize = int(chunkSize);
+}
+
+
+ChunkedCompressionReader::
+~ChunkedCompressionReader() = default;
+
+
+qint64
+ChunkedCompressionReader::
+bytesAvailable() const
+{
+  return (_decompressed.size() - _position) + QIODevice::bytesAvailable();
+}
+
+
+qint64
+ChunkedCompressionReader::
+readData(char *data, qint64 maxSize)
+{
+  if (_position == _decompressed.size() && !decompressChunks())
+  {
+    setErrorString(_truncated ?
+                   QStringLiteral("Compressed scene: truncated data") :
+                   QStringLiteral("Compressed scene: malformed data"));
+    return -1;
+  }
+
+  qint64 const n = std::min<qint64>(maxSize, _decompressed.size() - _position);
+
+  std::memcpy(data, _decompressed.constData() + _position, std::size_t(n));
+
+  _position += n;
+
+  return n;
+}
+
+
+bool
+ChunkedCompressionReader::
+decompressChunks()
+{
+  _decompressed.clear();
+  _position = 0;
+
+  std::size_t const batchSize = std::size_t(std::max(1, _pool.maxThreadCount()));
+
+  // zlib grows incompressible data slightly
+  quint32 const maxCompressedSize = quint32(_chunkSize) + quint32(_chunkSize) / 100 + 64;
+
+  std::vector<QByteArray> chunks;
+  std::vector<int>        sizes;
+
+  while (!_atEnd && chunks.size() < batchSize)
+  {
+    char sizeBytes[4];
+
+    if (!readFully(sizeBytes, sizeof(sizeBytes)))
+      return false;
+
+    quint32 const compressedSize = readFixed32(sizeBytes);
+
+    // the index that follows is for random access
+    if (compressedSize == 0)
+    {
+      _atEnd = true;
+      break;
+    }
+
+    if (!readFully(sizeBytes, sizeof(sizeBytes)))
+      return false;
+
+    quint32 const size = readFixed32(sizeBytes);
+
+    if (size > quint32(_chunkSize) || compressedSize > maxCompressedSize)
+      return false;
+
+    QByteArray chunk(int(compressedSize), Qt::Uninitialized);
+
+    if (!readFully(chunk.data(), chunk.size()))
+      return false;
+
+    chunks.push_back(chunk);
+    sizes.push_back(int(size));
+  }
+
+  if (chunks.empty())
+    return true;
+
+  std::vector<QByteArray> decompressed(chunks.size());
+
+  runOnPool(_pool, chunks.size(), [&](std::size_t i)
+  {
+    decompressed[i] = qUncompress(chunks[i]);
+  });
+
+  for (std::size_t i = 0; i < chunks.size(); ++i)
+  {
+    if (decompressed[i].size() != sizes[i])
+      return false;
+
+    _decompressed.append(decompressed[i]);
+  }
+
+  return true;
+}
+
+
+bool
+ChunkedCompressionReader::
+readFully(char *data, qint64 size)
+{
+  while (size > 0)
+  {
+    qint64 const n = _source.read(data, size);
+
+    if (n < 0 || (n == 0 && !waitForSceneData(_source)))
+    {
+      _truncated = true;
+      return false;
+    }
+
+    data += n;
+    size -= n;
+  }
+
+  return true;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QIODevice>
+#include <QtCore/QThreadPool>
+
+namespace QtNodes
+{
+
+/// The chunked compressed layout of a saved scene:
+///
+///   header  "NEFZ", format version, u32 chunk size
+///   chunk   u32 compressed size, u32 uncompressed size, qCompress() output
+///   end     u32 0
+///   index   u32 chunk count, per chunk the u64 offset of its record and
+///           the u64 offset of its data in the uncompressed stream
+///   trailer u64 offset of the index, "NEFZ"
+///
+/// Integers are little endian, offsets count from the header. Every chunk
+/// holds `chunk size` bytes of the saved scene, the last one possibly
+/// less, and is compressed on its own: the chunks are compressed and
+/// decompressed in parallel, and the index at the end locates the chunk
+/// holding any uncompressed offset.
+class ChunkedCompression
+{
+public:
+
+  static
+  QByteArray
+  magic();
+
+  /// True if the data starts like a compressed scene.
+  static
+  bool
+  isCompressed(QByteArray const &head);
+
+private:
+
+  ChunkedCompression() = delete;
+};
+
+/// Compresses what is written to it into the target device.
+class ChunkedCompressionWriter : public QIODevice
+{
+public:
+
+  /// Writes the header right away.
+  ChunkedCompressionWriter(QIODevice &target, int chunkSize = 256 * 1024);
+
+  ~ChunkedCompressionWriter();
+
+public:
+
+  /// Compresses the rest, writes the end and the index. False once a
+  /// write to the target has failed.
+  bool
+  finish();
+
+  bool
+  isSequential() const override { return true; }
+
+protected:
+
+  qint64
+  readData(char*, qint64) override { return -1; }
+
+  qint64
+  writeData(char const *data, qint64 size) override;
+
+private:
+
+  /// Compresses the full chunks on the pool and writes them in order.
+  void
+  compressChunks();
+
+  void
+  writeRaw(QByteArray const &bytes);
+
+private:
+
+  struct ChunkEntry
+  {
+    quint64 offset;
+    quint64 uncompressedOffset;
+  };
+
+  QIODevice &_target;
+
+  int _chunkSize;
+
+  QThreadPool _pool;
+
+  // the chunk being filled
+  QByteArray _current;
+
+  std::vector<QByteArray> _chunks;
+
+  std::vector<ChunkEntry> _index;
+
+  qint64 _written;
+  qint64 _uncompressed;
+
+  bool _ok;
+  bool _finished;
+};
+
+/// Reads the uncompressed stream out of a compressed scene, decompressing
+/// a few chunks ahead in parallel. Malformed data makes the reads fail.
+class ChunkedCompressionReader : public QIODevice
+{
+public:
+
+  /// Reads and checks the header, throws std::logic_error if it is wrong.
+  explicit
+  ChunkedCompressionReader(QIODevice &source);
+
+  ~ChunkedCompressionReader();
+
+public:
+
+  bool
+  isSequential() const override { return true; }
+
+  qint64
+  bytesAvailable() const override;
+
+protected:
+
+  qint64
+  readData(char *data, qint64 maxSize) override;
+
+  qint64
+  writeData(char const*, qint64) override { return -1; }
+
+private:
+
+  /// Reads and decompresses the next chunks; false on malformed data.
+  bool
+  decompressChunks();
+
+  /// False when the source ends or stalls first.
+  bool
+  readFully(char *data, qint64 size);
+
+private:
+
+  QIODevice &_source;
+
+  int _chunkSize;
+
+  QThreadPool _pool;
+
+  QByteArray _decompressed;
+  qint64     _position;
+
+  bool _atEnd;
+
+  // set when the source ended or stalled before the end record
+  bool _truncated;
+};
+}
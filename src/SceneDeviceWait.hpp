@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QtCore/QIODevice>
+
+namespace QtNodes
+{
+
+/// Waits for more of a scene read from a sequential device, e.g. a
+/// socket or a pipe. False when nothing came within 30 seconds; the
+/// readers then fail as on truncated data instead of blocking forever.
+inline
+bool
+waitForSceneData(QIODevice &device)
+{
+  int const timeoutMsec = 30000;
+
+  return device.waitForReadyRead(timeoutMsec);
+}
+}
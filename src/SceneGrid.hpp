@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <QtCore/QPointF>
+#include <QtCore/QRectF>
+#include <QtCore/QtGlobal>
+
+namespace QtNodes
+{
+
+/// Uniform grid of items spanning arbitrary scene rects, e.g. connections.
+/// An item is listed in every cell its rect overlaps, so long items cost
+/// more to file; NodeSpatialIndex suits the compact, similar sized nodes.
+template <typename Item>
+class SceneGrid
+{
+public:
+
+  explicit
+  SceneGrid(double cellSize = 512.0)
+    : _cellSize(cellSize)
+  {}
+
+public:
+
+  /// Files the item under the scene rect, moving it if it was filed.
+  void
+  insert(Item item, QRectF const &sceneRect)
+  {
+    QRectF const r = sceneRect.normalized();
+
+    auto it = _rects.find(item);
+
+    if (it != _rects.end())
+    {
+      if (it->second == r)
+        return;
+
+      unfile(item, it->second);
+      it->second = r;
+    }
+    else
+    {
+      _rects.emplace(item, r);
+    }
+
+    forEachCell(r, [&](qint64 key) { _cells[key].push_back(item); });
+  }
+
+  void
+  remove(Item item)
+  {
+    auto it = _rects.find(item);
+
+    if (it == _rects.end())
+      return;
+
+    unfile(item, it->second);
+    _rects.erase(it);
+  }
+
+  void
+  clear()
+  {
+    _cells.clear();
+    _rects.clear();
+  }
+
+  bool
+  empty() const { return _rects.empty(); }
+
+  /// The filed items and their rects.
+  std::unordered_map<Item, QRectF> const &
+  rects() const { return _rects; }
+
+  /// The items whose rect intersects the scene rect.
+  std::vector<Item>
+  query(QRectF const &sceneRect) const
+  {
+    std::vector<Item> result;
+
+    QRectF const r = sceneRect.normalized();
+
+    if (r.isEmpty() || _rects.empty())
+      return result;
+
+    double const cellCount =
+      double(cellCoordinate(r.right()) - cellCoordinate(r.left()) + 1) *
+      double(cellCoordinate(r.bottom()) - cellCoordinate(r.top()) + 1);
+
+    // a rect over more cells than there are items, e.g. a zoomed out
+    // view, is cheaper to answer item by item
+    if (cellCount > _rects.size())
+    {
+      for (auto const & pair : _rects)
+      {
+        if (pair.second.intersects(r))
+          result.push_back(pair.first);
+      }
+
+      return result;
+    }
+
+    // items spanning several cells are listed in each of them
+    std::unordered_set<Item> seen;
+
+    forEachCell(r, [&](qint64 key)
+    {
+      auto it = _cells.find(key);
+
+      if (it == _cells.end())
+        return;
+
+      for (Item item : it->second)
+      {
+        if (_rects.at(item).intersects(r) && seen.insert(item).second)
+          result.push_back(item);
+      }
+    });
+
+    return result;
+  }
+
+  /// The items whose rect contains the scene point.
+  std::vector<Item>
+  query(QPointF const &scenePoint) const
+  {
+    std::vector<Item> result;
+
+    auto it = _cells.find(cellKey(cellCoordinate(scenePoint.x()),
+                                  cellCoordinate(scenePoint.y())));
+
+    if (it == _cells.end())
+      return result;
+
+    for (Item item : it->second)
+    {
+      if (_rects.at(item).contains(scenePoint))
+        result.push_back(item);
+    }
+
+    return result;
+  }
+
+private:
+
+  void
+  unfile(Item item, QRectF const &sceneRect)
+  {
+    forEachCell(sceneRect, [&](qint64 key)
+    {
+      auto it = _cells.find(key);
+
+      if (it == _cells.end())
+        return;
+
+      auto &items = it->second;
+
+      items.erase(std::remove(items.begin(), items.end(), item), items.end());
+
+      if (items.empty())
+        _cells.erase(it);
+    });
+  }
+
+  template <typename Function>
+  void
+  forEachCell(QRectF const &sceneRect, Function const &fn) const
+  {
+    int const x0 = cellCoordinate(sceneRect.left());
+    int const y0 = cellCoordinate(sceneRect.top());
+    int const x1 = cellCoordinate(sceneRect.right());
+    int const y1 = cellCoordinate(sceneRect.bottom());
+
+    for (int y = y0; y <= y1; ++y)
+      for (int x = x0; x <= x1; ++x)
+        fn(cellKey(x, y));
+  }
+
+  static
+  qint64
+  cellKey(int x, int y)
+  {
+    return static_cast<qint64>((static_cast<quint64>(static_cast<quint32>(x)) << 32) |
+                               static_cast<quint32>(y));
+  }
+
+  int
+  cellCoordinate(double v) const
+  {
+    return static_cast<int>(std::floor(v / _cellSize));
+  }
+
+private:
+
+  double _cellSize;
+
+  std::unordered_map<qint64, std::vector<Item>> _cells;
+
+  std::unordered_map<Item, QRectF> _rects;
+};
+}
@@ -0,0 +1,875 @@
+#include "SceneHistory.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include <QtCore/QJsonDocument>
+#include <QtCore/QTimer>
+
+#include "FlowScene.hpp"
+#include "Node.hpp"
+#include "NodeDataModel.hpp"
+#include "NodeGraphicsObject.hpp"
+#include "Connection.hpp"
+
+using QtNodes::SceneHistory;
+using QtNodes::FlowScene;
+using QtNodes::Node;
+using QtNodes::Connection;
+using QtNodes::PortType;
+
+namespace
+{
+
+Node*
+findNode(FlowScene const& scene, QUuid const& id)
+{
+  auto it = scene.nodes().find(id);
+
+  return it != scene.nodes().end() ? it->second.get() : nullptr;
+}
+
+
+Connection*
+findConnection(FlowScene const& scene, QJsonObject const& connectionJson)
+{
+  return scene.findConnection(QUuid(connectionJson["in_id"].toString()),
+                              connectionJson["in_index"].toInt(),
+                              QUuid(connectionJson["out_id"].toString()),
+                              connectionJson["out_index"].toInt());
+}
+
+
+qint64
+jsonSize(QJsonObject const& json)
+{
+  if (json.isEmpty())
+    return 0;
+
+  return QJsonDocument(json).toJson(QJsonDocument::Compact).size();
+}
+}
+
+
+SceneHistory::
+SceneHistory(FlowScene& scene)
+  : _scene(scene)
+  , _open(false)
+  , _closeScheduled(false)
+  , _macroDepth(0)
+  , _enabled(false)
+  , _applying(false)
+  , _mergeAllowed(false)
+  , _memoryUsage(0)
+  , _memoryBudget(32 * 1024 * 1024)
+  , _stepLimit(0)
+  , _moveMergeInterval(1000)
+{
+  _clock.start();
+
+  for (auto const & pair : _scene.nodes())
+    _positions[pair.first] = pair.second->position();
+
+  connect(&_scene, &FlowScene::nodeCreated, this, &SceneHistory::onNodeCreated);
+  connect(&_scene, &FlowScene::nodeDeleted, this, &SceneHistory::onNodeDeleted);
+  connect(&_scene, &FlowScene::nodeMoved, this, &SceneHistory::onNodeMoved);
+  connect(&_scene, &FlowScene::connectionCreated, this, &SceneHistory::onConnectionCreated);
+  connect(&_scene, &FlowScene::connectionDeleted, this, &SceneHistory::onConnectionDeleted);
+}
+
+
+SceneHistory::
+~SceneHistory() = default;
+
+
+bool
+SceneHistory::
+canUndo() const
+{
+  return !_undo.empty() || (_open && !_current.commands.empty());
+}
+
+
+bool
+SceneHistory::
+canRedo() const
+{
+  return !_redo.empty();
+}
+
+
+QString
+SceneHistory::
+undoText() const
+{
+  return _undo.empty() ? QString() : _undo.back().text;
+}
+
+
+QString
+SceneHistory::
+redoText() const
+{
+  return _redo.empty() ? QString() : _redo.back().text;
+}
+
+
+std::size_t
+SceneHistory::
+undoCount() const
+{
+  return _undo.size();
+}
+
+
+std::size_t
+SceneHistory::
+redoCount() const
+{
+  return _redo.size();
+}
+
+
+qint64
+SceneHistory::
+memoryUsage() const
+{
+  return _memoryUsage;
+}
+
+
+void
+SceneHistory::
+setMemoryBudget(qint64 bytes)
+{
+  _memoryBudget = bytes;
+
+  if (dropSteps())
+    Q_EMIT changed();
+}
+
+
+qint64
+SceneHistory::
+memoryBudget() const
+{
+  return _memoryBudget;
+}
+
+
+void
+SceneHistory::
+setStepLimit(std::size_t steps)
+{
+  _stepLimit = steps;
+
+  if (dropSteps())
+    Q_EMIT changed();
+}
+
+
+std::size_t
+SceneHistory::
+stepLimit() const
+{
+  return _stepLimit;
+}
+
+
+void
+SceneHistory::
+setMoveMergeInterval(int msec)
+{
+  _moveMergeInterval = msec;
+}
+
+
+int
+SceneHistory::
+moveMergeInterval() const
+{
+  return _moveMergeInterval;
+}
+
+
+void
+SceneHistory::
+setEnabled(bool enabled)
+{
+  _enabled = enabled;
+}
+
+
+bool
+SceneHistory::
+isEnabled() const
+{
+  return _enabled;
+}
+
+
+void
+SceneHistory::
+beginMacro(QString const& text)
+{
+  if (_macroDepth > 0)
+  {
+    ++_macroDepth;
+    return;
+  }
+
+  // the changes made so far are a step of their own
+  closeStep();
+
+  ++_macroDepth;
+
+  Step& step = currentStep();
+  step.text  = text;
+  step.macro = true;
+}
+
+
+void
+SceneHistory::
+endMacro()
+{
+  if (_macroDepth > 0 && --_macroDepth == 0)
+    closeStep();
+}
+
+
+void
+SceneHistory::
+recordModelStateChange(Node& node, QJsonObject const& before)
+{
+  if (!recording())
+    return;
+
+  QJsonObject const after = node.nodeDataModel()->save();
+
+  Command command;
+  command.kind = Command::Kind::ModelState;
+  command.node = node.id();
+
+  for (auto it = before.constBegin(); it != before.constEnd(); ++it)
+  {
+    auto const found = after.constFind(it.key());
+
+    if (found == after.constEnd())
+    {
+      command.removed.append(it.key());
+      command.before.insert(it.key(), it.value());
+    }
+    else if (found.value() != it.value())
+    {
+      command.before.insert(it.key(), it.value());
+      command.after.insert(it.key(), found.value());
+    }
+  }
+
+  for (auto it = after.constBegin(); it != after.constEnd(); ++it)
+  {
+    if (!before.contains(it.key()))
+    {
+      command.added.append(it.key());
+      command.after.insert(it.key(), it.value());
+    }
+  }
+
+  if (command.before.isEmpty() && command.after.isEmpty())
+    return;
+
+  currentStep().commands.push_back(std::move(command));
+}
+
+
+void
+SceneHistory::
+undo()
+{
+  if (_macroDepth > 0)
+    return;
+
+  closeStep();
+
+  if (_undo.empty())
+    return;
+
+  Step step = std::move(_undo.back());
+  _undo.pop_back();
+
+  try
+  {
+    apply(step, false);
+  }
+  catch (...)
+  {
+    // the scene matches neither end of the step
+    clear();
+    throw;
+  }
+
+  _redo.push_back(std::move(step));
+
+  _mergeAllowed = false;
+
+  dropSteps();
+
+  Q_EMIT changed();
+}
+
+
+void
+SceneHistory::
+redo()
+{
+  if (_macroDepth > 0)
+    return;
+
+  closeStep();
+
+  if (_redo.empty())
+    return;
+
+  Step step = std::move(_redo.back());
+  _redo.pop_back();
+
+  try
+  {
+    apply(step, true);
+  }
+  catch (...)
+  {
+    clear();
+    throw;
+  }
+
+  _undo.push_back(std::move(step));
+
+  _mergeAllowed = false;
+
+  dropSteps();
+
+  Q_EMIT changed();
+}
+
+
+void
+SceneHistory::
+clear()
+{
+  _undo.clear();
+  _redo.clear();
+
+  _current = Step();
+  _open    = false;
+
+  _memoryUsage  = 0;
+  _mergeAllowed = false;
+
+  Q_EMIT changed();
+}
+
+
+void
+SceneHistory::
+onNodeCreated(Node& node)
+{
+  _positions[node.id()] = node.position();
+
+  if (!recording())
+    return;
+
+  // the node is saved when undone, with the state it has then
+  Command command;
+  command.kind = Command::Kind::CreateNode;
+  command.node = node.id();
+
+  currentStep().commands.push_back(std::move(command));
+}
+
+
+void
+SceneHistory::
+onNodeDeleted(Node& node)
+{
+  _positions.erase(node.id());
+
+  if (!recording())
+    return;
+
+  Command command;
+  command.kind   = Command::Kind::RemoveNode;
+  command.node   = node.id();
+  command.before = node.save();
+
+  currentStep().commands.push_back(std::move(command));
+}
+
+
+void
+SceneHistory::
+onNodeMoved(Node& node, QPointF const& position)
+{
+  QPointF& known = _positions[node.id()];
+
+  QPointF const from = known;
+
+  known = position;
+
+  // also the moves made by undo() and redo(), reported afterwards
+  if (!recording() || from == position)
+    return;
+
+  auto& commands = currentStep().commands;
+
+  if (!commands.empty() &&
+      commands.back().kind == Command::Kind::Move &&
+      commands.back().node == node.id())
+  {
+    commands.back().to = position;
+    return;
+  }
+
+  Command command;
+  command.kind = Command::Kind::Move;
+  command.node = node.id();
+  command.from = from;
+  command.to   = position;
+
+  commands.push_back(std::move(command));
+}
+
+
+void
+SceneHistory::
+onConnectionCreated(Connection const& connection)
+{
+  if (!recording())
+    return;
+
+  Command command;
+  command.kind   = Command::Kind::Connect;
+  command.before = connection.save();
+
+  currentStep().commands.push_back(std::move(command));
+}
+
+
+void
+SceneHistory::
+onConnectionDeleted(Connection const& connection)
+{
+  if (!recording())
+    return;
+
+  Command command;
+  command.kind   = Command::Kind::Disconnect;
+  command.before = connection.save();
+
+  auto& commands = currentStep().commands;
+
+  // The scene reports a removed node before its connections. They are
+  // put ahead of it, so that undoing restores the node first.
+  auto position = commands.end();
+
+  if (!commands.empty() &&
+      commands.back().kind == Command::Kind::RemoveNode &&
+      (commands.back().node == connection.getNode(PortType::In)->id() ||
+       commands.back().node == connection.getNode(PortType::Out)->id()))
+  {
+    position = std::prev(commands.end());
+  }
+
+  commands.insert(position, std::move(command));
+}
+
+
+bool
+SceneHistory::
+recording() const
+{
+  return _enabled && !_applying;
+}
+
+
+SceneHistory::Step&
+SceneHistory::
+currentStep()
+{
+  if (!_open)
+  {
+    _current = Step();
+    _open    = true;
+  }
+
+  if (_macroDepth == 0 && !_closeScheduled)
+  {
+    _closeScheduled = true;
+
+    QTimer::singleShot(0, this, [this]()
+    {
+      _closeScheduled = false;
+
+      if (_macroDepth == 0)
+        closeStep();
+    });
+  }
+
+  return _current;
+}
+
+
+void
+SceneHistory::
+closeStep()
+{
+  if (!_open)
+    return;
+
+  Step step = std::move(_current);
+
+  _current = Step();
+  _open    = false;
+
+  // placed after nodeCreated(), their first moves are not changes
+  for (Command const& command : step.commands)
+  {
+    if (command.kind != Command::Kind::CreateNode)
+      continue;
+
+    if (Node* node = findNode(_scene, command.node))
+      _positions[command.node] = node->position();
+  }
+
+  auto& commands = step.commands;
+
+  commands.erase(std::remove_if(commands.begin(), commands.end(),
+                                [](Command const& command)
+                                {
+                                  return command.kind == Command::Kind::Move &&
+                                         command.from == command.to;
+                                }),
+                 commands.end());
+
+  if (commands.empty())
+    return;
+
+  step.time = _clock.elapsed();
+
+  if (step.text.isEmpty())
+    step.text = describe(step);
+
+  for (Step const& redone : _redo)
+    _memoryUsage -= redone.cost;
+
+  _redo.clear();
+
+  if (!mergeMoves(step))
+  {
+    step.cost     = cost(step);
+    _memoryUsage += step.cost;
+
+    _undo.push_back(std::move(step));
+  }
+
+  _mergeAllowed = true;
+
+  dropSteps();
+
+  Q_EMIT changed();
+}
+
+
+bool
+SceneHistory::
+mergeMoves(Step& step)
+{
+  if (!_mergeAllowed || _moveMergeInterval <= 0 || _undo.empty())
+    return false;
+
+  Step& last = _undo.back();
+
+  if (step.macro || last.macro ||
+      step.time - last.time > _moveMergeInterval ||
+      step.commands.size() != last.commands.size())
+    return false;
+
+  std::unordered_map<QUuid, std::size_t> lastMoves;
+
+  for (std::size_t i = 0; i < last.commands.size(); ++i)
+  {
+    if (last.commands[i].kind != Command::Kind::Move)
+      return false;
+
+    lastMoves[last.commands[i].node] = i;
+  }
+
+  for (Command const& command : step.commands)
+  {
+    if (command.kind != Command::Kind::Move ||
+        lastMoves.find(command.node) == lastMoves.end())
+      return false;
+  }
+
+  for (Command const& command : step.commands)
+    last.commands[lastMoves[command.node]].to = command.to;
+
+  last.time = step.time;
+
+  return true;
+}
+
+
+bool
+SceneHistory::
+dropSteps()
+{
+  bool dropped = false;
+
+  while (!_undo.empty() &&
+         (_memoryUsage > _memoryBudget ||
+          (_stepLimit > 0 && _undo.size() > _stepLimit)))
+  {
+    _memoryUsage -= _undo.front().cost;
+    _undo.pop_front();
+
+    dropped = true;
+  }
+
+  // then the steps furthest ahead
+  while (!_redo.empty() && _memoryUsage > _memoryBudget)
+  {
+    _memoryUsage -= _redo.front().cost;
+    _redo.pop_front();
+
+    dropped = true;
+  }
+
+  return dropped;
+}
+
+
+void
+SceneHistory::
+apply(Step& step, bool forward)
+{
+  bool const deferred = _scene.dataPropagationDeferred();
+
+  _applying = true;
+
+  // the restored connections carry data once the step is applied
+  _scene.setDataPropagationDeferred(true);
+
+  try
+  {
+    if (forward)
+    {
+      for (Command& command : step.commands)
+        apply(command, true);
+    }
+    else
+    {
+      for (auto it = step.commands.rbegin(); it != step.commands.rend(); ++it)
+        apply(*it, false);
+    }
+  }
+  catch (...)
+  {
+    _applying = false;
+    _scene.setDataPropagationDeferred(deferred);
+    throw;
+  }
+
+  _applying = false;
+  _scene.setDataPropagationDeferred(deferred);
+
+  // undone creations now hold the nodes
+  _memoryUsage -= step.cost;
+  step.cost     = cost(step);
+  _memoryUsage += step.cost;
+}
+
+
+void
+SceneHistory::
+apply(Command& command, bool forward)
+{
+  using Kind = Command::Kind;
+
+  Kind kind = command.kind;
+
+  // going back, a creation is a removal and so on
+  if (!forward)
+  {
+    switch (kind)
+    {
+      case Kind::CreateNode:
+        kind = Kind::RemoveNode;
+        break;
+
+      case Kind::RemoveNode:
+        kind = Kind::CreateNode;
+        break;
+
+      case Kind::Connect:
+        kind = Kind::Disconnect;
+        break;
+
+      case Kind::Disconnect:
+        kind = Kind::Connect;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  Node* node = findNode(_scene, command.node);
+
+  switch (kind)
+  {
+    case Kind::CreateNode:
+      if (!node)
+        _scene.restoreNode(command.before);
+      break;
+
+    case Kind::RemoveNode:
+      if (node)
+      {
+        command.before = node->save();
+        _scene.removeNode(*node);
+      }
+      break;
+
+    case Kind::Connect:
+      restoreConnection(command.before);
+      break;
+
+    case Kind::Disconnect:
+      removeConnection(command.before);
+      break;
+
+    case Kind::Move:
+      if (node)
+      {
+        QPointF const position = forward ? command.to : command.from;
+
+        // the nodeMoved() signal that follows is not a change
+        _positions[command.node] = position;
+
+        _scene.setNodePosition(*node, position);
+      }
+      break;
+
+    case Kind::ModelState:
+      if (node)
+      {
+        QJsonObject modelJson = node->nodeDataModel()->save();
+
+        for (QString const& key : forward ? command.removed : command.added)
+          modelJson.remove(key);
+
+        QJsonObject const& values = forward ? command.after : command.before;
+
+        for (auto it = values.constBegin(); it != values.constEnd(); ++it)
+          modelJson.insert(it.key(), it.value());
+
+        node->nodeDataModel()->restore(modelJson);
+
+        if (node->hasGraphicsObject())
+          node->nodeGraphicsObject().update();
+      }
+      break;
+  }
+}
+
+
+void
+SceneHistory::
+restoreConnection(QJsonObject const& connectionJson)
+{
+  if (findNode(_scene, QUuid(connectionJson["in_id"].toString())) &&
+      findNode(_scene, QUuid(connectionJson["out_id"].toString())) &&
+      !findConnection(_scene, connectionJson))
+  {
+    _scene.restoreConnection(connectionJson);
+  }
+}
+
+
+void
+SceneHistory::
+removeConnection(QJsonObject const& connectionJson)
+{
+  if (Connection* connection = findConnection(_scene, connectionJson))
+    _scene.deleteConnection(*connection);
+}
+
+
+qint64
+SceneHistory::
+cost(Step const& step)
+{
+  qint64 bytes = sizeof(Step) + step.text.size() * sizeof(QChar);
+
+  for (Command const& command : step.commands)
+  {
+    bytes += sizeof(Command);
+    bytes += jsonSize(command.before) + jsonSize(command.after);
+
+    for (QString const& key : command.added + command.removed)
+      bytes += key.size() * sizeof(QChar);
+  }
+
+  return bytes;
+}
+
+
+QString
+SceneHistory::
+describe(Step const& step)
+{
+  int created      = 0;
+  int removed      = 0;
+  int connected    = 0;
+  int disconnected = 0;
+  int moved        = 0;
+  int changed      = 0;
+
+  for (Command const& command : step.commands)
+  {
+    switch (command.kind)
+    {
+      case Command::Kind::CreateNode: ++created;      break;
+      case Command::Kind::RemoveNode: ++removed;      break;
+      case Command::Kind::Connect:    ++connected;    break;
+      case Command::Kind::Disconnect: ++disconnected; break;
+      case Command::Kind::Move:       ++moved;        break;
+      case Command::Kind::ModelState: ++changed;      break;
+    }
+  }
+
+  auto text = [](int count, char const* one, char const* many)
+  {
+    return count == 1 ? tr(one) : tr(many).arg(count);
+  };
+
+  if (removed > 0)
+    return text(removed, "Delete Node", "Delete %1 Nodes");
+
+  if (created > 0)
+    return text(created, "Create Node", "Create %1 Nodes");
+
+  if (connected > 0)
+    return text(connected, "Connect Nodes", "Make %1 Connections");
+
+  if (disconnected > 0)
+    return text(disconnected, "Delete Connection", "Delete %1 Connections");
+
+  if (changed > 0)
+    return text(changed, "Change Node", "Change %1 Nodes");
+
+  return text(moved, "Move Node", "Move %1 Nodes");
+}
@@ -0,0 +1,612 @@
+#include "SceneJournal.hpp"
+
+#include <stdexcept>
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QFile>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QSaveFile>
+
+#include "Node.hpp"
+#include "NodeDataModel.hpp"
+#include "Connection.hpp"
+#include "SceneHistory.hpp"
+
+using QtNodes::SceneJournal;
+using QtNodes::SceneFormat;
+using QtNodes::FlowScene;
+using QtNodes::Node;
+using QtNodes::Connection;
+
+namespace
+{
+
+// Forwards the writes to another device, hashing them on the way.
+class HashingWriter : public QIODevice
+{
+public:
+
+  explicit
+  HashingWriter(QIODevice& target)
+    : _target(target)
+    , _hash(QCryptographicHash::Sha1)
+  {}
+
+  QByteArray
+  result() const { return _hash.result(); }
+
+protected:
+
+  qint64
+  readData(char*, qint64) override { return -1; }
+
+  qint64
+  writeData(char const* data, qint64 size) override
+  {
+    qint64 const written = _target.write(data, size);
+
+    if (written > 0)
+      _hash.addData(data, int(written));
+
+    return written;
+  }
+
+private:
+
+  QIODevice& _target;
+
+  QCryptographicHash _hash;
+};
+
+
+QByteArray
+line(QJsonObject const& record)
+{
+  return QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n';
+}
+
+
+QJsonObject
+snapshotRecord(QByteArray const& hash)
+{
+  QJsonObject record;
+
+  record["op"]   = QStringLiteral("snapshot");
+  record["sha1"] = QString::fromLatin1(hash.toHex());
+
+  return record;
+}
+}
+
+
+SceneJournal::
+SceneJournal(FlowScene& scene,
+             QString const& snapshotFileName,
+             QObject* parent)
+  : QObject(parent)
+  , _scene(scene)
+  , _snapshotFileName(snapshotFileName)
+  , _snapshotFormat(SceneFormat::Json)
+  , _compactionThreshold(10000)
+  , _journalRecords(0)
+  , _journalStarted(false)
+  , _snapshotHashKnown(false)
+  , _replaying(false)
+{
+  connect(&_scene, &FlowScene::nodeCreated, this, &SceneJournal::onNodeCreated);
+  connect(&_scene, &FlowScene::nodeDeleted, this, &SceneJournal::onNodeDeleted);
+  connect(&_scene, &FlowScene::nodeMoved, this, &SceneJournal::onNodeMoved);
+  connect(&_scene, &FlowScene::connectionCreated, this, &SceneJournal::onConnectionCreated);
+  connect(&_scene, &FlowScene::connectionDeleted, this, &SceneJournal::onConnectionDeleted);
+
+  connect(&_autosaveTimer, &QTimer::timeout, this, [this]() { flush(); });
+}
+
+
+SceneJournal::
+~SceneJournal() = default;
+
+
+QString
+SceneJournal::
+snapshotFileName() const
+{
+  return _snapshotFileName;
+}
+
+
+QString
+SceneJournal::
+journalFileName() const
+{
+  return _snapshotFileName + QStringLiteral(".journal");
+}
+
+
+void
+SceneJournal::
+setSnapshotFormat(SceneFormat format)
+{
+  _snapshotFormat = format;
+}
+
+
+SceneFormat
+SceneJournal::
+snapshotFormat() const
+{
+  return _snapshotFormat;
+}
+
+
+void
+SceneJournal::
+setAutosaveInterval(int msec)
+{
+  if (msec > 0)
+    _autosaveTimer.start(msec);
+  else
+    _autosaveTimer.stop();
+}
+
+
+int
+SceneJournal::
+autosaveInterval() const
+{
+  return _autosaveTimer.isActive() ? _autosaveTimer.interval() : 0;
+}
+
+
+void
+SceneJournal::
+setCompactionThreshold(int records)
+{
+  _compactionThreshold = records;
+}
+
+
+int
+SceneJournal::
+compactionThreshold() const
+{
+  return _compactionThreshold;
+}
+
+
+bool
+SceneJournal::
+hasPendingChanges() const
+{
+  return !_pendingRecords.empty() ||
+         !_pendingMoves.empty() ||
+         !_pendingModelStates.empty();
+}
+
+
+int
+SceneJournal::
+journalRecordCount() const
+{
+  return _journalRecords;
+}
+
+
+int
+SceneJournal::
+recover()
+{
+  _replaying = true;
+
+  // the recovered document starts a new history
+  bool const recording = _scene.history().isEnabled();
+
+  _scene.history().setEnabled(false);
+
+  _pendingRecords.clear();
+  _pendingMoves.clear();
+  _pendingModelStates.clear();
+
+  int replayed = 0;
+
+  try
+  {
+    _scene.clearScene();
+
+    QByteArray snapshotHash;
+
+    QFile snapshot(_snapshotFileName);
+
+    if (snapshot.exists())
+    {
+      if (!snapshot.open(QIODevice::ReadOnly))
+        throw std::logic_error("Scene journal: can't read the snapshot");
+
+      QCryptographicHash hash(QCryptographicHash::Sha1);
+      hash.addData(&snapshot);
+      snapshotHash = hash.result();
+
+      snapshot.seek(0);
+      _scene.loadFromDevice(snapshot);
+    }
+
+    _snapshotHash      = snapshotHash;
+    _snapshotHashKnown = true;
+    _journalStarted    = false;
+
+    QFile journal(journalFileName());
+
+    if (journal.open(QIODevice::ReadOnly))
+    {
+      QByteArray const header = journal.readLine();
+
+      bool const current =
+        header.endsWith('\n') &&
+        QJsonDocument::fromJson(header).object() == snapshotRecord(snapshotHash);
+
+      // a stale journal is replaced by the next flush
+      if (current)
+      {
+        _journalStarted = true;
+
+        qint64 validEnd = journal.pos();
+
+        _scene.setDataPropagationDeferred(true);
+
+        while (!journal.atEnd())
+        {
+          QByteArray const text = journal.readLine();
+
+          QJsonParseError error;
+          QJsonDocument const document = QJsonDocument::fromJson(text, &error);
+
+          if (!text.endsWith('\n') ||
+              error.error != QJsonParseError::NoError ||
+              !document.isObject())
+            break;
+
+          replay(document.object());
+
+          validEnd = journal.pos();
+          ++replayed;
+        }
+
+        _scene.setDataPropagationDeferred(false);
+
+        if (validEnd < journal.size())
+        {
+          journal.close();
+          QFile::resize(journalFileName(), validEnd);
+        }
+      }
+    }
+  }
+  catch (...)
+  {
+    _scene.setDataPropagationDeferred(false);
+    _scene.history().setEnabled(recording);
+    _scene.history().clear();
+    _replaying = false;
+    throw;
+  }
+
+  // the moves the scene reports later are those of the replay
+  _scene.flushPendingUpdates();
+
+  _scene.history().setEnabled(recording);
+  _scene.history().clear();
+
+  _replaying = false;
+
+  _journalRecords = replayed;
+
+  return replayed;
+}
+
+
+void
+SceneJournal::
+recordModelState(Node const& node)
+{
+  if (!_replaying)
+    _pendingModelStates.insert(node.id());
+}
+
+
+bool
+SceneJournal::
+flush()
+{
+  auto const & nodes = _scene.nodes();
+
+  QByteArray data;
+  int records = 0;
+
+  for (QJsonObject record : _pendingRecords)
+  {
+    if (record["op"].toString() == QLatin1String("createNode"))
+    {
+      auto it = nodes.find(QUuid(record["id"].toString()));
+
+      // deleted since, its deletion follows
+      if (it == nodes.end())
+        continue;
+
+      record.remove("id");
+      record["node"] = it->second->save();
+    }
+
+    data += line(record);
+    ++records;
+  }
+
+  for (auto const & pair : _pendingMoves)
+  {
+    QJsonObject record;
+    record["op"] = QStringLiteral("moveNode");
+    record["id"] = pair.first.toString();
+    record["x"]  = pair.second.x();
+    record["y"]  = pair.second.y();
+
+    data += line(record);
+    ++records;
+  }
+
+  for (QUuid const& id : _pendingModelStates)
+  {
+    auto it = nodes.find(id);
+
+    if (it == nodes.end())
+      continue;
+
+    QJsonObject record;
+    record["op"]    = QStringLiteral("modelState");
+    record["id"]    = id.toString();
+    record["model"] = it->second->nodeDataModel()->save();
+
+    data += line(record);
+    ++records;
+  }
+
+  if (records == 0)
+    return true;
+
+  if (!_journalStarted && !startJournal())
+    return false;
+
+  QFile journal(journalFileName());
+
+  if (!journal.open(QIODevice::WriteOnly | QIODevice::Append))
+    return false;
+
+  qint64 const start = journal.size();
+
+  if (journal.write(data) != data.size() || !journal.flush())
+  {
+    // a partial record would end the replay early
+    journal.resize(start);
+    return false;
+  }
+
+  journal.close();
+
+  _pendingRecords.clear();
+  _pendingMoves.clear();
+  _pendingModelStates.clear();
+
+  _journalRecords += records;
+
+  if (_compactionThreshold > 0 && _journalRecords >= _compactionThreshold)
+    return compact();
+
+  return true;
+}
+
+
+bool
+SceneJournal::
+compact()
+{
+  QSaveFile snapshot(_snapshotFileName);
+
+  if (!snapshot.open(QIODevice::WriteOnly))
+    return false;
+
+  HashingWriter writer(snapshot);
+  writer.open(QIODevice::WriteOnly);
+
+  if (!_scene.saveToDevice(writer, _snapshotFormat) || !snapshot.commit())
+    return false;
+
+  // everything is in the snapshot now
+  _pendingRecords.clear();
+  _pendingMoves.clear();
+  _pendingModelStates.clear();
+
+  _snapshotHash      = writer.result();
+  _snapshotHashKnown = true;
+  _journalStarted    = false;
+  _journalRecords    = 0;
+
+  return startJournal();
+}
+
+
+void
+SceneJournal::
+onNodeCreated(Node& node)
+{
+  if (_replaying)
+    return;
+
+  // saved when flushed: a created node gets its position
+  // and model state after the signal
+  QJsonObject record;
+  record["op"] = QStringLiteral("createNode");
+  record["id"] = node.id().toString();
+
+  _pendingRecords.push_back(record);
+}
+
+
+void
+SceneJournal::
+onNodeDeleted(Node& node)
+{
+  if (_replaying)
+    return;
+
+  QJsonObject record;
+  record["op"] = QStringLiteral("deleteNode");
+  record["id"] = node.id().toString();
+
+  _pendingRecords.push_back(record);
+
+  _pendingMoves.erase(node.id());
+  _pendingModelStates.erase(node.id());
+}
+
+
+void
+SceneJournal::
+onNodeMoved(Node& node, QPointF const& position)
+{
+  if (!_replaying)
+    _pendingMoves[node.id()] = position;
+}
+
+
+void
+SceneJournal::
+onConnectionCreated(Connection const& connection)
+{
+  if (_replaying)
+    return;
+
+  QJsonObject record;
+  record["op"]         = QStringLiteral("createConnection");
+  record["connection"] = connection.save();
+
+  _pendingRecords.push_back(record);
+}
+
+
+void
+SceneJournal::
+onConnectionDeleted(Connection const& connection)
+{
+  if (_replaying)
+    return;
+
+  QJsonObject record;
+  record["op"]         = QStringLiteral("deleteConnection");
+  record["connection"] = connection.save();
+
+  _pendingRecords.push_back(record);
+}
+
+
+bool
+SceneJournal::
+startJournal()
+{
+  if (!_snapshotHashKnown)
+  {
+    QFile snapshot(_snapshotFileName);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    if (snapshot.open(QIODevice::ReadOnly))
+      hash.addData(&snapshot);
+
+    _snapshotHash      = snapshot.isOpen() ? hash.result() : QByteArray();
+    _snapshotHashKnown = true;
+  }
+
+  QSaveFile journal(journalFileName());
+
+  if (!journal.open(QIODevice::WriteOnly))
+    return false;
+
+  QByteArray const header = line(snapshotRecord(_snapshotHash));
+
+  if (journal.write(header) != header.size() || !journal.commit())
+    return false;
+
+  _journalStarted = true;
+  _journalRecords = 0;
+
+  return true;
+}
+
+
+void
+SceneJournal::
+replay(QJsonObject const& record)
+{
+  QString const op = record["op"].toString();
+
+  auto const & nodes = _scene.nodes();
+
+  auto findNode = [&](QJsonValue const& id) -> Node*
+  {
+    auto it = nodes.find(QUuid(id.toString()));
+
+    return it != nodes.end() ? it->second.get() : nullptr;
+  };
+
+  // The records may describe a state the scene already has,
+  // replaying them again changes nothing.
+  if (op == QLatin1String("createNode"))
+  {
+    QJsonObject const nodeJson = record["node"].toObject();
+
+    if (!findNode(nodeJson["id"]))
+      _scene.restoreNode(nodeJson);
+  }
+  else if (op == QLatin1String("deleteNode"))
+  {
+    if (Node* node = findNode(record["id"]))
+      _scene.removeNode(*node);
+  }
+  else if (op == QLatin1String("moveNode"))
+  {
+    if (Node* node = findNode(record["id"]))
+      _scene.setNodePosition(*node, QPointF(record["x"].toDouble(),
+                                            record["y"].toDouble()));
+  }
+  else if (op == QLatin1String("modelState"))
+  {
+    if (Node* node = findNode(record["id"]))
+      node->nodeDataModel()->restore(record["model"].toObject());
+  }
+  else if (op == QLatin1String("createConnection"))
+  {
+    QJsonObject const connectionJson = record["connection"].toObject();
+
+    if (findNode(connectionJson["in_id"]) &&
+        findNode(connectionJson["out_id"]) &&
+        !findConnection(connectionJson))
+      _scene.restoreConnection(connectionJson);
+  }
+  else if (op == QLatin1String("deleteConnection"))
+  {
+    if (Connection* connection = findConnection(record["connection"].toObject()))
+      _scene.deleteConnection(*connection);
+  }
+  else
+  {
+    throw std::logic_error("Scene journal: unknown record");
+  }
+}
+
+
+Connection*
+SceneJournal::
+findConnection(QJsonObject const& connectionJson) const
+{
+  return _scene.findConnection(QUuid(connectionJson["in_id"].toString()),
+                               connectionJson["in_index"].toInt(),
+                               QUuid(connectionJson["out_id"].toString()),
+                               connectionJson["out_index"].toInt());
+}
@@ -0,0 +1,371 @@
+#include "SceneJsonStream.hpp"
+
+#include <stdexcept>
+
+#include <QtCore/QIODevice>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonParseError>
+
+#include "SceneDeviceWait.hpp"
+
+using QtNodes::JsonSceneStreamWriter;
+using QtNodes::JsonSceneStreamReader;
+using QtNodes::waitForSceneData;
+
+namespace
+{
+
+// read granularity; the memory used by the reader is this
+// plus the text of the largest element
+int const ChunkSize = 1 << 16;
+
+QByteArray const Indent = QByteArrayLiteral("    ");
+}
+
+
+JsonSceneStreamWriter::
+JsonSceneStreamWriter(QIODevice &device)
+  : _device(device)
+  , _firstElement(true)
+  , _ok(true)
+{}
+
+
+void
+JsonSceneStreamWriter::
+beginNodes()
+{
+  write(QByteArrayLiteral("{\n") + Indent + QByteArrayLiteral("\"nodes\": ["));
+
+  _firstElement = true;
+}
+
+
+void
+JsonSceneStreamWriter::
+writeNode(QJsonObject const &nodeJson)
+{
+  writeElement(nodeJson);
+}
+
+
+void
+JsonSceneStreamWriter::
+beginConnections()
+{
+  write(QByteArrayLiteral("\n") + Indent +
+        QByteArrayLiteral("],\n") + Indent +
+        QByteArrayLiteral("\"connections\": ["));
+
+  _firstElement = true;
+}
+
+
+void
+JsonSceneStreamWriter::
+writeConnection(QJsonObject const &connectionJson)
+{
+  writeElement(connectionJson);
+}
+
+
+void
+JsonSceneStreamWriter::
+end()
+{
+  write(QByteArrayLiteral("\n") + Indent + QByteArrayLiteral("]\n}\n"));
+}
+
+
+void
+JsonSceneStreamWriter::
+writeElement(QJsonObject const &json)
+{
+  QByteArray element = _firstElement ? QByteArrayLiteral("\n") : QByteArrayLiteral(",\n");
+
+  element += Indent;
+  element += Indent;
+  element += QJsonDocument(json).toJson(QJsonDocument::Compact);
+
+  write(element);
+
+  _firstElement = false;
+}
+
+
+void
+JsonSceneStreamWriter::
+write(QByteArray const &bytes)
+{
+  if (_ok && _device.write(bytes) != bytes.size())
+    _ok = false;
+}
+
+//------------------------------------------------------------------------------
+
+JsonSceneStreamReader::
+JsonSceneStreamReader(QIODevice &device)
+  : _device(device)
+  , _pos(0)
+  , _consumed(0)
+{}
+
+
+void
+JsonSceneStreamReader::
+read(std::function<void(Array, QJsonObject const&)> const &onElement,
+     std::function<void(Array)> const &onArrayEnd)
+{
+  skipWhitespace();
+  expect('{');
+
+  skipWhitespace();
+
+  if (peek() == '}')
+  {
+    get();
+    return;
+  }
+
+  for (;;)
+  {
+    QString const key = readKey();
+
+    skipWhitespace();
+    expect(':');
+    skipWhitespace();
+
+    bool const isArray = (peek() == '[');
+
+    if (isArray && (key == QLatin1String("nodes") ||
+                    key == QLatin1String("connections")))
+    {
+      Array const array =
+        (key == QLatin1String("nodes")) ? Array::Nodes : Array::Connections;
+
+      get();
+      skipWhitespace();
+
+      if (peek() == ']')
+      {
+        get();
+      }
+      else
+      {
+        QByteArray element;
+
+        for (;;)
+        {
+          element.clear();
+
+          readValue(&element);
+
+          QJsonParseError error;
+          QJsonDocument const document = QJsonDocument::fromJson(element, &error);
+
+          if (error.error != QJsonParseError::NoError || !document.isObject())
+            throw std::logic_error("JSON scene: malformed element");
+
+          onElement(array, document.object());
+
+          skipWhitespace();
+
+          char const c = get();
+
+          if (c == ']')
+            break;
+
+          if (c != ',')
+            throw std::logic_error("JSON scene: expected ',' or ']'");
+
+          skipWhitespace();
+        }
+      }
+
+      onArrayEnd(array);
+    }
+    else
+    {
+      // unknown members are skipped without being kept
+      readValue(nullptr);
+    }
+
+    skipWhitespace();
+
+    char const c = get();
+
+    if (c == '}')
+      return;
+
+    if (c != ',')
+      throw std::logic_error("JSON scene: expected ',' or '}'");
+
+    skipWhitespace();
+  }
+}
+
+
+bool
+JsonSceneStreamReader::
+fill()
+{
+  _consumed += _buffer.size();
+
+  _buffer = _device.read(ChunkSize);
+  _pos    = 0;
+
+  if (_buffer.isEmpty() && waitForSceneData(_device))
+    _buffer = _device.read(ChunkSize);
+
+  return !_buffer.isEmpty();
+}
+
+
+char
+JsonSceneStreamReader::
+peek()
+{
+  if (_pos == _buffer.size() && !fill())
+    throw std::logic_error("JSON scene: unexpected end of data");
+
+  return _buffer.at(_pos);
+}
+
+
+char
+JsonSceneStreamReader::
+get()
+{
+  char const c = peek();
+
+  ++_pos;
+
+  return c;
+}
+
+
+void
+JsonSceneStreamReader::
+skipWhitespace()
+{
+  for (;;)
+  {
+    char const c = peek();
+
+    if (c != ' ' && c != '\n' && c != '\r' && c != '\t')
+      return;
+
+    ++_pos;
+  }
+}
+
+
+void
+JsonSceneStreamReader::
+expect(char c)
+{
+  if (get() != c)
+    throw std::logic_error(std::string("JSON scene: expected '") + c + "'");
+}
+
+
+void
+JsonSceneStreamReader::
+readValue(QByteArray *out)
+{
+  char const first = peek();
+
+  if (first == '"')
+  {
+    readString(out);
+    return;
+  }
+
+  if (first != '{' && first != '[')
+  {
+    // numbers, true, false and null
+    for (;;)
+    {
+      char const c = peek();
+
+      if (c == ',' || c == '}' || c == ']' ||
+          c == ' ' || c == '\n' || c == '\r' || c == '\t')
+        return;
+
+      if (out)
+        out->append(c);
+
+      ++_pos;
+    }
+  }
+
+  int depth = 0;
+
+  do
+  {
+    char const c = peek();
+
+    if (c == '"')
+    {
+      readString(out);
+      continue;
+    }
+
+    if (c == '{' || c == '[')
+      ++depth;
+    else if (c == '}' || c == ']')
+      --depth;
+
+    if (out)
+      out->append(c);
+
+    ++_pos;
+  }
+  while (depth > 0);
+}
+
+
+void
+JsonSceneStreamReader::
+readString(QByteArray *out)
+{
+  expect('"');
+
+  if (out)
+    out->append('"');
+
+  for (;;)
+  {
+    char const c = get();
+
+    if (out)
+      out->append(c);
+
+    if (c == '"')
+      return;
+
+    if (c == '\\')
+    {
+      char const escaped = get();
+
+      if (out)
+        out->append(escaped);
+    }
+  }
+}
+
+
+QString
+JsonSceneStreamReader::
+readKey()
+{
+  QByteArray key;
+
+  readString(&key);
+
+  // lets Qt resolve the escapes
+  QJsonDocument const document = QJsonDocument::fromJson("[" + key + "]");
+
+  return document.array().at(0).toString();
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <functional>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QJsonObject>
+
+class QIODevice;
+
+namespace QtNodes
+{
+
+/// Writes the JSON scene document one node or connection at a time,
+/// nodes first so that a streaming reader can restore connections as
+/// soon as it meets them. The output is the document saveToMemory()
+/// writes, with every element on a single line.
+class JsonSceneStreamWriter
+{
+public:
+
+  JsonSceneStreamWriter(QIODevice &device);
+
+public:
+
+  void
+  beginNodes();
+
+  void
+  writeNode(QJsonObject const &nodeJson);
+
+  void
+  beginConnections();
+
+  void
+  writeConnection(QJsonObject const &connectionJson);
+
+  void
+  end();
+
+  /// False once a write to the device has failed.
+  bool
+  ok() const { return _ok; }
+
+private:
+
+  void
+  writeElement(QJsonObject const &json);
+
+  void
+  write(QByteArray const &bytes);
+
+private:
+
+  QIODevice &_device;
+
+  bool _firstElement;
+
+  bool _ok;
+};
+
+
+/// Reads a JSON scene document from a device without building it in
+/// memory: the top level object is scanned and only the elements of the
+/// "nodes" and "connections" arrays are parsed, one at a time.
+/// Malformed input throws std::logic_error.
+class JsonSceneStreamReader
+{
+public:
+
+  enum class Array
+  {
+    Nodes,
+    Connections
+  };
+
+public:
+
+  JsonSceneStreamReader(QIODevice &device);
+
+public:
+
+  /// Calls `onElement` for every element in document order and
+  /// `onArrayEnd` after the last element of each of the two arrays.
+  void
+  read(std::function<void(Array, QJsonObject const&)> const &onElement,
+       std::function<void(Array)> const &onArrayEnd);
+
+  /// Bytes consumed from the device so far.
+  qint64
+  bytesRead() const { return _consumed + _pos; }
+
+private:
+
+  bool
+  fill();
+
+  char
+  peek();
+
+  char
+  get();
+
+  void
+  skipWhitespace();
+
+  void
+  expect(char c);
+
+  /// Reads one JSON value, appending its text to `out` if given.
+  void
+  readValue(QByteArray *out);
+
+  void
+  readString(QByteArray *out);
+
+  QString
+  readKey();
+
+private:
+
+  QIODevice &_device;
+
+  QByteArray _buffer;
+
+  int _pos;
+
+  // bytes of the previous buffers
+  qint64 _consumed;
+};
+}
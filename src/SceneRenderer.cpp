@@ -0,0 +1,546 @@
+#include "SceneRenderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtGui/QPainter>
+#include <QtGui/QPicture>
+#include <QtWidgets/QWidget>
+
+#include "Connection.hpp"
+#include "ConnectionGeometry.hpp"
+#include "ConnectionGraphicsObject.hpp"
+#include "ConnectionPainter.hpp"
+#include "FlowScene.hpp"
+#include "Node.hpp"
+#include "NodeDataModel.hpp"
+#include "NodeGeometry.hpp"
+#include "NodePainter.hpp"
+#include "PngStreamWriter.hpp"
+#include "StyleCollection.hpp"
+
+using QtNodes::SceneRenderer;
+using QtNodes::FlowScene;
+using QtNodes::Node;
+using QtNodes::Connection;
+using QtNodes::ConnectionPainter;
+using QtNodes::NodePainter;
+using QtNodes::PngStreamWriter;
+using QtNodes::PortType;
+using QtNodes::StyleCollection;
+
+namespace
+{
+
+// empty space around the items when the scene rect is not given
+double const SceneMargin = 20.0;
+
+struct RecordedItem
+{
+  QPicture picture;
+
+  // item position and bounds in the scene
+  QPointF offset;
+  QRectF  sceneRect;
+
+  // QPicture playback is not reentrant
+  std::mutex mutex;
+};
+
+using RecordedItems = std::vector<std::unique_ptr<RecordedItem>>;
+
+
+struct Recording
+{
+  // connections first, they are drawn below the nodes
+  RecordedItems items;
+
+  QRectF sceneRect;
+  QSize  outputSize;
+  QSize  tileSize;
+  QSize  grid;
+
+  // item indices for each row of tiles
+  std::vector<std::vector<RecordedItem const*>> rows;
+};
+
+
+RecordedItems
+recordItems(FlowScene &scene)
+{
+  RecordedItems items;
+
+  // Painting needs the graphics objects, the ones created only
+  // for the recording are released afterwards.
+  std::vector<Node*>       createdNodes;
+  std::vector<Connection*> createdConnections;
+
+  for (auto const & pair : scene.connections())
+  {
+    if (!pair.second->hasGraphicsObject())
+      createdConnections.push_back(pair.second.get());
+  }
+
+  RecordedItems nodeItems;
+
+  for (auto const & pair : scene.nodes())
+  {
+    Node &node = *pair.second;
+
+    if (!node.hasGraphicsObject())
+      createdNodes.push_back(&node);
+
+    auto item = QtNodes::detail::make_unique<RecordedItem>();
+
+    QPainter painter(&item->picture);
+
+    NodePainter::paint(&painter, node, scene);
+
+    if (auto w = node.nodeDataModel()->embeddedWidget())
+    {
+      w->render(&painter,
+                node.nodeGeometry().widgetPosition().toPoint(),
+                QRegion(),
+                QWidget::DrawChildren);
+    }
+
+    painter.end();
+
+    item->offset    = node.position();
+    item->sceneRect = node.nodeGeometry().boundingRect().translated(item->offset);
+
+    nodeItems.push_back(std::move(item));
+  }
+
+  for (auto const & pair : scene.connections())
+  {
+    Connection &connection = *pair.second;
+
+    if (!connection.complete())
+      continue;
+
+    auto const &cgo = connection.getConnectionGraphicsObject();
+
+    auto item = QtNodes::detail::make_unique<RecordedItem>();
+
+    QPainter painter(&item->picture);
+
+    ConnectionPainter::paint(&painter, connection);
+
+    painter.end();
+
+    item->offset    = cgo.pos();
+    item->sceneRect = cgo.mapRectToScene(cgo.boundingRect());
+
+    items.push_back(std::move(item));
+  }
+
+  std::move(nodeItems.begin(), nodeItems.end(), std::back_inserter(items));
+
+  for (Node* node : createdNodes)
+    node->releaseGraphicsObject();
+
+  for (Connection* connection : createdConnections)
+  {
+    if (!connection->getNode(PortType::In)->hasGraphicsObject() &&
+        !connection->getNode(PortType::Out)->hasGraphicsObject())
+    {
+      connection->releaseGraphicsObject();
+    }
+  }
+
+  return items;
+}
+
+
+Recording
+record(FlowScene &scene,
+       QRectF const &sceneRect,
+       double scale,
+       QSize const &tileSize)
+{
+  // every render starts here, see the class comment
+  Q_ASSERT(QThread::currentThread() == QCoreApplication::instance()->thread());
+
+  Recording recording;
+
+  recording.items = recordItems(scene);
+
+  recording.sceneRect = sceneRect;
+
+  if (recording.sceneRect.isEmpty())
+  {
+    for (auto const & item : recording.items)
+      recording.sceneRect = recording.sceneRect.united(item->sceneRect);
+
+    recording.sceneRect.adjust(-SceneMargin, -SceneMargin, SceneMargin, SceneMargin);
+  }
+
+  recording.outputSize = QSize(int(std::ceil(recording.sceneRect.width() * scale)),
+                               int(std::ceil(recording.sceneRect.height() * scale)));
+
+  recording.tileSize = tileSize;
+
+  recording.grid = QSize((recording.outputSize.width() + tileSize.width() - 1) / tileSize.width(),
+                         (recording.outputSize.height() + tileSize.height() - 1) / tileSize.height());
+
+  recording.rows.resize(recording.grid.height());
+
+  double const rowExtent = tileSize.height() / scale;
+
+  for (auto const & item : recording.items)
+  {
+    QRectF const r = item->sceneRect.intersected(recording.sceneRect);
+
+    if (r.isEmpty())
+      continue;
+
+    int const firstRow = int((r.top() - recording.sceneRect.top()) / rowExtent);
+    int const lastRow  = int((r.bottom() - recording.sceneRect.top()) / rowExtent);
+
+    for (int row = std::max(firstRow, 0);
+         row <= std::min(lastRow, recording.grid.height() - 1);
+         ++row)
+    {
+      recording.rows[row].push_back(item.get());
+    }
+  }
+
+  return recording;
+}
+
+
+/// Results of the tile jobs, consumed in order by the rendering thread.
+struct TileQueue
+{
+  std::mutex              mutex;
+  std::condition_variable ready;
+
+  std::vector<QImage> images;
+  std::vector<bool>   done;
+
+  int finished = 0;
+};
+
+
+class TileJob : public QRunnable
+{
+public:
+
+  TileJob(Recording const &recording,
+          TileQueue &queue,
+          int index,
+          double scale,
+          QColor const &background)
+    : _recording(recording)
+    , _queue(queue)
+    , _index(index)
+    , _scale(scale)
+    , _background(background)
+  {}
+
+  void
+  run() override
+  {
+    int const columns = _recording.grid.width();
+
+    int const row    = _index / columns;
+    int const column = _index % columns;
+
+    QPoint const offset(column * _recording.tileSize.width(),
+                        row * _recording.tileSize.height());
+
+    QSize const size =
+      _recording.tileSize.boundedTo(QSize(_recording.outputSize.width() - offset.x(),
+                                          _recording.outputSize.height() - offset.y()));
+
+    QRectF const tileRect(_recording.sceneRect.topLeft() + QPointF(offset) / _scale,
+                          QSizeF(size) / _scale);
+
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(_background);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+    painter.scale(_scale, _scale);
+    painter.translate(-tileRect.topLeft());
+
+    for (RecordedItem const* item : _recording.rows[row])
+    {
+      if (!item->sceneRect.intersects(tileRect))
+        continue;
+
+      std::lock_guard<std::mutex> lock(const_cast<RecordedItem*>(item)->mutex);
+
+      painter.save();
+      painter.translate(item->offset);
+      painter.drawPicture(0, 0, item->picture);
+      painter.restore();
+    }
+
+    painter.end();
+
+    {
+      std::lock_guard<std::mutex> lock(_queue.mutex);
+
+      _queue.images[_index] = std::move(image);
+      _queue.done[_index]   = true;
+
+      ++_queue.finished;
+    }
+
+    _queue.ready.notify_all();
+  }
+
+private:
+
+  Recording const &_recording;
+
+  TileQueue &_queue;
+
+  int _index;
+
+  double _scale;
+
+  QColor _background;
+};
+
+
+bool
+renderTiles(Recording const &recording,
+            double scale,
+            QColor const &background,
+            QThreadPool &pool,
+            SceneRenderer::TileSink const &sink)
+{
+  int const total = recording.grid.width() * recording.grid.height();
+
+  if (total == 0)
+    return true;
+
+  TileQueue queue;
+  queue.images.resize(total);
+  queue.done.resize(total, false);
+
+  // bounds the number of tiles held in memory
+  int const maxInFlight = std::max(2, 2 * pool.maxThreadCount());
+
+  int submitted = 0;
+
+  auto submit =
+    [&]()
+    {
+      if (submitted < total)
+        pool.start(new TileJob(recording, queue, submitted++, scale, background));
+    };
+
+  while (submitted < std::min(total, maxInFlight))
+    submit();
+
+  bool completed = true;
+
+  for (int index = 0; index < total; ++index)
+  {
+    SceneRenderer::Tile tile;
+
+    {
+      std::unique_lock<std::mutex> lock(queue.mutex);
+
+      queue.ready.wait(lock, [&] { return queue.done[index]; });
+
+      tile.image = std::move(queue.images[index]);
+      queue.images[index] = QImage();
+    }
+
+    submit();
+
+    tile.row    = index / recording.grid.width();
+    tile.column = index % recording.grid.width();
+    tile.offset = QPoint(tile.column * recording.tileSize.width(),
+                         tile.row * recording.tileSize.height());
+
+    if (!sink(tile))
+    {
+      completed = false;
+      break;
+    }
+  }
+
+  // the jobs refer to the queue and the recording
+  std::unique_lock<std::mutex> lock(queue.mutex);
+  queue.ready.wait(lock, [&] { return queue.finished == submitted; });
+
+  return completed;
+}
+
+}
+
+
+SceneRenderer::
+SceneRenderer(FlowScene &scene)
+  : _scene(scene)
+  , _scale(1.0)
+  , _tileSize(1024, 1024)
+  , _backgroundColor(StyleCollection::flowViewStyle().BackgroundColor)
+  , _threadPool(QThreadPool::globalInstance())
+{}
+
+
+void
+SceneRenderer::
+setSceneRect(QRectF const &rect)
+{
+  _sceneRect = rect;
+}
+
+
+void
+SceneRenderer::
+setScale(double scale)
+{
+  _scale = scale;
+}
+
+
+void
+SceneRenderer::
+setTileSize(QSize const &size)
+{
+  _tileSize = size.expandedTo(QSize(1, 1));
+}
+
+
+void
+SceneRenderer::
+setBackgroundColor(QColor const &color)
+{
+  _backgroundColor = color;
+}
+
+
+void
+SceneRenderer::
+setThreadPool(QThreadPool *pool)
+{
+  _threadPool = pool ? pool : QThreadPool::globalInstance();
+}
+
+
+bool
+SceneRenderer::
+render(TileSink const &sink)
+{
+  Recording const recording = record(_scene, _sceneRect, _scale, _tileSize);
+
+  return renderTiles(recording, _scale, _backgroundColor, *_threadPool, sink);
+}
+
+
+bool
+SceneRenderer::
+renderToPng(QIODevice &device)
+{
+  Recording const recording = record(_scene, _sceneRect, _scale, _tileSize);
+
+  if (recording.outputSize.isEmpty())
+    return false;
+
+  PngStreamWriter writer(device, recording.outputSize);
+
+  if (!writer.begin())
+    return false;
+
+  int const columns = recording.grid.width();
+
+  // one row of tiles at a time is turned into scanlines
+  std::vector<QImage> row;
+  row.reserve(columns);
+
+  QByteArray scanline(recording.outputSize.width() * 4, Qt::Uninitialized);
+
+  auto sink =
+    [&](Tile const &tile)
+    {
+      row.push_back(tile.image.convertToFormat(QImage::Format_RGBA8888));
+
+      if (int(row.size()) < columns)
+        return true;
+
+      int const height = row.front().height();
+
+      for (int y = 0; y < height; ++y)
+      {
+        char* out = scanline.data();
+
+        for (QImage const &image : row)
+        {
+          int const bytes = image.width() * 4;
+
+          std::copy_n(reinterpret_cast<char const*>(image.constScanLine(y)), bytes, out);
+
+          out += bytes;
+        }
+
+        if (!writer.writeScanline(reinterpret_cast<uchar const*>(scanline.constData())))
+          return false;
+      }
+
+      row.clear();
+
+      return true;
+    };
+
+  if (!renderTiles(recording, _scale, _backgroundColor, *_threadPool, sink))
+    return false;
+
+  return writer.finish();
+}
+
+
+bool
+SceneRenderer::
+renderToPng(QString const &fileName)
+{
+  QFile file(fileName);
+
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+
+  return renderToPng(file);
+}
+
+
+bool
+SceneRenderer::
+renderToTileFiles(QString const &directory, QString const &baseName)
+{
+  QDir const dir(directory);
+
+  if (!dir.exists() && !QDir().mkpath(directory))
+    return false;
+
+  return render([&](Tile const &tile)
+  {
+    QString const fileName =
+      dir.filePath(QStringLiteral("%1_%2_%3.png")
+                   .arg(baseName)
+                   .arg(tile.row)
+                   .arg(tile.column));
+
+    return tile.image.save(fileName, "PNG");
+  });
+}
@@ -1,5 +1,7 @@
 #include "StyleCollection.hpp"
 
+#include <utility>
+
 using QtNodes::StyleCollection;
 using QtNodes::NodeStyle;
 using QtNodes::ConnectionStyle;
@@ -8,6 +10,14 @@ using QtNodes::FlowViewStyle;
 NodeStyle const&
 StyleCollection::
 nodeStyle()
+{
+  return *instance()._nodeStyle;
+}
+
+
+std::shared_ptr<NodeStyle const>
+StyleCollection::
+sharedNodeStyle()
 {
   return instance()._nodeStyle;
 }
@@ -33,7 +43,7 @@ void
 StyleCollection::
 setNodeStyle(NodeStyle nodeStyle)
 {
-  instance()._nodeStyle = nodeStyle;
+  instance()._nodeStyle = std::make_shared<NodeStyle const>(std::move(nodeStyle));
 }
 
 
@@ -0,0 +1,73 @@
+#include "TextLayoutCache.hpp"
+
+#include <QtCore/QHash>
+#include <QtGui/QFontMetrics>
+
+using QtNodes::TextLayoutCache;
+
+namespace
+{
+
+using TextLayouts = QHash<QString, TextLayoutCache::Layout>;
+
+// Every distinct caption, port label and message is stored once per font.
+// The table of a font is dropped when it grows over this limit.
+int const MaxLayoutsPerFont = 4096;
+
+QHash<QFont, TextLayouts> &
+layouts()
+{
+  static QHash<QFont, TextLayouts> cache;
+
+  return cache;
+}
+}
+
+
+TextLayoutCache::Layout
+TextLayoutCache::
+layout(QFont const &font, QString const &text)
+{
+  TextLayouts &fontLayouts = layouts()[font];
+
+  auto it = fontLayouts.constFind(text);
+
+  if (it != fontLayouts.constEnd())
+    return it.value();
+
+  if (fontLayouts.size() >= MaxLayoutsPerFont)
+    fontLayouts.clear();
+
+  QFontMetrics const metrics(font);
+
+  Layout layout;
+
+  layout.staticText.setText(text);
+  layout.staticText.setTextFormat(Qt::PlainText);
+  layout.staticText.setPerformanceHint(QStaticText::AggressiveCaching);
+  layout.staticText.prepare(QTransform(), font);
+
+  layout.boundingRect = metrics.boundingRect(text);
+  layout.advance      = metrics.width(text);
+  layout.ascent       = metrics.ascent();
+
+  fontLayouts.insert(text, layout);
+
+  return layout;
+}
+
+
+void
+TextLayoutCache::
+clear()
+{
+  layouts().clear();
+}
+
+
+int
+TextLayoutCache::
+size(QFont const &font)
+{
+  return layouts().value(font).size();
+}
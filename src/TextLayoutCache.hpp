@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QtCore/QRect>
+#include <QtCore/QString>
+#include <QtGui/QFont>
+#include <QtGui/QStaticText>
+
+#include "Export.hpp"
+
+namespace QtNodes
+{
+
+/// Shared cache of measured and laid out strings used by NodeGeometry
+/// and NodePainter. Entries are keyed by (font, string), so a change
+/// of either one is a cache miss; nothing has to be invalidated by hand.
+/// Must only be used from the GUI thread.
+class NODE_EDITOR_PUBLIC TextLayoutCache
+{
+public:
+
+  struct Layout
+  {
+    QStaticText staticText;
+
+    QRect boundingRect;
+
+    int advance;
+
+    int ascent;
+  };
+
+  static
+  Layout
+  layout(QFont const &font, QString const &text);
+
+  static
+  void
+  clear();
+
+  /// The number of layouts cached for the font.
+  static
+  int
+  size(QFont const &font);
+
+private:
+
+  TextLayoutCache() = delete;
+};
+}
@@ -0,0 +1,137 @@
+#include "ViewportUpdatePolicy.hpp"
+
+using QtNodes::ViewportUpdatePolicy;
+
+namespace
+{
+
+int const WindowFrames = 30;
+
+// windows that have to agree before switching
+int const StableWindows = 2;
+
+// windows in full or bounding rect update mode before measuring the
+// dirty regions again
+int const ProbeWindows = 10;
+
+double const FullUpdateDirtyFraction = 0.5;
+
+double const FragmentedDirtyRectCount = 16.0;
+
+double const CheapFrameMilliseconds = 2.0;
+
+}
+
+
+ViewportUpdatePolicy::
+ViewportUpdatePolicy()
+{
+  reset(QGraphicsView::MinimalViewportUpdate);
+}
+
+
+bool
+ViewportUpdatePolicy::
+addFrame(double paintMilliseconds,
+         double dirtyFraction,
+         int dirtyRectCount)
+{
+  ++_frames;
+
+  _paintMilliseconds += paintMilliseconds;
+  _dirtyFraction     += dirtyFraction;
+  _dirtyRectCount    += dirtyRectCount;
+
+  if (_frames < WindowFrames)
+    return false;
+
+  QGraphicsView::ViewportUpdateMode const previous = _mode;
+
+  bool const unmeasured = (_mode == QGraphicsView::FullViewportUpdate ||
+                           _mode == QGraphicsView::BoundingRectViewportUpdate);
+
+  if (unmeasured && ++_unmeasuredWindows >= ProbeWindows)
+  {
+    _mode = QGraphicsView::SmartViewportUpdate;
+  }
+  else if (_mode != QGraphicsView::FullViewportUpdate)
+  {
+    // the bounding rect is a single rect whatever the fragmentation
+    if (_mode != QGraphicsView::BoundingRectViewportUpdate)
+      _measuredDirtyRectCount = _dirtyRectCount / _frames;
+
+    QGraphicsView::ViewportUpdateMode const recommended =
+      recommendedMode(_paintMilliseconds / _frames,
+                      _dirtyFraction / _frames,
+                      _measuredDirtyRectCount);
+
+    if (recommended == _candidate)
+    {
+      ++_candidateWindows;
+    }
+    else
+    {
+      _candidate        = recommended;
+      _candidateWindows = 1;
+    }
+
+    if (_candidateWindows >= StableWindows)
+      _mode = _candidate;
+  }
+
+  if (_mode != previous)
+    _unmeasuredWindows = 0;
+
+  _frames            = 0;
+  _paintMilliseconds = 0.0;
+  _dirtyFraction     = 0.0;
+  _dirtyRectCount    = 0.0;
+
+  return _mode != previous;
+}
+
+
+QGraphicsView::ViewportUpdateMode
+ViewportUpdatePolicy::
+mode() const
+{
+  return _mode;
+}
+
+
+void
+ViewportUpdatePolicy::
+reset(QGraphicsView::ViewportUpdateMode mode)
+{
+  _mode = mode;
+
+  _frames            = 0;
+  _paintMilliseconds = 0.0;
+  _dirtyFraction     = 0.0;
+  _dirtyRectCount    = 0.0;
+
+  _candidate         = mode;
+  _candidateWindows  = 0;
+  _unmeasuredWindows = 0;
+
+  _measuredDirtyRectCount = 0.0;
+}
+
+
+QGraphicsView::ViewportUpdateMode
+ViewportUpdatePolicy::
+recommendedMode(double paintMilliseconds,
+                double dirtyFraction,
+                double dirtyRectCount) const
+{
+  if (dirtyFraction >= FullUpdateDirtyFraction)
+    return QGraphicsView::FullViewportUpdate;
+
+  if (dirtyRectCount >= FragmentedDirtyRectCount)
+    return QGraphicsView::BoundingRectViewportUpdate;
+
+  if (paintMilliseconds < CheapFrameMilliseconds)
+    return QGraphicsView::MinimalViewportUpdate;
+
+  return QGraphicsView::SmartViewportUpdate;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QtWidgets/QGraphicsView>
+
+#include "Export.hpp"
+
+namespace QtNodes
+{
+
+/// Picks the QGraphicsView::ViewportUpdateMode suiting the measured
+/// frames: full updates when most of the viewport is repainted anyway,
+/// a bounding rect when the dirty region is fragmented, minimal updates
+/// when painting is cheap and smart updates otherwise.
+/// Decisions are taken over windows of frames and only applied once
+/// two windows in a row agree.
+class NODE_EDITOR_PUBLIC ViewportUpdatePolicy
+{
+public:
+
+  ViewportUpdatePolicy();
+
+public:
+
+  /// Records one painted frame. Returns true when the frame completes
+  /// a window of frames and mode() has changed.
+  bool
+  addFrame(double paintMilliseconds,
+           double dirtyFraction,
+           int dirtyRectCount);
+
+  QGraphicsView::ViewportUpdateMode
+  mode() const;
+
+  void
+  reset(QGraphicsView::ViewportUpdateMode mode);
+
+private:
+
+  QGraphicsView::ViewportUpdateMode
+  recommendedMode(double paintMilliseconds,
+                  double dirtyFraction,
+                  double dirtyRectCount) const;
+
+private:
+
+  QGraphicsView::ViewportUpdateMode _mode;
+
+  // frames of the current window
+  int    _frames;
+  double _paintMilliseconds;
+  double _dirtyFraction;
+  double _dirtyRectCount;
+
+  QGraphicsView::ViewportUpdateMode _candidate;
+  int _candidateWindows;
+
+  // Full and bounding rect updates hide the real dirty regions, the
+  // count of the last window that measured them stands in; another mode
+  // is tried from time to time to measure them again.
+  int    _unmeasuredWindows;
+  double _measuredDirtyRectCount;
+};
+}
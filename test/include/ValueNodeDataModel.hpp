@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+
+#include "StubNodeDataModel.hpp"
+
+/// A model with two ports on each side whose state is a saved value.
+class ValueNodeDataModel : public StubNodeDataModel
+{
+public:
+  ValueNodeDataModel() { name("value"); }
+
+  unsigned int nPorts(QtNodes::PortType) const override { return 2; }
+
+  QJsonObject
+  save() const override
+  {
+    QJsonObject json = StubNodeDataModel::save();
+
+    json["value"] = value;
+
+    return json;
+  }
+
+  void
+  restore(QJsonObject const& json) override
+  {
+    value = json["value"].toString();
+  }
+
+  QString value;
+};
@@ -0,0 +1,107 @@
+#include <nodes/Connection>
+#include <nodes/FlowScene>
+#include <nodes/Node>
+#include <nodes/internal/ConnectionGeometry.hpp>
+#include <nodes/internal/ConnectionGraphicsObject.hpp>
+
+#include <catch2/catch.hpp>
+
+#include "ApplicationSetup.hpp"
+#include "ConnectionLayer.hpp"
+#include "StubNodeDataModel.hpp"
+
+using QtNodes::Connection;
+using QtNodes::ConnectionLayer;
+using QtNodes::FlowScene;
+using QtNodes::Node;
+using QtNodes::PortType;
+
+namespace
+{
+struct MockDataModel : StubNodeDataModel
+{
+  unsigned int nPorts(PortType) const override { return 1; }
+};
+}
+
+
+TEST_CASE("ConnectionLayer batches the connections and promotes them", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  FlowScene scene;
+
+  scene.setConnectionBatching(true);
+
+  ConnectionLayer* layer = scene.connectionLayer();
+  REQUIRE(layer != nullptr);
+
+  Node& from = scene.createNode(std::make_unique<MockDataModel>());
+  Node& to   = scene.createNode(std::make_unique<MockDataModel>());
+
+  scene.setNodePosition(from, QPointF(0, 0));
+  scene.setNodePosition(to, QPointF(600, 200));
+
+  auto connection = scene.createConnection(to, 0, from, 0);
+
+  scene.flushPendingUpdates();
+
+  auto& cgo = connection->getConnectionGraphicsObject();
+
+  // a complete connection is drawn by the layer
+  CHECK_FALSE(cgo.isVisible());
+  CHECK(layer->boundingRect().contains(cgo.mapRectToScene(cgo.boundingRect())));
+
+  auto const& geom = connection->connectionGeometry();
+
+  // the curve is symmetric, its middle is halfway between the ends
+  QPointF const onCurve = cgo.mapToScene((geom.source() + geom.sink()) / 2.0);
+
+  SECTION("hovering the curve promotes it, leaving it batches it again")
+  {
+    CHECK(layer->promoteAt(QPointF(-5000, -5000)) == nullptr);
+    CHECK_FALSE(cgo.isVisible());
+
+    CHECK(layer->promoteAt(onCurve) == &cgo);
+    CHECK(cgo.isVisible());
+
+    // the same connection is kept while the point stays on it
+    CHECK(layer->promoteAt(onCurve) == &cgo);
+
+    CHECK(layer->promoteAt(QPointF(-5000, -5000)) == nullptr);
+    CHECK_FALSE(cgo.isVisible());
+  }
+
+  SECTION("selecting promotes the connection, deselecting batches it again")
+  {
+    scene.selectConnections({ connection.get() });
+
+    CHECK(cgo.isVisible());
+    CHECK(cgo.isSelected());
+    CHECK(scene.selectedItems().contains(&cgo));
+    REQUIRE(scene.selectedConnections().size() == 1);
+
+    scene.selectNodes({});
+
+    CHECK_FALSE(cgo.isSelected());
+    CHECK_FALSE(cgo.isVisible());
+    CHECK(scene.selectedConnections().empty());
+  }
+
+  SECTION("a region selection promotes the connections in it")
+  {
+    scene.selectInRect(QRectF(onCurve - QPointF(5, 5), QSizeF(10, 10)));
+
+    CHECK(cgo.isVisible());
+    CHECK(cgo.isSelected());
+    CHECK(scene.selectedNodes().empty());
+  }
+
+  SECTION("a removed connection is forgotten")
+  {
+    scene.deleteConnection(*connection);
+    connection.reset();
+
+    CHECK(layer->promoteAt(onCurve) == nullptr);
+  }
+}
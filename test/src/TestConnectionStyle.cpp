@@ -0,0 +1,59 @@
+#include <nodes/ConnectionStyle>
+
+#include <catch2/catch.hpp>
+
+using QtNodes::ConnectionStyle;
+
+TEST_CASE("ConnectionStyle data type colors", "[style]")
+{
+  ConnectionStyle style;
+
+  SECTION("the same type id always gets the same color")
+  {
+    QColor const first = style.normalColor("integer");
+
+    CHECK(style.normalColor("integer") == first);
+
+    ConnectionStyle other;
+    CHECK(other.normalColor("integer") == first);
+  }
+
+  SECTION("different type ids get different colors")
+  {
+    CHECK(style.normalColor("integer") != style.normalColor("decimal"));
+  }
+
+  SECTION("pre-seeded colors win over generated ones")
+  {
+    style.setTypeColor("integer", Qt::red);
+
+    CHECK(style.normalColor("integer") == QColor(Qt::red));
+  }
+
+  SECTION("customizing a copy leaves the original intact")
+  {
+    QColor const generated = style.normalColor("text");
+
+    ConnectionStyle copy = style;
+    copy.setTypeColor("text", Qt::blue);
+
+    CHECK(copy.normalColor("text") == QColor(Qt::blue));
+    CHECK(style.normalColor("text") == generated);
+  }
+
+  SECTION("colors can be read from json")
+  {
+    ConnectionStyle fromJson(R"(
+    {
+      "ConnectionStyle": {
+        "DataTypeColors": {
+          "integer": [0, 255, 0],
+          "text": "magenta"
+        }
+      }
+    })");
+
+    CHECK(fromJson.normalColor("integer") == QColor(0, 255, 0));
+    CHECK(fromJson.normalColor("text") == QColor("magenta"));
+  }
+}
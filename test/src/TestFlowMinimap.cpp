@@ -0,0 +1,173 @@
+#include <nodes/FlowMinimap>
+#include <nodes/FlowScene>
+#include <nodes/FlowView>
+#include <nodes/Node>
+#include <nodes/StyleCollection>
+
+#include <catch2/catch.hpp>
+
+#include <QtTest>
+
+#include <cmath>
+
+#include "ApplicationSetup.hpp"
+#include "StubNodeDataModel.hpp"
+
+using QtNodes::FlowMinimap;
+using QtNodes::FlowScene;
+using QtNodes::FlowView;
+using QtNodes::Node;
+using QtNodes::PortType;
+using QtNodes::StyleCollection;
+
+namespace
+{
+struct MockDataModel : StubNodeDataModel
+{
+  unsigned int nPorts(PortType) const override { return 1; }
+};
+}
+
+
+TEST_CASE("FlowMinimap maps the scene and navigates the view", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  FlowScene scene;
+  FlowView  view(&scene);
+
+  view.resize(400, 300);
+  view.show();
+  REQUIRE(QTest::qWaitForWindowExposed(&view));
+
+  Node& from = scene.createNode(std::make_unique<MockDataModel>());
+  Node& to   = scene.createNode(std::make_unique<MockDataModel>());
+
+  scene.setNodePosition(from, QPointF(0, 0));
+  scene.setNodePosition(to, QPointF(2000, 1000));
+
+  scene.createConnection(to, 0, from, 0);
+
+  FlowMinimap minimap(&scene);
+  minimap.resize(200, 150);
+  minimap.setView(&view);
+
+  // the mapping is laid out by the first paint
+  QImage const image = minimap.grab().toImage();
+
+  auto sceneRectOf =
+    [&](Node& node)
+    {
+      return QRectF(scene.getNodePosition(node), scene.getNodeSize(node));
+    };
+
+  SECTION("scene rects map into the widget and back")
+  {
+    for (Node* node : { &from, &to })
+    {
+      QRectF const sceneRect  = sceneRectOf(*node);
+      QRectF const widgetRect = minimap.mapFromScene(sceneRect);
+
+      CHECK(QRectF(minimap.rect()).contains(widgetRect));
+
+      // scene units per widget pixel
+      double const pixel = sceneRect.width() / widgetRect.width();
+
+      QPointF const back = minimap.mapToScene(widgetRect.center().toPoint());
+
+      CHECK(std::abs(back.x() - sceneRect.center().x()) <= pixel);
+      CHECK(std::abs(back.y() - sceneRect.center().y()) <= pixel);
+    }
+
+    CHECK(minimap.mapFromScene(sceneRectOf(from)).right() <
+          minimap.mapFromScene(sceneRectOf(to)).left());
+  }
+
+  SECTION("connections are drawn between their nodes")
+  {
+    QRectF const out = minimap.mapFromScene(sceneRectOf(from));
+    QRectF const in  = minimap.mapFromScene(sceneRectOf(to));
+
+    QPoint const middle = ((QPointF(out.right(), out.center().y()) +
+                            QPointF(in.left(), in.center().y())) / 2.0).toPoint();
+
+    QRgb const color = StyleCollection::connectionStyle().normalColor().rgb();
+
+    bool drawn = false;
+
+    for (int dy = -1; dy <= 1; ++dy)
+      for (int dx = -1; dx <= 1; ++dx)
+        drawn = drawn || (image.pixel(middle + QPoint(dx, dy)) & RGB_MASK) == (color & RGB_MASK);
+
+    CHECK(drawn);
+  }
+
+  SECTION("moving a node redraws its connection")
+  {
+    QRgb const color = StyleCollection::connectionStyle().normalColor().rgb();
+
+    auto middleOf =
+      [&]
+      {
+        QRectF const out = minimap.mapFromScene(sceneRectOf(from));
+        QRectF const in  = minimap.mapFromScene(sceneRectOf(to));
+
+        return ((QPointF(out.right(), out.center().y()) +
+                 QPointF(in.left(), in.center().y())) / 2.0).toPoint();
+      };
+
+    auto drawnAround =
+      [&](QImage const & painted, QPoint const & point)
+      {
+        bool drawn = false;
+
+        for (int dy = -1; dy <= 1; ++dy)
+          for (int dx = -1; dx <= 1; ++dx)
+            drawn = drawn || (painted.pixel(point + QPoint(dx, dy)) & RGB_MASK) == (color & RGB_MASK);
+
+        return drawn;
+      };
+
+    QPoint const before = middleOf();
+
+    // within the grid, the mapping is kept
+    scene.setNodePosition(to, QPointF(2000, 0));
+    scene.flushPendingUpdates();
+
+    QPoint const after = middleOf();
+
+    REQUIRE(std::abs(after.y() - before.y()) > 3);
+
+    QImage const moved = minimap.grab().toImage();
+
+    CHECK(drawnAround(moved, after));
+    CHECK_FALSE(drawnAround(moved, before));
+  }
+
+  SECTION("clicking centers the view on the scene point")
+  {
+    QPoint const click = minimap.mapFromScene(sceneRectOf(to)).center().toPoint();
+
+    QPointF const target = minimap.mapToScene(click);
+
+    QTest::mouseClick(&minimap, Qt::LeftButton, Qt::NoModifier, click);
+
+    QPointF const center = view.visibleSceneRect().center();
+
+    CHECK(std::abs(center.x() - target.x()) <= 1.0);
+    CHECK(std::abs(center.y() - target.y()) <= 1.0);
+  }
+
+  SECTION("centerOnScenePoint moves the visible rect")
+  {
+    QSizeF const size = view.visibleSceneRect().size();
+
+    view.centerOnScenePoint(QPointF(500, -300));
+
+    QRectF const visible = view.visibleSceneRect();
+
+    CHECK(visible.size() == size);
+    CHECK(std::abs(visible.center().x() - 500) <= 1.0);
+    CHECK(std::abs(visible.center().y() + 300) <= 1.0);
+  }
+}
@@ -1,28 +1,40 @@
 #include <nodes/FlowScene>
+#include <nodes/FlowView>
 
 #include <functional>
 #include <memory>
+#include <stdexcept>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include <nodes/Node>
 #include <nodes/NodeDataModel>
+#include <nodes/NodeGeometry>
+#include <nodes/SceneHistory>
+#include <nodes/StyleCollection>
 
 #include <catch2/catch.hpp>
 
 #include "ApplicationSetup.hpp"
 #include "Stringify.hpp"
 #include "StubNodeDataModel.hpp"
+#include "ValueNodeDataModel.hpp"
 
 using QtNodes::Connection;
 using QtNodes::DataModelRegistry;
 using QtNodes::FlowScene;
+using QtNodes::FlowView;
 using QtNodes::Node;
 using QtNodes::NodeData;
 using QtNodes::NodeDataModel;
 using QtNodes::NodeDataType;
+using QtNodes::NodeGeometry;
+using QtNodes::NodeStyle;
 using QtNodes::PortIndex;
 using QtNodes::PortType;
+using QtNodes::SceneHistory;
+using QtNodes::StyleCollection;
 
 TEST_CASE("FlowScene triggers connections created or deleted", "[gui]")
 {
@@ -254,3 +266,779 @@ TEST_CASE("FlowScene's DataModelRegistry outlives nodes and connections", "[asan
 
   CHECK(modelsDestroyed == 1);
 }
+
+
+TEST_CASE("FlowScene coalesces node moves", "[gui]")
+{
+  struct MockDataModel : StubNodeDataModel
+  {
+    unsigned int nPorts(PortType) const override { return 1; }
+  };
+
+  auto setup = applicationSetup();
+
+  FlowScene scene;
+
+  Node& fromNode = scene.createNode(std::make_unique<MockDataModel>());
+  Node& toNode   = scene.createNode(std::make_unique<MockDataModel>());
+
+  auto connection = scene.createConnection(toNode, 0, fromNode, 0);
+
+  scene.flushPendingUpdates();
+
+  int nodeMovedCount = 0;
+  std::vector<std::vector<Node*>> nodesMovedCalls;
+
+  QObject::connect(&scene, &FlowScene::nodeMoved,
+                   [&](Node&, QPointF const&) { ++nodeMovedCount; });
+
+  QObject::connect(&scene, &FlowScene::nodesMoved,
+                   [&](std::vector<Node*> const& nodes) { nodesMovedCalls.push_back(nodes); });
+
+  QPointF const sinkBefore = connection->connectionGeometry().sink();
+
+  for (int i = 1; i <= 10; ++i)
+  {
+    fromNode.nodeGraphicsObject().setPos(i, 2 * i);
+    toNode.nodeGraphicsObject().setPos(200 + i, 2 * i);
+  }
+
+  // nothing is emitted until the queue is flushed
+  CHECK(nodeMovedCount == 0);
+  CHECK(nodesMovedCalls.empty());
+
+  QCoreApplication::processEvents();
+
+  CHECK(nodeMovedCount == 2);
+  REQUIRE(nodesMovedCalls.size() == 1);
+  CHECK(nodesMovedCalls.front().size() == 2);
+
+  auto& cgo = connection->getConnectionGraphicsObject();
+
+  QPointF const expectedSink =
+    toNode.nodeGeometry().portScenePosition(0, PortType::In,
+                                            toNode.nodeGraphicsObject().sceneTransform());
+
+  CHECK(cgo.mapToScene(connection->connectionGeometry().sink()) == expectedSink);
+  CHECK(connection->connectionGeometry().sink() != sinkBefore);
+
+  scene.deleteConnection(*connection);
+}
+
+
+TEST_CASE("FlowScene creates graphics objects lazily", "[gui]")
+{
+  struct MockDataModel : StubNodeDataModel
+  {
+    unsigned int nPorts(PortType) const override { return 1; }
+  };
+
+  auto setup = applicationSetup();
+
+  FlowScene scene;
+
+  scene.setLazyGraphicsObjects(true);
+
+  Node& nearNode = scene.createNode(std::make_unique<MockDataModel>());
+  Node& farNode  = scene.createNode(std::make_unique<MockDataModel>());
+  Node& lonely   = scene.createNode(std::make_unique<MockDataModel>());
+
+  scene.setNodePosition(nearNode, QPointF(0, 0));
+  scene.setNodePosition(farNode, QPointF(5000, 0));
+  scene.setNodePosition(lonely, QPointF(0, 5000));
+
+  auto connection = scene.createConnection(farNode, 0, nearNode, 0);
+
+  CHECK_FALSE(nearNode.hasGraphicsObject());
+  CHECK_FALSE(farNode.hasGraphicsObject());
+  CHECK_FALSE(connection->hasGraphicsObject());
+
+  CHECK(scene.getNodePosition(farNode) == QPointF(5000, 0));
+
+  scene.materializeGraphicsObjects(QRectF(-10, -10, 20, 20));
+
+  CHECK(nearNode.hasGraphicsObject());
+  CHECK_FALSE(farNode.hasGraphicsObject());
+  CHECK_FALSE(lonely.hasGraphicsObject());
+  CHECK(connection->hasGraphicsObject());
+
+  CHECK(nearNode.nodeGraphicsObject().pos() == QPointF(0, 0));
+
+  SECTION("asking for a graphics object creates it")
+  {
+    CHECK(farNode.nodeGraphicsObject().pos() == QPointF(5000, 0));
+    CHECK(farNode.hasGraphicsObject());
+  }
+
+  SECTION("graphics objects out of the kept rect are released")
+  {
+    scene.releaseGraphicsObjects(QRectF(-10, 4990, 20, 20));
+
+    CHECK_FALSE(nearNode.hasGraphicsObject());
+    CHECK_FALSE(connection->hasGraphicsObject());
+
+    CHECK(scene.getNodePosition(nearNode) == QPointF(0, 0));
+  }
+
+  // resizes of nodes without a graphics object reach the scene too
+  int resized = 0;
+
+  QObject::connect(&scene, &FlowScene::nodeResized,
+                   [&](Node& n) { if (&n == &lonely) ++resized; });
+
+  lonely.onNodeSizeUpdated();
+  scene.flushPendingUpdates();
+
+  CHECK(resized == 1);
+  CHECK_FALSE(lonely.hasGraphicsObject());
+
+  // nodes moved through the node itself are found at their new place
+  lonely.setPosition(QPointF(5000, 5));
+
+  CHECK(scene.nodesInRect(QRectF(4990, -10, 20, 20)).size() == 2);
+
+  scene.deleteConnection(*connection);
+}
+
+
+TEST_CASE("FlowScene maintains the selection", "[gui]")
+{
+  struct OtherDataModel : StubNodeDataModel
+  {
+    OtherDataModel() { name("other"); }
+  };
+
+  auto setup = applicationSetup();
+
+  FlowScene scene;
+
+  Node& first  = scene.createNode(std::make_unique<StubNodeDataModel>());
+  Node& second = scene.createNode(std::make_unique<StubNodeDataModel>());
+  Node& far    = scene.createNode(std::make_unique<OtherDataModel>());
+
+  scene.setNodePosition(first,  QPointF(0, 0));
+  scene.setNodePosition(second, QPointF(300, 0));
+  scene.setNodePosition(far,    QPointF(5000, 5000));
+
+  CHECK(scene.nodesInRect(QRectF(-50, -50, 100, 100)).size() == 1);
+  CHECK(scene.nodesInRect(QRectF(-50, -50, 1000, 1000)).size() == 2);
+
+  int selectionChangedCount = 0;
+
+  QObject::connect(&scene, &QGraphicsScene::selectionChanged,
+                   [&] { ++selectionChangedCount; });
+
+  scene.selectNodesInRect(QRectF(-50, -50, 1000, 1000));
+
+  CHECK(selectionChangedCount == 1);
+  CHECK(scene.selectedNodes().size() == 2);
+  CHECK(first.nodeGraphicsObject().isSelected());
+
+  scene.selectNodesByModelName("other");
+
+  REQUIRE(scene.selectedNodes().size() == 1);
+  CHECK(scene.selectedNodes().front() == &far);
+  CHECK_FALSE(first.nodeGraphicsObject().isSelected());
+
+  // moved nodes are found at their new place
+  scene.setNodePosition(far, QPointF(10, 10));
+  CHECK(scene.nodesInRect(QRectF(-50, -50, 100, 100)).size() == 2);
+
+  // items selected directly are tracked too
+  second.nodeGraphicsObject().setSelected(true);
+  CHECK(scene.selectedNodes().size() == 2);
+
+  scene.removeNode(far);
+  REQUIRE(scene.selectedNodes().size() == 1);
+  CHECK(scene.selectedNodes().front() == &second);
+}
+
+
+TEST_CASE("FlowScene selects the connections in a rect", "[gui]")
+{
+  struct MockDataModel : StubNodeDataModel
+  {
+    unsigned int nPorts(PortType) const override { return 1; }
+  };
+
+  auto setup = applicationSetup();
+
+  FlowScene scene;
+  FlowView  view(&scene);
+
+  Node& from = scene.createNode(std::make_unique<MockDataModel>());
+  Node& to   = scene.createNode(std::make_unique<MockDataModel>());
+
+  scene.setNodePosition(from, QPointF(0, 0));
+  scene.setNodePosition(to,   QPointF(1000, 0));
+
+  auto connection = scene.createConnection(to, 0, from, 0);
+
+  CHECK(scene.connectionsInRect(QRectF(-5000, 5000, 100, 100)).empty());
+
+  QRectF const band(-50, -50, 2000, 400);
+
+  REQUIRE(scene.connectionsInRect(band).size() == 1);
+  CHECK(scene.connectionsInRect(band).front() == connection.get());
+
+  scene.selectInRect(band);
+
+  CHECK(scene.selectedNodes().size() == 2);
+  REQUIRE(scene.selectedConnections().size() == 1);
+
+  // a band over the nodes only leaves the connection out
+  scene.selectInRect(QRectF(-5, -5, 10, 10));
+
+  CHECK(scene.selectedNodes().size() == 1);
+  CHECK(scene.selectedConnections().empty());
+
+  // deleting the selection of the band removes the connection as well
+  scene.selectInRect(band);
+  connection.reset();
+
+  view.deleteSelectedNodes();
+
+  CHECK(scene.connections().empty());
+  CHECK(scene.nodes().empty());
+}
+
+
+TEST_CASE("FlowScene propagates data once per connection after deferring", "[gui]")
+{
+  struct CountingModel : StubNodeDataModel
+  {
+    CountingModel() { name("counting"); }
+
+    unsigned int nPorts(PortType portType) const override
+    {
+      return portType == PortType::In ? 2 : 1;
+    }
+
+    void
+    setInData(std::shared_ptr<NodeData>, PortIndex) override
+    {
+      ++inputs;
+      Q_EMIT dataUpdated(0);
+    }
+
+    int inputs = 0;
+  };
+
+  auto setup = applicationSetup();
+
+  auto registry = std::make_shared<DataModelRegistry>();
+  registry->registerModel<CountingModel>();
+
+  auto inputCount = [](Node const& node)
+  {
+    std::size_t count = 0;
+
+    for (PortIndex i = 0; i < 2; ++i)
+      count += node.nodeState().connections(PortType::In, i).size();
+
+    return int(count);
+  };
+
+  auto inputsReceived = [](Node& node)
+  {
+    return static_cast<CountingModel*>(node.nodeDataModel())->inputs;
+  };
+
+  FlowScene scene(registry);
+
+  std::vector<Node*> nodes;
+
+  for (int i = 0; i < 5; ++i)
+    nodes.push_back(&scene.createNode(std::make_unique<CountingModel>()));
+
+  scene.setDataPropagationDeferred(true);
+
+  // a diamond followed by a chain
+  scene.createConnection(*nodes[1], 0, *nodes[0], 0);
+  scene.createConnection(*nodes[2], 0, *nodes[0], 0);
+  scene.createConnection(*nodes[3], 0, *nodes[1], 0);
+  scene.createConnection(*nodes[3], 1, *nodes[2], 0);
+  scene.createConnection(*nodes[4], 0, *nodes[3], 0);
+
+  for (Node* node : nodes)
+    CHECK(inputsReceived(*node) == 0);
+
+  // the models' signals still reach everyone but the nodes
+  int dataUpdates = 0;
+
+  for (Node* node : nodes)
+    QObject::connect(node->nodeDataModel(), &NodeDataModel::dataUpdated,
+                     [&](PortIndex) { ++dataUpdates; });
+
+  scene.setDataPropagationDeferred(false);
+
+  CHECK_FALSE(scene.dataPropagationDeferred());
+
+  for (Node* node : nodes)
+  {
+    CHECK(inputsReceived(*node) == inputCount(*node));
+    CHECK(node->dataForwarding());
+  }
+
+  CHECK(dataUpdates == 5);
+
+  SECTION("loading defers the propagation")
+  {
+    FlowScene loaded(registry);
+
+    loaded.loadFromMemory(scene.saveToMemory());
+
+    REQUIRE(loaded.nodes().size() == nodes.size());
+    CHECK_FALSE(loaded.dataPropagationDeferred());
+
+    for (auto const& pair : loaded.nodes())
+      CHECK(inputsReceived(*pair.second) == inputCount(*pair.second));
+  }
+}
+
+
+TEST_CASE("SceneHistory undoes and redoes scene changes", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  auto registry = std::make_shared<DataModelRegistry>();
+  registry->registerModel<ValueNodeDataModel>();
+
+  FlowScene scene(registry);
+
+  SceneHistory& history = scene.history();
+
+  history.setEnabled(true);
+
+  history.beginMacro("Build");
+
+  Node& a = scene.createNode(std::make_unique<ValueNodeDataModel>());
+  Node& b = scene.createNode(std::make_unique<ValueNodeDataModel>());
+
+  scene.createConnection(b, 0, a, 0);
+
+  history.endMacro();
+
+  QUuid const aId = a.id();
+  QUuid const bId = b.id();
+
+  // the moves reported for the new nodes are not changes
+  scene.flushPendingUpdates();
+  QCoreApplication::processEvents();
+
+  REQUIRE(history.undoCount() == 1);
+  CHECK(history.undoText() == "Build");
+  CHECK_FALSE(history.canRedo());
+  CHECK(history.memoryUsage() > 0);
+
+  SECTION("undoing the creation removes the nodes")
+  {
+    history.undo();
+
+    CHECK(scene.nodes().empty());
+    CHECK(scene.connections().empty());
+    REQUIRE(history.canRedo());
+    CHECK(history.redoText() == "Build");
+
+    history.redo();
+
+    CHECK(scene.nodes().size() == 2);
+    CHECK(scene.findConnection(bId, 0, aId, 0) != nullptr);
+    CHECK(history.undoCount() == 1);
+    CHECK(history.redoCount() == 0);
+  }
+
+  SECTION("undoing a removal restores the node and its connections")
+  {
+    static_cast<ValueNodeDataModel*>(a.nodeDataModel())->value = "3";
+
+    scene.removeNode(a);
+
+    CHECK(scene.connections().empty());
+
+    history.undo();
+
+    REQUIRE(scene.nodes().count(aId) == 1);
+    CHECK(scene.findConnection(bId, 0, aId, 0) != nullptr);
+
+    Node& restored = *scene.nodes().at(aId);
+    CHECK(static_cast<ValueNodeDataModel*>(restored.nodeDataModel())->value == "3");
+
+    history.redo();
+
+    CHECK(scene.nodes().count(aId) == 0);
+    CHECK(scene.connections().empty());
+  }
+
+  SECTION("model state changes keep the changed values")
+  {
+    auto* model = static_cast<ValueNodeDataModel*>(a.nodeDataModel());
+
+    QJsonObject const before = model->save();
+    model->value = "7";
+    history.recordModelStateChange(a, before);
+
+    history.undo();
+
+    CHECK(model->value.isEmpty());
+    CHECK(history.undoCount() == 1);
+
+    history.redo();
+
+    CHECK(model->value == "7");
+  }
+
+  SECTION("successive moves of the same nodes merge")
+  {
+    QPointF const start = a.position();
+
+    for (int i = 1; i <= 3; ++i)
+    {
+      scene.setNodePosition(a, start + QPointF(10 * i, 0));
+      scene.flushPendingUpdates();
+      QCoreApplication::processEvents();
+    }
+
+    CHECK(history.undoCount() == 2);
+    CHECK(history.undoText() == "Move Node");
+
+    history.undo();
+
+    CHECK(a.position() == start);
+    CHECK(history.undoCount() == 1);
+
+    // the positions set by undo() are not recorded again
+    scene.flushPendingUpdates();
+    QCoreApplication::processEvents();
+
+    CHECK(history.redoCount() == 1);
+
+    history.redo();
+
+    CHECK(a.position() == start + QPointF(30, 0));
+  }
+
+  SECTION("old steps are dropped past the limits")
+  {
+    history.setMoveMergeInterval(0);
+
+    for (int i = 1; i <= 3; ++i)
+    {
+      history.beginMacro("Move");
+      scene.setNodePosition(b, QPointF(0, 10 * i));
+      scene.flushPendingUpdates();
+      history.endMacro();
+    }
+
+    CHECK(history.undoCount() == 4);
+
+    history.setStepLimit(2);
+
+    CHECK(history.undoCount() == 2);
+
+    history.undo();
+    history.undo();
+    history.undo();
+
+    CHECK(b.position() == QPointF(0, 10));
+    CHECK(scene.nodes().size() == 2);
+
+    // the steps are dropped down to the budget
+    history.setMemoryBudget(1);
+
+    CHECK_FALSE(history.canUndo());
+    CHECK_FALSE(history.canRedo());
+    CHECK(history.memoryUsage() == 0);
+  }
+
+  SECTION("loading a scene clears the history")
+  {
+    QByteArray const saved = scene.saveToMemory();
+
+    scene.clearScene();
+    QCoreApplication::processEvents();
+
+    CHECK(history.undoCount() == 2);
+    CHECK(history.undoText() == "Delete 2 Nodes");
+
+    scene.loadFromMemory(saved);
+
+    CHECK(scene.nodes().size() == 2);
+    CHECK_FALSE(history.canUndo());
+  }
+}
+
+
+TEST_CASE("FlowScene copies, pastes and duplicates nodes", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  auto registry = std::make_shared<DataModelRegistry>();
+  registry->registerModel<ValueNodeDataModel>();
+
+  auto valueOf = [](Node const& node)
+  {
+    return static_cast<ValueNodeDataModel const*>(node.nodeDataModel())->value;
+  };
+
+  FlowScene scene(registry);
+
+  scene.history().setEnabled(true);
+
+  std::vector<Node*> chain;
+
+  for (int i = 0; i < 3; ++i)
+  {
+    auto model = std::make_unique<ValueNodeDataModel>();
+    model->value = QString::number(i + 1);
+
+    Node& node = scene.createNode(std::move(model));
+    scene.setNodePosition(node, QPointF(100 * i, 0));
+
+    chain.push_back(&node);
+  }
+
+  scene.createConnection(*chain[1], 0, *chain[0], 0);
+  scene.createConnection(*chain[2], 0, *chain[1], 0);
+
+  std::vector<Node*> const copied{ chain[0], chain[1] };
+
+  auto checkCopies = [&](FlowScene const& target,
+                         std::vector<Node*> const& copies,
+                         QPointF const& offset)
+  {
+    REQUIRE(copies.size() == 2);
+
+    for (std::size_t i = 0; i < copies.size(); ++i)
+    {
+      CHECK(copies[i]->id() != copied[i]->id());
+      CHECK(valueOf(*copies[i]) == valueOf(*copied[i]));
+      CHECK(copies[i]->position() == copied[i]->position() + offset);
+    }
+
+    CHECK(target.findConnection(copies[1]->id(), 0, copies[0]->id(), 0) != nullptr);
+
+    // the connection to the node left out is not copied
+    CHECK(copies[1]->nodeState().connections(PortType::Out, 0).empty());
+
+    CHECK(target.selectedNodes().size() == 2);
+  };
+
+  SECTION("pasting")
+  {
+    QPointF const offset(10, 10);
+
+    auto copies = scene.pasteNodes(scene.copyNodes(copied), offset);
+
+    checkCopies(scene, copies, offset);
+
+    CHECK(scene.nodes().size() == 5);
+    CHECK(scene.connections().size() == 3);
+
+    // one step of the history
+    CHECK(scene.history().undoText() == "Paste");
+
+    scene.history().undo();
+
+    CHECK(scene.nodes().size() == 3);
+    CHECK(scene.connections().size() == 2);
+  }
+
+  SECTION("pasting into another scene")
+  {
+    FlowScene other(registry);
+
+    auto copies = other.pasteNodes(scene.copyNodes(copied));
+
+    checkCopies(other, copies, QPointF());
+
+    CHECK(other.nodes().size() == 2);
+    CHECK(other.connections().size() == 1);
+  }
+
+  SECTION("duplicating")
+  {
+    QPointF const offset(0, 50);
+
+    auto copies = scene.duplicateNodes(copied, offset);
+
+    checkCopies(scene, copies, offset);
+
+    CHECK(scene.connections().size() == 3);
+    CHECK(scene.history().undoText() == "Duplicate");
+  }
+
+  SECTION("malformed data")
+  {
+    CHECK_THROWS_AS(scene.pasteNodes(QByteArray("not a scene")), std::logic_error);
+
+    CHECK(scene.nodes().size() == 3);
+  }
+
+  SECTION("a model missing from the registry")
+  {
+    Node& unknown = scene.createNode(std::make_unique<StubNodeDataModel>());
+
+    QByteArray const data = scene.copyNodes({ chain[0], &unknown });
+
+    auto const undoCount = scene.history().undoCount();
+
+    CHECK_THROWS_AS(scene.pasteNodes(data), std::logic_error);
+
+    // the known model ahead of it isn't placed either
+    CHECK(scene.nodes().size() == 4);
+    CHECK(scene.history().undoCount() == undoCount);
+  }
+
+  SECTION("pasting again from the view")
+  {
+    FlowView view(&scene);
+
+    scene.selectNodes({ chain[0] });
+    view.copySelectedNodes();
+
+    view.pasteNodes();
+    view.pasteNodes();
+
+    REQUIRE(scene.nodes().size() == 5);
+
+    std::vector<QPointF> positions;
+
+    for (auto const& pair : scene.nodes())
+      if (pair.second.get() != chain[0] && valueOf(*pair.second) == valueOf(*chain[0]))
+        positions.push_back(pair.second->position());
+
+    REQUIRE(positions.size() == 2);
+
+    // each paste lands a step further than the one before
+    CHECK(positions[0] != positions[1]);
+    CHECK(positions[0] != chain[0]->position());
+    CHECK(positions[1] != chain[0]->position());
+
+    // a view may be left without a scene
+    view.setScene(nullptr);
+
+    std::size_t const undoable = scene.history().undoCount();
+
+    view.undoAction()->trigger();
+
+    CHECK(scene.history().undoCount() == undoable);
+  }
+}
+
+
+TEST_CASE("Node and connection ids are random uuids", "[gui]")
+{
+  struct MockDataModel : StubNodeDataModel
+  {
+    MockDataModel() { name("mock"); }
+
+    unsigned int nPorts(PortType) const override { return 1; }
+  };
+
+  auto setup = applicationSetup();
+
+  auto registry = std::make_shared<DataModelRegistry>();
+  registry->registerModel<MockDataModel>();
+
+  FlowScene scene(registry);
+
+  std::unordered_set<QUuid> ids;
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    Node& node = scene.createNode(std::make_unique<MockDataModel>());
+
+    CHECK(node.id().version() == QUuid::Random);
+    CHECK(node.id().variant() == QUuid::DCE);
+
+    ids.insert(node.id());
+  }
+
+  CHECK(ids.size() == 1000);
+
+  Node& in  = *scene.allNodes().front();
+  Node& out = *scene.allNodes().back();
+
+  auto connection = scene.createConnection(in, 0, out, 0);
+
+  CHECK(connection->id().version() == QUuid::Random);
+
+  // the text is the one of QUuid
+  QJsonObject const nodeJson = in.save();
+
+  CHECK(nodeJson["id"].toString() == in.id().toString());
+  CHECK(connection->save()["out_id"].toString() == out.id().toString());
+
+  FlowScene loaded(registry);
+
+  loaded.restoreNode(nodeJson);
+
+  CHECK(loaded.nodes().count(in.id()) == 1);
+
+  // other forms are parsed as well
+  QJsonObject unbraced = nodeJson;
+  unbraced["id"] = in.id().toString().mid(1, 36).toUpper();
+
+  loaded.clearScene();
+  loaded.restoreNode(unbraced);
+
+  CHECK(loaded.nodes().count(in.id()) == 1);
+}
+
+
+TEST_CASE("Nodes share their style and fonts", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  SECTION("models point to the collection's style until overridden")
+  {
+    StubNodeDataModel first;
+    StubNodeDataModel second;
+
+    CHECK(first.sharedNodeStyle() == StyleCollection::sharedNodeStyle());
+    CHECK(second.sharedNodeStyle() == first.sharedNodeStyle());
+
+    first.setNodeStyle(NodeStyle());
+
+    CHECK(first.sharedNodeStyle() != second.sharedNodeStyle());
+    CHECK(second.sharedNodeStyle() == StyleCollection::sharedNodeStyle());
+
+    auto const custom = std::make_shared<NodeStyle const>();
+
+    first.setNodeStyle(custom);
+    second.setNodeStyle(custom);
+
+    CHECK(first.sharedNodeStyle() == second.sharedNodeStyle());
+    CHECK(&first.nodeStyle() == custom.get());
+  }
+
+  SECTION("geometries with the same font share one font record")
+  {
+    std::unique_ptr<NodeDataModel> firstModel  = std::make_unique<StubNodeDataModel>();
+    std::unique_ptr<NodeDataModel> secondModel = std::make_unique<StubNodeDataModel>();
+
+    NodeGeometry first(firstModel);
+
+    std::size_t const alone = first.footprint();
+
+    NodeGeometry second(secondModel);
+
+    // the shared record is split between its users
+    std::size_t const shared = first.footprint();
+
+    CHECK(shared < alone);
+    CHECK(second.footprint() == shared);
+
+    QFont larger;
+    larger.setPixelSize(64);
+
+    second.recalculateSize(larger);
+
+    CHECK(first.footprint() == alone);
+
+    second.recalculateSize(QFont());
+
+    CHECK(first.footprint() == shared);
+  }
+}
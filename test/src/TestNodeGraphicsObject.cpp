@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <nodes/FlowScene>
 #include <nodes/FlowView>
 #include <nodes/Node>
@@ -6,6 +8,7 @@
 #include <catch2/catch.hpp>
 
 #include <QtTest>
+#include <QtWidgets/QLineEdit>
 
 #include "ApplicationSetup.hpp"
 #include "StubNodeDataModel.hpp"
@@ -64,3 +67,105 @@ TEST_CASE("NodeDataModel::portOutConnectionPolicy(...) isn't called for input "
 
   CHECK(model.portOutConnectionPolicyCalledCount == 0);
 }
+
+
+TEST_CASE("Embedded widgets are painted from snapshots until needed", "[gui]")
+{
+  class WidgetModel : public StubNodeDataModel
+  {
+  public:
+    QWidget*
+    embeddedWidget() override { return _lineEdit; }
+
+    // deleted along with the node's graphics object
+    QLineEdit* _lineEdit = new QLineEdit();
+  };
+
+  auto setup = applicationSetup();
+
+  FlowScene scene;
+
+  scene.setWidgetSnapshots(true);
+
+  auto& node   = scene.createNode(std::make_unique<WidgetModel>());
+  auto  widget = node.nodeDataModel()->embeddedWidget();
+
+  CHECK(widget->graphicsProxyWidget() == nullptr);
+  CHECK(node.nodeGraphicsObject().childItems().isEmpty());
+
+  scene.setWidgetSnapshots(false);
+
+  CHECK(widget->graphicsProxyWidget() != nullptr);
+
+  scene.setWidgetSnapshots(true);
+
+  CHECK(widget->graphicsProxyWidget() == nullptr);
+  CHECK_FALSE(widget->isVisible());
+}
+
+
+TEST_CASE("Nodes with many ports show a window of port rows", "[gui]")
+{
+  class BusModel : public StubNodeDataModel
+  {
+  public:
+    unsigned int nPorts(PortType) const override { return 1000; }
+  };
+
+  auto setup = applicationSetup();
+
+  FlowScene scene;
+
+  auto& bus   = scene.createNode(std::make_unique<BusModel>());
+  auto& other = scene.createNode(std::make_unique<BusModel>());
+
+  auto& geom = bus.nodeGeometry();
+
+  CHECK(geom.portsVirtualized());
+  CHECK(geom.portRows() == geom.maxPortRows());
+  CHECK(geom.height() < 100 * (geom.entryHeight() + geom.spacing()));
+
+  auto const& inputs = bus.nodeState().getEntries(PortType::In);
+
+  CHECK(inputs.size() == 1000);
+  CHECK(inputs.connectedPorts() == 0);
+
+  auto connection = scene.createConnection(bus, 500, other, 3);
+
+  CHECK(inputs.connectedPorts() == 1);
+  CHECK(inputs[500].size() == 1);
+  CHECK(inputs[499].empty());
+
+  // the connected port keeps a row of its own below the window, the
+  // unconnected ones after the window collapse
+  CHECK(geom.portRows() == geom.maxPortRows() + 1);
+
+  auto shown = geom.visiblePorts(PortType::In);
+
+  CHECK(shown.size() == geom.maxPortRows() + 1);
+  CHECK(shown.back() == 500);
+
+  QPointF const p500 = geom.portScenePosition(500, PortType::In);
+
+  CHECK(geom.portScenePosition(31, PortType::In).y() < p500.y());
+  CHECK(p500.y() < geom.portScenePosition(501, PortType::In).y());
+  CHECK(geom.checkHitScenePoint(PortType::In, p500) == 500);
+
+  REQUIRE(geom.ensurePortVisible(500));
+
+  shown = geom.visiblePorts(PortType::In);
+
+  CHECK(std::find(shown.begin(), shown.end(), 500) != shown.end());
+  CHECK(geom.firstVisiblePort() <= 500);
+  CHECK(geom.portRows() == geom.maxPortRows());
+
+  geom.scrollPorts(-2000);
+
+  CHECK(geom.firstVisiblePort() == 0);
+  CHECK(geom.portRows() == geom.maxPortRows() + 1);
+  CHECK_FALSE(geom.scrollPorts(-1));
+
+  scene.deleteConnection(*connection);
+
+  CHECK(geom.portRows() == geom.maxPortRows());
+}
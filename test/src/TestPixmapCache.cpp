@@ -0,0 +1,94 @@
+#include <nodes/PixmapCache>
+
+#include <catch2/catch.hpp>
+
+#include <QtGui/QPixmapCache>
+
+#include "ApplicationSetup.hpp"
+
+using QtNodes::PixmapCache;
+
+TEST_CASE("PixmapCache keys entries by name, size and pixel ratio", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  PixmapCache::clear();
+
+  int generated = 0;
+
+  QSize requested;
+
+  auto generator =
+    [&](QSize const& pixelSize)
+    {
+      ++generated;
+      requested = pixelSize;
+
+      QImage image(pixelSize, QImage::Format_ARGB32_Premultiplied);
+      image.fill(Qt::red);
+
+      return image;
+    };
+
+  SECTION("the same request is a hit")
+  {
+    QPixmap const first  = PixmapCache::pixmap("square", QSize(10, 10), 1.0, generator);
+    QPixmap const second = PixmapCache::pixmap("square", QSize(10, 10), 1.0, generator);
+
+    CHECK(generated == 1);
+    CHECK(first.cacheKey() == second.cacheKey());
+  }
+
+  SECTION("another name or size is a miss")
+  {
+    PixmapCache::pixmap("square", QSize(10, 10), 1.0, generator);
+    PixmapCache::pixmap("other", QSize(10, 10), 1.0, generator);
+    PixmapCache::pixmap("square", QSize(10, 20), 1.0, generator);
+
+    CHECK(generated == 3);
+    CHECK(requested == QSize(10, 20));
+  }
+
+  SECTION("each pixel ratio is rendered at its own resolution")
+  {
+    QPixmap const normal = PixmapCache::pixmap("square", QSize(10, 10), 1.0, generator);
+    QPixmap const dense  = PixmapCache::pixmap("square", QSize(10, 10), 2.0, generator);
+
+    CHECK(generated == 2);
+
+    CHECK(normal.size() == QSize(10, 10));
+    CHECK(dense.size() == QSize(20, 20));
+    CHECK(dense.devicePixelRatio() == 2.0);
+
+    // fractional ratios round the pixel size up
+    PixmapCache::pixmap("square", QSize(10, 10), 1.25, generator);
+
+    CHECK(requested == QSize(13, 13));
+  }
+
+  SECTION("cleared or evicted entries are rendered again")
+  {
+    PixmapCache::pixmap("square", QSize(10, 10), 1.0, generator);
+
+    PixmapCache::clear();
+
+    PixmapCache::pixmap("square", QSize(10, 10), 1.0, generator);
+
+    CHECK(generated == 2);
+
+    int const limit = QPixmapCache::cacheLimit();
+
+    // in KiB, room for one of the pixmaps below
+    QPixmapCache::setCacheLimit(300);
+
+    PixmapCache::pixmap("large", QSize(256, 256), 1.0, generator);
+    PixmapCache::pixmap("larger", QSize(256, 256), 1.0, generator);
+    PixmapCache::pixmap("large", QSize(256, 256), 1.0, generator);
+
+    QPixmapCache::setCacheLimit(limit);
+
+    CHECK(generated == 5);
+  }
+
+  PixmapCache::clear();
+}
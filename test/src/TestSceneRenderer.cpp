@@ -0,0 +1,104 @@
+#include <nodes/FlowScene>
+#include <nodes/Node>
+#include <nodes/SceneRenderer>
+
+#include <catch2/catch.hpp>
+
+#include <QtCore/QBuffer>
+#include <QtGui/QImage>
+
+#include <algorithm>
+#include <set>
+#include <utility>
+
+#include "ApplicationSetup.hpp"
+#include "StubNodeDataModel.hpp"
+
+using QtNodes::FlowScene;
+using QtNodes::Node;
+using QtNodes::PortType;
+using QtNodes::SceneRenderer;
+
+namespace
+{
+struct MockDataModel : StubNodeDataModel
+{
+  unsigned int nPorts(PortType) const override { return 1; }
+};
+}
+
+
+TEST_CASE("SceneRenderer renders a scene in tiles", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  FlowScene scene;
+
+  Node& from = scene.createNode(std::make_unique<MockDataModel>());
+  Node& to   = scene.createNode(std::make_unique<MockDataModel>());
+
+  scene.setNodePosition(from, QPointF(0, 0));
+  scene.setNodePosition(to, QPointF(300, 100));
+
+  scene.createConnection(to, 0, from, 0);
+
+  SceneRenderer renderer(scene);
+
+  renderer.setSceneRect(QRectF(-50, -50, 500, 300));
+  renderer.setBackgroundColor(Qt::white);
+  renderer.setTileSize(QSize(128, 128));
+
+  SECTION("tiles cover the output in row-major order")
+  {
+    std::set<std::pair<int, int>> seen;
+    int previous = -1;
+
+    bool const ok = renderer.render([&](SceneRenderer::Tile const& tile)
+    {
+      int const index = tile.row * 4 + tile.column;
+
+      CHECK(index > previous);
+      previous = index;
+
+      CHECK(tile.offset == QPoint(tile.column * 128, tile.row * 128));
+      CHECK(tile.image.width() == std::min(128, 500 - tile.offset.x()));
+      CHECK(tile.image.height() == std::min(128, 300 - tile.offset.y()));
+
+      seen.emplace(tile.row, tile.column);
+      return true;
+    });
+
+    CHECK(ok);
+    CHECK(seen.size() == 4 * 3);
+  }
+
+  SECTION("a streamed PNG matches the tiles")
+  {
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+
+    REQUIRE(renderer.renderToPng(buffer));
+
+    QImage image;
+    REQUIRE(image.loadFromData(buffer.data(), "PNG"));
+
+    CHECK(image.size() == QSize(500, 300));
+
+    // background in the corner, node body where the first node is
+    CHECK(QColor(image.pixel(2, 2)) == QColor(Qt::white));
+    CHECK(QColor(image.pixel(60, 70)) != QColor(Qt::white));
+  }
+
+  SECTION("the sink stops the rendering")
+  {
+    int count = 0;
+
+    bool const ok = renderer.render([&](SceneRenderer::Tile const&)
+    {
+      return ++count < 2;
+    });
+
+    CHECK_FALSE(ok);
+    CHECK(count == 2);
+  }
+}
@@ -0,0 +1,544 @@
+#include <nodes/Connection>
+#include <nodes/FlowScene>
+#include <nodes/IndexedSceneFile>
+#include <nodes/SceneHistory>
+#include <nodes/SceneJournal>
+#include <nodes/Node>
+#include <nodes/NodeDataModel>
+
+#include <catch2/catch.hpp>
+
+#include <QtCore/QBuffer>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QJsonObject>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QThread>
+
+#include <unordered_set>
+
+#include "ApplicationSetup.hpp"
+#include "ValueNodeDataModel.hpp"
+
+using QtNodes::Connection;
+using QtNodes::DataModelRegistry;
+using QtNodes::FlowScene;
+using QtNodes::IndexedSceneFile;
+using QtNodes::Node;
+using QtNodes::PortType;
+using QtNodes::SceneCompression;
+using QtNodes::SceneFormat;
+using QtNodes::SceneJournal;
+
+namespace
+{
+class ConcurrentValueModel : public ValueNodeDataModel
+{
+public:
+  ConcurrentValueModel() { name(Name()); }
+
+  static QString Name() { return "concurrent value"; }
+
+  static bool ConcurrentRestore() { return true; }
+};
+
+
+std::shared_ptr<DataModelRegistry>
+makeRegistry()
+{
+  auto registry = std::make_shared<DataModelRegistry>();
+
+  registry->registerModel<ValueNodeDataModel>();
+  registry->registerModel<ConcurrentValueModel>();
+
+  return registry;
+}
+
+
+void
+fillScene(FlowScene& scene)
+{
+  for (int i = 0; i < 20; ++i)
+  {
+    Node& node = scene.createNode(std::make_unique<ValueNodeDataModel>());
+
+    static_cast<ValueNodeDataModel*>(node.nodeDataModel())->value = QString("node %1").arg(i);
+
+    scene.setNodePosition(node, QPointF(i * 150.0, i * -25.5));
+  }
+
+  auto nodes = scene.allNodes();
+
+  for (std::size_t i = 1; i < nodes.size(); ++i)
+    scene.createConnection(*nodes[i], int(i % 2), *nodes[i - 1], 1);
+}
+
+
+void
+checkSameScene(FlowScene const& expected, FlowScene const& actual)
+{
+  REQUIRE(actual.nodes().size() == expected.nodes().size());
+  REQUIRE(actual.connections().size() == expected.connections().size());
+
+  for (auto const& pair : expected.nodes())
+  {
+    auto it = actual.nodes().find(pair.first);
+
+    REQUIRE(it != actual.nodes().end());
+
+    Node const& node = *it->second;
+
+    CHECK(node.position() == pair.second->position());
+
+    CHECK(static_cast<ValueNodeDataModel const*>(node.nodeDataModel())->value ==
+          static_cast<ValueNodeDataModel const*>(pair.second->nodeDataModel())->value);
+  }
+
+  for (auto const& pair : actual.connections())
+  {
+    Connection const& c = *pair.second;
+
+    CHECK(c.getNode(PortType::In) != nullptr);
+    CHECK(c.getNode(PortType::Out) != nullptr);
+    CHECK(c.getPortIndex(PortType::Out) == 1);
+  }
+}
+
+
+/// The connections of `scene` joining two nodes of `partial`.
+std::size_t
+connectionsWithin(FlowScene const& scene, FlowScene const& partial)
+{
+  std::size_t count = 0;
+
+  for (auto const& pair : scene.connections())
+  {
+    Connection const& c = *pair.second;
+
+    if (partial.nodes().count(c.getNode(PortType::In)->id()) &&
+        partial.nodes().count(c.getNode(PortType::Out)->id()))
+      ++count;
+  }
+
+  return count;
+}
+}
+
+
+TEST_CASE("FlowScene saves and loads both formats", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  FlowScene scene(makeRegistry());
+
+  fillScene(scene);
+
+  QByteArray const json   = scene.saveToMemory();
+  QByteArray const binary = scene.saveToMemory(SceneFormat::Binary);
+
+  CHECK(binary.size() < json.size());
+
+  SECTION("JSON")
+  {
+    FlowScene loaded(makeRegistry());
+
+    loaded.loadFromMemory(json);
+
+    checkSameScene(scene, loaded);
+  }
+
+  SECTION("binary")
+  {
+    FlowScene loaded(makeRegistry());
+
+    loaded.loadFromMemory(binary);
+
+    checkSameScene(scene, loaded);
+
+    // saving again gives the same scene
+    FlowScene reloaded(makeRegistry());
+
+    reloaded.loadFromMemory(loaded.saveToMemory(SceneFormat::Binary));
+
+    checkSameScene(scene, reloaded);
+  }
+
+  SECTION("truncated binary data")
+  {
+    FlowScene loaded(makeRegistry());
+
+    CHECK_THROWS(loaded.loadFromMemory(binary.left(binary.size() / 2)));
+  }
+}
+
+
+TEST_CASE("FlowScene streams scenes through devices", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  FlowScene scene(makeRegistry());
+
+  fillScene(scene);
+
+  for (SceneFormat format : {SceneFormat::Json, SceneFormat::Binary})
+  {
+    INFO("binary: " << (format == SceneFormat::Binary));
+
+    QByteArray data;
+
+    {
+      QBuffer buffer(&data);
+      buffer.open(QIODevice::WriteOnly);
+
+      qint64 lastDone  = 0;
+      qint64 lastTotal = -1;
+
+      CHECK(scene.saveToDevice(buffer, format,
+                               [&](qint64 done, qint64 total)
+                               {
+                                 lastDone  = done;
+                                 lastTotal = total;
+                               }));
+
+      CHECK(lastDone == lastTotal);
+      CHECK(lastTotal == qint64(scene.nodes().size() + scene.connections().size()));
+    }
+
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+
+    FlowScene loaded(makeRegistry());
+
+    qint64 lastDone = 0;
+
+    loaded.loadFromDevice(buffer, [&](qint64 done, qint64) { lastDone = done; });
+
+    CHECK(lastDone == data.size());
+
+    checkSameScene(scene, loaded);
+  }
+
+  // the in-memory JSON lists the connections before the nodes
+  QByteArray json = scene.saveToMemory();
+
+  QBuffer jsonBuffer(&json);
+  jsonBuffer.open(QIODevice::ReadOnly);
+
+  FlowScene fromMemoryJson(makeRegistry());
+
+  fromMemoryJson.loadFromDevice(jsonBuffer);
+
+  checkSameScene(scene, fromMemoryJson);
+}
+
+
+TEST_CASE("FlowScene saves compressed scenes", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  FlowScene scene(makeRegistry());
+
+  fillScene(scene);
+
+  // the JSON spans several chunks
+  for (int i = 0; i < 3000; ++i)
+  {
+    Node& node = scene.createNode(std::make_unique<ValueNodeDataModel>());
+
+    static_cast<ValueNodeDataModel*>(node.nodeDataModel())->value = QString("extra %1").arg(i);
+
+    scene.setNodePosition(node, QPointF(i, 0));
+  }
+
+  for (SceneFormat format : {SceneFormat::Json, SceneFormat::Binary})
+  {
+    INFO("binary: " << (format == SceneFormat::Binary));
+
+    QByteArray const plain      = scene.saveToMemory(format);
+    QByteArray const compressed = scene.saveToMemory(format, SceneCompression::Chunked);
+
+    CHECK(compressed.startsWith("NEFZ"));
+    CHECK(compressed.size() < plain.size() / 2);
+
+    FlowScene loaded(makeRegistry());
+
+    loaded.loadFromMemory(compressed);
+
+    checkSameScene(scene, loaded);
+
+    // through a device, with the progress in compressed bytes
+    QByteArray data;
+
+    {
+      QBuffer buffer(&data);
+      buffer.open(QIODevice::WriteOnly);
+
+      CHECK(scene.saveToDevice(buffer, format, {}, SceneCompression::Chunked));
+    }
+
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+
+    FlowScene streamed(makeRegistry());
+
+    qint64 lastDone = 0;
+
+    streamed.loadFromDevice(buffer, [&](qint64 done, qint64) { lastDone = done; });
+
+    CHECK(lastDone > 0);
+    CHECK(lastDone <= data.size());
+
+    checkSameScene(scene, streamed);
+  }
+
+  SECTION("corrupted chunk")
+  {
+    QByteArray data = scene.saveToMemory(SceneFormat::Binary, SceneCompression::Chunked);
+
+    data[data.size() / 2] = char(data[data.size() / 2] ^ 0x5a);
+
+    FlowScene loaded(makeRegistry());
+
+    CHECK_THROWS(loaded.loadFromMemory(data));
+  }
+}
+
+
+TEST_CASE("IndexedSceneFile restores parts of a scene", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  FlowScene scene(makeRegistry());
+
+  fillScene(scene);
+
+  QTemporaryDir dir;
+  REQUIRE(dir.isValid());
+
+  QString const fileName = dir.path() + "/scene.nedx";
+
+  REQUIRE(IndexedSceneFile::write(scene, fileName, 200.0));
+
+  FlowScene partial(makeRegistry());
+
+  partial.history().setEnabled(true);
+
+  IndexedSceneFile file(partial);
+
+  REQUIRE(file.open(fileName));
+
+  CHECK(file.nodeCount() == scene.nodes().size());
+  CHECK(file.connectionCount() == scene.connections().size());
+  CHECK(partial.nodes().empty());
+
+  // the nodes are 150 apart horizontally, the rect holds the first five
+  CHECK(file.materializeRegion(QRectF(-50.0, -200.0, 660.0, 400.0)) == 5);
+  CHECK(partial.nodes().size() == 5);
+  CHECK(partial.connections().size() == connectionsWithin(scene, partial));
+
+  for (auto const& pair : partial.nodes())
+  {
+    auto it = scene.nodes().find(pair.first);
+
+    REQUIRE(it != scene.nodes().end());
+    CHECK(pair.second->position() == it->second->position());
+    CHECK(pair.second->position().x() < 610.0);
+
+    CHECK(static_cast<ValueNodeDataModel const*>(pair.second->nodeDataModel())->value ==
+          static_cast<ValueNodeDataModel const*>(it->second->nodeDataModel())->value);
+  }
+
+  // a second pass over the region restores nothing
+  CHECK(file.materializeRegion(QRectF(-50.0, -200.0, 660.0, 400.0)) == 0);
+
+  CHECK(file.materializeNode(QUuid::createUuid()) == nullptr);
+
+  Node* far = nullptr;
+
+  for (auto const& pair : scene.nodes())
+    if (pair.second->position().x() > 2000.0)
+      far = pair.second.get();
+
+  REQUIRE(far != nullptr);
+
+  std::unordered_set<QUuid> neighbours;
+
+  for (auto const& pair : scene.connections())
+  {
+    Node* in  = pair.second->getNode(PortType::In);
+    Node* out = pair.second->getNode(PortType::Out);
+
+    if (in == far)
+      neighbours.insert(out->id());
+    else if (out == far)
+      neighbours.insert(in->id());
+  }
+
+  std::size_t newNeighbours = 0;
+
+  for (QUuid const& id : neighbours)
+    if (!partial.nodes().count(id))
+      ++newNeighbours;
+
+  std::size_t const before = partial.nodes().size();
+
+  CHECK(file.materializeSubgraph(far->id(), 1) == 1 + newNeighbours);
+  CHECK(partial.nodes().size() == before + 1 + newNeighbours);
+  CHECK(partial.connections().size() == connectionsWithin(scene, partial));
+
+  Node* restored = file.materializeNode(far->id());
+
+  REQUIRE(restored != nullptr);
+  CHECK(restored->id() == far->id());
+
+  // everything at once
+  file.materializeRegion(QRectF(-10000.0, -10000.0, 20000.0, 20000.0));
+
+  checkSameScene(scene, partial);
+
+  // paging in is not recorded
+  QCoreApplication::processEvents();
+
+  CHECK_FALSE(partial.history().canUndo());
+  CHECK(partial.history().isEnabled());
+}
+
+
+TEST_CASE("FlowScene restores thread-safe models concurrently", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  auto registry = makeRegistry();
+
+  CHECK(registry->concurrentRestore("concurrent value"));
+  CHECK_FALSE(registry->concurrentRestore("value"));
+
+  FlowScene scene(registry);
+
+  fillScene(scene);
+
+  for (int i = 0; i < 200; ++i)
+  {
+    Node& node = scene.createNode(std::make_unique<ConcurrentValueModel>());
+
+    static_cast<ValueNodeDataModel*>(node.nodeDataModel())->value = QString("concurrent %1").arg(i);
+
+    scene.setNodePosition(node, QPointF(i * 10.0, 500.0));
+  }
+
+  for (SceneFormat format : {SceneFormat::Json, SceneFormat::Binary})
+  {
+    INFO("binary: " << (format == SceneFormat::Binary));
+
+    FlowScene loaded(makeRegistry());
+
+    loaded.loadFromMemory(scene.saveToMemory(format));
+
+    checkSameScene(scene, loaded);
+
+    // the models restored on the pool belong to the scene's thread
+    for (auto const& pair : loaded.nodes())
+      CHECK(pair.second->nodeDataModel()->thread() == QThread::currentThread());
+  }
+}
+
+
+TEST_CASE("SceneJournal records changes and recovers them", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  QTemporaryDir dir;
+  REQUIRE(dir.isValid());
+
+  QString const fileName = dir.path() + "/scene.flow";
+
+  FlowScene scene(makeRegistry());
+
+  fillScene(scene);
+
+  SceneJournal journal(scene, fileName);
+
+  REQUIRE(journal.compact());
+  CHECK(journal.journalRecordCount() == 0);
+  CHECK_FALSE(journal.hasPendingChanges());
+
+  auto nodes = scene.allNodes();
+
+  Node& created = scene.createNode(std::make_unique<ValueNodeDataModel>());
+  static_cast<ValueNodeDataModel*>(created.nodeDataModel())->value = "created";
+  scene.setNodePosition(created, QPointF(-300.0, 40.0));
+
+  scene.createConnection(created, 0, *nodes[5], 1);
+
+  scene.removeNode(*nodes[0]);
+
+  static_cast<ValueNodeDataModel*>(nodes[3]->nodeDataModel())->value = "changed";
+  journal.recordModelState(*nodes[3]);
+
+  CHECK(journal.hasPendingChanges());
+  REQUIRE(journal.flush());
+  CHECK(journal.journalRecordCount() > 0);
+
+  auto recovered = [&]()
+  {
+    auto loaded = std::make_shared<FlowScene>(makeRegistry());
+
+    SceneJournal loadedJournal(*loaded, fileName);
+
+    CHECK(loadedJournal.recover() > 0);
+    CHECK_FALSE(loadedJournal.hasPendingChanges());
+
+    // the replayed moves are not reported again
+    QCoreApplication::processEvents();
+    CHECK_FALSE(loadedJournal.hasPendingChanges());
+
+    return loaded;
+  };
+
+  checkSameScene(scene, *recovered());
+
+  SECTION("a record cut short is dropped")
+  {
+    qint64 size = 0;
+
+    {
+      QFile file(journal.journalFileName());
+      REQUIRE(file.open(QIODevice::Append));
+      size = file.size();
+      file.write("{\"op\":\"deleteNode\",\"id\":");
+    }
+
+    checkSameScene(scene, *recovered());
+
+    CHECK(QFile(journal.journalFileName()).size() == size);
+  }
+
+  SECTION("the journal of a previous snapshot is skipped")
+  {
+    QByteArray previous;
+
+    {
+      QFile file(journal.journalFileName());
+      REQUIRE(file.open(QIODevice::ReadOnly));
+      previous = file.readAll();
+    }
+
+    scene.removeNode(created);
+
+    REQUIRE(journal.compact());
+
+    {
+      QFile file(journal.journalFileName());
+      REQUIRE(file.open(QIODevice::WriteOnly));
+      file.write(previous);
+    }
+
+    FlowScene loaded(makeRegistry());
+
+    SceneJournal loadedJournal(loaded, fileName);
+
+    CHECK(loadedJournal.recover() == 0);
+
+    checkSameScene(scene, loaded);
+  }
+}
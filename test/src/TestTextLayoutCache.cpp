@@ -0,0 +1,150 @@
+#include <nodes/NodeDataModel>
+#include <nodes/NodeGeometry>
+
+#include <catch2/catch.hpp>
+
+#include <QtGui/QFontMetrics>
+
+#include "ApplicationSetup.hpp"
+#include "StubNodeDataModel.hpp"
+#include "TextLayoutCache.hpp"
+
+using QtNodes::NodeDataModel;
+using QtNodes::NodeGeometry;
+using QtNodes::TextLayoutCache;
+
+TEST_CASE("TextLayoutCache measures each string once per font", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  TextLayoutCache::clear();
+
+  QFont font;
+
+  QFont bold = font;
+  bold.setBold(true);
+
+  SECTION("the same string is a hit")
+  {
+    auto const first  = TextLayoutCache::layout(font, "caption");
+    auto const second = TextLayoutCache::layout(font, "caption");
+
+    CHECK(TextLayoutCache::size(font) == 1);
+
+    CHECK(first.advance == second.advance);
+    CHECK(first.boundingRect == second.boundingRect);
+    CHECK(first.staticText.text() == "caption");
+  }
+
+  SECTION("another string or another font is a miss")
+  {
+    TextLayoutCache::layout(font, "caption");
+    TextLayoutCache::layout(font, "port");
+    auto const boldLayout = TextLayoutCache::layout(bold, "caption");
+
+    CHECK(TextLayoutCache::size(font) == 2);
+    CHECK(TextLayoutCache::size(bold) == 1);
+
+    CHECK(boldLayout.advance == QFontMetrics(bold).width("caption"));
+    CHECK(boldLayout.ascent == QFontMetrics(bold).ascent());
+  }
+
+  SECTION("the table of a font is dropped over 4096 entries")
+  {
+    for (int i = 0; i < 4096; ++i)
+      TextLayoutCache::layout(font, QString::number(i));
+
+    CHECK(TextLayoutCache::size(font) == 4096);
+
+    // hits don't count
+    TextLayoutCache::layout(font, "0");
+    CHECK(TextLayoutCache::size(font) == 4096);
+
+    TextLayoutCache::layout(font, "overflow");
+    CHECK(TextLayoutCache::size(font) == 1);
+
+    TextLayoutCache::layout(bold, "other font");
+    CHECK(TextLayoutCache::size(bold) == 1);
+  }
+
+  TextLayoutCache::clear();
+
+  CHECK(TextLayoutCache::size(font) == 0);
+}
+
+
+TEST_CASE("NodeGeometry::recalculateSize(font) skips an unchanged font", "[gui]")
+{
+  auto setup = applicationSetup();
+
+  std::unique_ptr<NodeDataModel> model = std::make_unique<StubNodeDataModel>();
+
+  NodeGeometry geometry(model);
+
+  QFont font;
+
+  geometry.recalculateSize(font);
+
+  unsigned int const width = geometry.width();
+
+  // a size set by hand is kept as long as the font is the same
+  geometry.setWidth(width + 1);
+  geometry.recalculateSize(font);
+
+  CHECK(geometry.width() == width + 1);
+
+  QFont larger = font;
+  larger.setPixelSize(64);
+
+  geometry.recalculateSize(larger);
+
+  CHECK(geometry.width() != width + 1);
+}
+
+
+TEST_CASE("NodeGeometry measures the ports again only when invalidated", "[gui]")
+{
+  struct CaptionModel : StubNodeDataModel
+  {
+    unsigned int nPorts(QtNodes::PortType) const override { return 3; }
+
+    bool portCaptionVisible(QtNodes::PortType, QtNodes::PortIndex) const override { return true; }
+
+    QString
+    portCaption(QtNodes::PortType, QtNodes::PortIndex) const override
+    {
+      ++captions;
+      return caption;
+    }
+
+    QString caption = "port";
+
+    mutable int captions = 0;
+  };
+
+  auto setup = applicationSetup();
+
+  std::unique_ptr<NodeDataModel> model = std::make_unique<CaptionModel>();
+
+  auto& captionModel = static_cast<CaptionModel&>(*model);
+
+  NodeGeometry geometry(model);
+
+  geometry.recalculateSize();
+
+  int const measured = captionModel.captions;
+
+  unsigned int const width = geometry.width();
+
+  // scrolling and widget resizes recalculate with the same captions
+  geometry.recalculateSize();
+
+  CHECK(captionModel.captions == measured);
+
+  captionModel.caption = "a much longer port caption";
+  geometry.invalidatePortWidths();
+  geometry.recalculateSize();
+
+  CHECK(captionModel.captions > measured);
+  CHECK(geometry.width() > width);
+}
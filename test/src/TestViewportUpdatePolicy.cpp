@@ -0,0 +1,119 @@
+#include <catch2/catch.hpp>
+
+#include "ViewportUpdatePolicy.hpp"
+
+using QtNodes::ViewportUpdatePolicy;
+
+namespace
+{
+
+int const WindowFrames = 30;
+
+/// Feeds one window of identical frames, true if the mode changed.
+bool
+addWindow(ViewportUpdatePolicy& policy,
+          double paintMilliseconds,
+          double dirtyFraction,
+          int dirtyRectCount)
+{
+  bool changed = false;
+
+  for (int i = 0; i < WindowFrames; ++i)
+    changed = policy.addFrame(paintMilliseconds, dirtyFraction, dirtyRectCount) || changed;
+
+  return changed;
+}
+}
+
+
+TEST_CASE("ViewportUpdatePolicy picks a mode from the measured frames", "[viewport]")
+{
+  ViewportUpdatePolicy policy;
+
+  CHECK(policy.mode() == QGraphicsView::MinimalViewportUpdate);
+
+  SECTION("cheap small updates stay minimal")
+  {
+    for (int i = 0; i < 5; ++i)
+      CHECK_FALSE(addWindow(policy, 1.0, 0.1, 2));
+
+    CHECK(policy.mode() == QGraphicsView::MinimalViewportUpdate);
+  }
+
+  SECTION("a mode is applied once two windows agree")
+  {
+    CHECK_FALSE(addWindow(policy, 5.0, 0.1, 2));
+    CHECK(policy.mode() == QGraphicsView::MinimalViewportUpdate);
+
+    CHECK(addWindow(policy, 5.0, 0.1, 2));
+    CHECK(policy.mode() == QGraphicsView::SmartViewportUpdate);
+  }
+
+  SECTION("most of the viewport dirty switches to full updates, probed later")
+  {
+    addWindow(policy, 5.0, 0.8, 2);
+    addWindow(policy, 5.0, 0.8, 2);
+
+    REQUIRE(policy.mode() == QGraphicsView::FullViewportUpdate);
+
+    // a full update always covers the whole viewport
+    for (int i = 0; i < 9; ++i)
+      CHECK_FALSE(addWindow(policy, 5.0, 1.0, 1));
+
+    CHECK(addWindow(policy, 5.0, 1.0, 1));
+    CHECK(policy.mode() == QGraphicsView::SmartViewportUpdate);
+
+    // the probe measured small updates: no going back
+    CHECK_FALSE(addWindow(policy, 5.0, 0.1, 2));
+    CHECK(policy.mode() == QGraphicsView::SmartViewportUpdate);
+  }
+
+  SECTION("fragmented updates keep the bounding rect mode")
+  {
+    addWindow(policy, 5.0, 0.2, 40);
+    addWindow(policy, 5.0, 0.2, 40);
+
+    REQUIRE(policy.mode() == QGraphicsView::BoundingRectViewportUpdate);
+
+    int changes = 0;
+
+    // in bounding rect mode a frame reports a single dirty rect; the
+    // real regions are only measured again by the periodic probe
+    for (int i = 0; i < 30; ++i)
+    {
+      bool const boundingRect =
+        (policy.mode() == QGraphicsView::BoundingRectViewportUpdate);
+
+      if (addWindow(policy, 5.0, 0.2, boundingRect ? 1 : 40))
+        ++changes;
+    }
+
+    // a probe and its way back every ten windows, not every two
+    CHECK(changes <= 6);
+  }
+
+  SECTION("fragmentation measured by a probe to be gone leaves the bounding rect mode")
+  {
+    addWindow(policy, 5.0, 0.2, 40);
+    addWindow(policy, 5.0, 0.2, 40);
+
+    REQUIRE(policy.mode() == QGraphicsView::BoundingRectViewportUpdate);
+
+    for (int i = 0; i < 10; ++i)
+      addWindow(policy, 5.0, 0.2, 1);
+
+    REQUIRE(policy.mode() == QGraphicsView::SmartViewportUpdate);
+
+    addWindow(policy, 5.0, 0.2, 2);
+    addWindow(policy, 5.0, 0.2, 2);
+
+    CHECK(policy.mode() == QGraphicsView::SmartViewportUpdate);
+  }
+
+  SECTION("reset applies a mode right away")
+  {
+    policy.reset(QGraphicsView::FullViewportUpdate);
+
+    CHECK(policy.mode() == QGraphicsView::FullViewportUpdate);
+  }
+}